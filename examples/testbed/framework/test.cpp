@@ -20,9 +20,10 @@
 #include <testbed/framework/profiler.h>
 #include <imgui/imgui.h>
 
-extern u32 b3_allocCalls, b3_maxAllocCalls;
+extern std::atomic<u32> b3_allocCalls, b3_maxAllocCalls;
 extern u32 b3_convexCalls, b3_convexCacheHits;
 extern u32 b3_gjkCalls, b3_gjkIters, b3_gjkMaxIters;
+extern u32 b3_toiCalls, b3_toiIters, b3_toiMaxIters;
 extern bool b3_convexCache;
 
 void b3BeginProfileScope(const char* name)
@@ -103,6 +104,15 @@ void Test::Step()
 		g_draw->DrawString(b3Color_white, "GJK Calls %d", b3_gjkCalls);
 		g_draw->DrawString(b3Color_white, "GJK Iterations %d (%d) (%f)", b3_gjkIters, b3_gjkMaxIters, avgGjkIters);
 
+		float32 avgToiIters = 0.0f;
+		if (b3_toiCalls > 0)
+		{
+			avgToiIters = float32(b3_toiIters) / float32(b3_toiCalls);
+		}
+
+		g_draw->DrawString(b3Color_white, "TOI Calls %d", b3_toiCalls);
+		g_draw->DrawString(b3Color_white, "TOI Iterations %d (%d) (%f)", b3_toiIters, b3_toiMaxIters, avgToiIters);
+
 		float32 convexCacheHitRatio = 0.0f;
 		if (b3_convexCalls > 0)
 		{
@@ -111,7 +121,7 @@ void Test::Step()
 
 		g_draw->DrawString(b3Color_white, "Convex Calls %d", b3_convexCalls);
 		g_draw->DrawString(b3Color_white, "Convex Cache Hits %d (%f)", b3_convexCacheHits, convexCacheHitRatio);
-		g_draw->DrawString(b3Color_white, "Frame Allocations %d (%d)", b3_allocCalls, b3_maxAllocCalls);
+		g_draw->DrawString(b3Color_white, "Frame Allocations %d (%d)", b3_allocCalls.load(), b3_maxAllocCalls.load());
 	}
 }
 
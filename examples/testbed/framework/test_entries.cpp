@@ -31,6 +31,7 @@
 #include <testbed/tests/angular_motion.h>
 #include <testbed/tests/gyro_motion.h>
 #include <testbed/tests/initial_overlap.h>
+#include <testbed/tests/bullet_test.h>
 #include <testbed/tests/capsule_spin.h>
 #include <testbed/tests/quadric_shapes.h>
 #include <testbed/tests/compound_body.h>
@@ -52,6 +53,7 @@
 #include <testbed/tests/pyramid.h>
 #include <testbed/tests/pyramids.h>
 #include <testbed/tests/ray_cast.h>
+#include <testbed/tests/shape_cast.h>
 #include <testbed/tests/sensor_test.h>
 #include <testbed/tests/point_click.h>
 #include <testbed/tests/body_types.h>
@@ -69,6 +71,14 @@
 #include <testbed/tests/single_pendulum.h>
 #include <testbed/tests/rope_test.h>
 #include <testbed/tests/mass_spring.h>
+#include <testbed/tests/pair_benchmark.h>
+#include <testbed/tests/tree_benchmark.h>
+#include <testbed/tests/mesh_tree_benchmark.h>
+#include <testbed/tests/tree_builder_benchmark.h>
+#include <testbed/tests/ray_cast_benchmark.h>
+#include <testbed/tests/contact_solver_benchmark.h>
+#include <testbed/tests/sub_step_benchmark.h>
+#include <testbed/tests/job_system_test.h>
 
 TestEntry g_tests[] =
 {
@@ -105,6 +115,7 @@ TestEntry g_tests[] =
 	{ "Box Pyramid", &Pyramid::Create },
 	{ "Box Pyramid Rows", &Pyramids::Create },
 	{ "Ray Cast", &RayCast::Create },
+	{ "Shape Cast", &ShapeCast::Create },
 	{ "Sensor Test", &SensorTest::Create },
 	{ "Point & Click", &PointClick::Create },
 	{ "Body Types", &BodyTypes::Create },
@@ -112,6 +123,7 @@ TestEntry g_tests[] =
 	{ "Varying Restitution", &VaryingRestitution::Create },
 	{ "Tumbler", &Tumbler::Create },
 	{ "Initial Overlap", &InitialOverlap::Create },
+	{ "Bullet Test", &BulletTest::Create },
 	{ "Multiple Pendulum", &MultiplePendulum::Create },
 	{ "Cloth", &Cloth::Create },
 	{ "Table Cloth", &TableCloth::Create },
@@ -122,6 +134,14 @@ TestEntry g_tests[] =
 	{ "Mass-Spring System", &MassSpring::Create },
 	{ "Single Pendulum", &SinglePendulum::Create },
 	{ "Rope", &Rope::Create },
+	{ "Pair Benchmark", &PairBenchmark::Create },
+	{ "Tree Benchmark", &TreeBenchmark::Create },
+	{ "Mesh Tree Benchmark", &MeshTreeBenchmark::Create },
+	{ "Tree Builder Benchmark", &TreeBuilderBenchmark::Create },
+	{ "Ray Cast Benchmark", &RayCastBenchmark::Create },
+	{ "Contact Solver Benchmark", &ContactSolverBenchmark::Create },
+	{ "Sub-Step Benchmark", &SubStepBenchmark::Create },
+	{ "Job System Test", &JobSystemTest::Create },
 	{ NULL, NULL }
 };
 
@@ -0,0 +1,156 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BULLET_TEST_H
+#define BULLET_TEST_H
+
+class BulletTest : public Test
+{
+public:
+	BulletTest()
+	{
+		{
+			b3BodyDef bd;
+			b3Body* ground = m_world.CreateBody(bd);
+
+			b3HullShape hs;
+			hs.m_hull = &m_groundHull;
+
+			b3ShapeDef sd;
+			sd.shape = &hs;
+
+			ground->CreateShape(sd);
+		}
+
+		{
+			b3Transform xf;
+			xf.position.SetZero();
+			xf.rotation = b3Diagonal(0.05f, 5.0f, 10.0f);
+			m_wallHull.SetTransform(xf);
+
+			b3BodyDef bd;
+			bd.position.Set(0.0f, 5.0f, 0.0f);
+
+			b3Body* wall = m_world.CreateBody(bd);
+
+			b3HullShape hs;
+			hs.m_hull = &m_wallHull;
+
+			b3ShapeDef sd;
+			sd.shape = &hs;
+
+			wall->CreateShape(sd);
+		}
+
+		{
+			b3Transform xf;
+			xf.position.SetZero();
+			xf.rotation = b3Diagonal(0.25f, 0.25f, 0.25f);
+			m_boxHull.SetTransform(xf);
+		}
+
+		m_speculative = false;
+
+		Fire(true);
+	}
+
+	void Fire(bool bullet)
+	{
+		float32 z = bullet ? -5.0f : 5.0f;
+
+		{
+			b3BodyDef bd;
+			bd.type = e_dynamicBody;
+			bd.position.Set(-21.0f, 5.0f, z - 2.0f);
+			bd.linearVelocity.Set(200.0f, 0.0f, 0.0f);
+			bd.angularVelocity.Set(RandomFloat(-10.0f, 10.0f), RandomFloat(-10.0f, 10.0f), RandomFloat(-10.0f, 10.0f));
+			bd.bullet = bullet;
+
+			b3Body* body = m_world.CreateBody(bd);
+
+			b3SphereShape ss;
+			ss.m_center.SetZero();
+			ss.m_radius = 0.25f;
+
+			b3ShapeDef sd;
+			sd.shape = &ss;
+			sd.density = 1.0f;
+
+			body->CreateShape(sd);
+		}
+
+		{
+			b3BodyDef bd;
+			bd.type = e_dynamicBody;
+			bd.position.Set(-21.0f, 5.0f, z + 2.0f);
+			bd.linearVelocity.Set(200.0f, 0.0f, 0.0f);
+			bd.angularVelocity.Set(RandomFloat(-10.0f, 10.0f), RandomFloat(-10.0f, 10.0f), RandomFloat(-10.0f, 10.0f));
+			bd.bullet = bullet;
+
+			b3Body* body = m_world.CreateBody(bd);
+
+			b3HullShape hs;
+			hs.m_hull = &m_boxHull;
+
+			b3ShapeDef sd;
+			sd.shape = &hs;
+			sd.density = 1.0f;
+
+			body->CreateShape(sd);
+		}
+	}
+
+	void Step()
+	{
+		Test::Step();
+
+		g_draw->DrawString(b3Color_white, "B - Fire Bullets");
+		g_draw->DrawString(b3Color_white, "N - Fire Non-Bullets");
+		g_draw->DrawString(b3Color_white, "S - Toggle Speculative Contacts (%s)", m_speculative ? "On" : "Off");
+	}
+
+	void KeyDown(int button)
+	{
+		if (button == GLFW_KEY_B)
+		{
+			Fire(true);
+		}
+
+		if (button == GLFW_KEY_N)
+		{
+			Fire(false);
+		}
+
+		if (button == GLFW_KEY_S)
+		{
+			m_speculative = !m_speculative;
+			m_world.SetSpeculativeContacts(m_speculative);
+		}
+	}
+
+	static Test* Create()
+	{
+		return new BulletTest();
+	}
+
+	b3BoxHull m_wallHull;
+	b3BoxHull m_boxHull;
+	bool m_speculative;
+};
+
+#endif
@@ -36,7 +36,7 @@ public:
 		b3Manifold manifold;
 		manifold.Initialize();
 
-		b3CollideShapeAndShape(manifold, m_xfA, m_shapeA, m_xfB, m_shapeB, &cache);
+		b3CollideShapeAndShape(manifold, m_xfA, m_shapeA, m_xfB, m_shapeB, &cache, 0.0f);
 		
 		for (u32 i = 0; i < manifold.pointCount; ++i)
 		{
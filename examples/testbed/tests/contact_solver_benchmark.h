@@ -0,0 +1,115 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef CONTACT_SOLVER_BENCHMARK_H
+#define CONTACT_SOLVER_BENCHMARK_H
+
+// This benchmark steps two copies of the box pyramid rows and the Jenga tower. 
+// The first copy uses the scalar contact solver and the second copy uses the 
+// wide contact solver, which solves four manifolds at a time.
+// Sleeping is disabled so that every step solves all contacts.
+class ContactSolverBenchmark : public Test
+{
+public:
+	enum
+	{
+		e_sceneCount = 2
+	};
+
+	ContactSolverBenchmark()
+	{
+		m_names[0] = "Box Pyramid Rows";
+		m_scenes[0][0] = new Pyramids();
+		m_scenes[0][1] = new Pyramids();
+
+		m_names[1] = "Jenga";
+		m_scenes[1][0] = new Jenga();
+		m_scenes[1][1] = new Jenga();
+
+		for (u32 i = 0; i < e_sceneCount; ++i)
+		{
+			m_scenes[i][0]->m_world.SetWideContactSolver(false);
+			m_scenes[i][1]->m_world.SetWideContactSolver(true);
+
+			for (u32 j = 0; j < 2; ++j)
+			{
+				m_scenes[i][j]->m_world.SetSleeping(false);
+				m_times[i][j] = 0.0;
+			}
+		}
+	}
+
+	~ContactSolverBenchmark()
+	{
+		for (u32 i = 0; i < e_sceneCount; ++i)
+		{
+			delete m_scenes[i][0];
+			delete m_scenes[i][1];
+		}
+	}
+
+	void Step()
+	{
+		Test::Step();
+
+		float32 dt = g_testSettings->inv_hertz;
+		u32 velocityIterations = g_testSettings->velocityIterations;
+		u32 positionIterations = g_testSettings->positionIterations;
+
+		for (u32 i = 0; i < e_sceneCount; ++i)
+		{
+			for (u32 j = 0; j < 2; ++j)
+			{
+				b3World& world = m_scenes[i][j]->m_world;
+				world.SetWarmStart(g_testSettings->warmStart);
+
+				b3Time time;
+				world.Step(dt, velocityIterations, positionIterations);
+				time.Update();
+
+				// Smooth the step time.
+				m_times[i][j] = 0.9 * m_times[i][j] + 0.1 * time.GetCurrentMilis();
+			}
+
+			// Draw the scene solved by the wide solver.
+			m_scenes[i][1]->m_world.Draw();
+		}
+
+		for (u32 i = 0; i < e_sceneCount; ++i)
+		{
+			float64 scalarTime = m_times[i][0];
+			float64 wideTime = m_times[i][1];
+			float64 speedup = wideTime > 0.0 ? scalarTime / wideTime : 0.0;
+
+			g_draw->DrawString(b3Color_white, "%s (%d contacts)", m_names[i], m_scenes[i][1]->m_world.GetContactList().m_count);
+			g_draw->DrawString(b3Color_white, "Scalar Solver %f ms", scalarTime);
+			g_draw->DrawString(b3Color_white, "Wide Solver %f ms (%fx)", wideTime, speedup);
+		}
+	}
+
+	static Test* Create()
+	{
+		return new ContactSolverBenchmark();
+	}
+
+	const char* m_names[e_sceneCount];
+	Test* m_scenes[e_sceneCount][2];
+	float64 m_times[e_sceneCount][2];
+};
+
+#endif
@@ -0,0 +1,160 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef JOB_SYSTEM_TEST_H
+#define JOB_SYSTEM_TEST_H
+
+// This test steps three copies of the box pyramid rows. 
+// The first copy is stepped on the calling thread, the second copy on a thread pool 
+// with two threads and the third copy on a thread pool with four threads. 
+// The body states of the copies are compared after every step. 
+// The copies stepped on a thread pool must always match each other. 
+// They match the copy stepped on the calling thread as long as no island is 
+// large enough to have its constraints colored.
+class JobSystemTest : public Test
+{
+public:
+	enum
+	{
+		e_worldCount = 3
+	};
+
+	JobSystemTest() : m_pool2(2), m_pool4(4)
+	{
+		for (u32 i = 0; i < e_worldCount; ++i)
+		{
+			m_scenes[i] = new Pyramids();
+		}
+
+		m_scenes[1]->m_world.SetJobSystem(&m_pool2);
+		m_scenes[2]->m_world.SetJobSystem(&m_pool4);
+
+		m_stepCount = 0;
+		m_threadMismatchStep = 0;
+		m_serialMismatchStep = 0;
+	}
+
+	~JobSystemTest()
+	{
+		for (u32 i = 0; i < e_worldCount; ++i)
+		{
+			delete m_scenes[i];
+		}
+	}
+
+	static bool Equal(const b3Vec3& a, const b3Vec3& b)
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+
+	// Return true if the bodies of two worlds have the same states.
+	static bool Match(const b3World& world1, const b3World& world2)
+	{
+		const b3Body* b1 = world1.GetBodyList().m_head;
+		const b3Body* b2 = world2.GetBodyList().m_head;
+		
+		while (b1 && b2)
+		{
+			b3Vec3 p1 = b1->GetPosition(), p2 = b2->GetPosition();
+			b3Quat q1 = b1->GetOrientation(), q2 = b2->GetOrientation();
+			b3Vec3 v1 = b1->GetLinearVelocity(), v2 = b2->GetLinearVelocity();
+			b3Vec3 w1 = b1->GetAngularVelocity(), w2 = b2->GetAngularVelocity();
+
+			if (Equal(p1, p2) == false || Equal(v1, v2) == false || Equal(w1, w2) == false)
+			{
+				return false;
+			}
+
+			if (q1.x != q2.x || q1.y != q2.y || q1.z != q2.z || q1.w != q2.w)
+			{
+				return false;
+			}
+
+			b1 = b1->GetNext();
+			b2 = b2->GetNext();
+		}
+
+		return b1 == NULL && b2 == NULL;
+	}
+
+	void Step()
+	{
+		Test::Step();
+
+		float32 dt = g_testSettings->inv_hertz;
+		u32 velocityIterations = g_testSettings->velocityIterations;
+		u32 positionIterations = g_testSettings->positionIterations;
+
+		for (u32 i = 0; i < e_worldCount; ++i)
+		{
+			b3World& world = m_scenes[i]->m_world;
+			world.SetWarmStart(g_testSettings->warmStart);
+			world.Step(dt, velocityIterations, positionIterations);
+		}
+
+		++m_stepCount;
+
+		// Remember the first step where the states diverged.
+		if (m_threadMismatchStep == 0 && Match(m_scenes[1]->m_world, m_scenes[2]->m_world) == false)
+		{
+			m_threadMismatchStep = m_stepCount;
+		}
+
+		if (m_serialMismatchStep == 0 && Match(m_scenes[0]->m_world, m_scenes[1]->m_world) == false)
+		{
+			m_serialMismatchStep = m_stepCount;
+		}
+
+		// Draw the copy stepped on four threads.
+		m_scenes[2]->m_world.Draw();
+
+		g_draw->DrawString(b3Color_white, "Steps %d", m_stepCount);
+
+		if (m_threadMismatchStep == 0)
+		{
+			g_draw->DrawString(b3Color_white, "2 Threads vs 4 Threads: Match");
+		}
+		else
+		{
+			g_draw->DrawString(b3Color_red, "2 Threads vs 4 Threads: Mismatch at step %d", m_threadMismatchStep);
+		}
+
+		if (m_serialMismatchStep == 0)
+		{
+			g_draw->DrawString(b3Color_white, "1 Thread vs 2 Threads: Match");
+		}
+		else
+		{
+			g_draw->DrawString(b3Color_white, "1 Thread vs 2 Threads: Mismatch at step %d (colored islands)", m_serialMismatchStep);
+		}
+	}
+
+	static Test* Create()
+	{
+		return new JobSystemTest();
+	}
+
+	b3ThreadPool m_pool2;
+	b3ThreadPool m_pool4;
+	Test* m_scenes[e_worldCount];
+	u32 m_stepCount;
+	u32 m_threadMismatchStep;
+	u32 m_serialMismatchStep;
+};
+
+#endif
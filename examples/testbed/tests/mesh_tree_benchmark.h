@@ -0,0 +1,291 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef MESH_TREE_BENCHMARK_H
+#define MESH_TREE_BENCHMARK_H
+
+// This benchmark compares the binary, the 4-ary and the quantized tree walks 
+// on a large terrain mesh using AABB queries and ray casts.
+// It also loads the 4-ary tree from a cooked buffer, which is how 
+// a mesh cooked offline would be used, and checks that malformed cooked 
+// trees are rejected.
+class MeshTreeBenchmark : public Test
+{
+public:
+	enum
+	{
+		e_queryCount = 4096,
+		e_rayCount = 1024
+	};
+
+	struct Counter
+	{
+		bool Report(u32 proxyId)
+		{
+			B3_NOT_USED(proxyId);
+			++hits;
+			return true;
+		}
+
+		float32 Report(const b3RayCastInput& input, u32 proxyId)
+		{
+			B3_NOT_USED(proxyId);
+			++hits;
+			return input.maxFraction;
+		}
+
+		u32 hits;
+	};
+
+	MeshTreeBenchmark()
+	{
+		// Transform the grids into the same terrain.
+		for (u32 i = 0; i < m_binaryMesh.vertexCount; ++i)
+		{
+			float32 y = RandomFloat(0.0f, 4.0f);
+			m_binaryMesh.vertices[i].y = y;
+			m_wideMesh.vertices[i].y = y;
+			m_quantizedMesh.vertices[i].y = y;
+		}
+
+		b3Time binaryTime;
+		m_binaryMesh.BuildTree();
+		binaryTime.Update();
+
+		b3Time wideTime;
+		m_wideMesh.BuildWideTree();
+		wideTime.Update();
+
+		b3Time quantizedTime;
+		m_quantizedMesh.BuildQuantizedTree();
+		quantizedTime.Update();
+
+		m_binaryBuildTime = binaryTime.GetCurrentMilis();
+		m_wideBuildTime = wideTime.GetCurrentMilis();
+		m_quantizedBuildTime = quantizedTime.GetCurrentMilis();
+
+		m_cookedSize = m_wideMesh.GetCookedSize();
+		m_cookedBuffer = b3AllocAligned(m_cookedSize, B3_COOKED_TREE_ALIGNMENT);
+		m_wideMesh.Cook(m_cookedBuffer);
+
+		b3Time loadTime;
+		bool loaded = m_cookedMesh.Load(m_cookedBuffer, m_cookedSize);
+		loadTime.Update();
+		
+		B3_ASSERT(loaded);
+		B3_NOT_USED(loaded);
+
+		m_loadTime = loadTime.GetCurrentMilis();
+
+		m_rejectedCount = CheckMalformedTrees();
+
+		float32 extent = 0.5f * float32(e_size);
+
+		for (u32 i = 0; i < e_queryCount; ++i)
+		{
+			b3Vec3 center;
+			center.x = RandomFloat(-extent, extent);
+			center.y = RandomFloat(0.0f, 4.0f);
+			center.z = RandomFloat(-extent, extent);
+
+			float32 r = RandomFloat(0.5f, 2.0f);
+
+			m_queries[i].m_lower = center - b3Vec3(r, r, r);
+			m_queries[i].m_upper = center + b3Vec3(r, r, r);
+		}
+
+		for (u32 i = 0; i < e_rayCount; ++i)
+		{
+			m_rays[i].p1.Set(RandomFloat(-extent, extent), 10.0f, RandomFloat(-extent, extent));
+			m_rays[i].p2.Set(RandomFloat(-extent, extent), -10.0f, RandomFloat(-extent, extent));
+			m_rays[i].maxFraction = 1.0f;
+		}
+	}
+
+	// Corrupt copies of the cooked binary tree so that every node is reachable 
+	// and in range, but the walk of the tree would overflow its stack. 
+	// Return the number of corrupt trees that are rejected.
+	u32 CheckMalformedTrees()
+	{
+		const b3StaticTree& tree = m_binaryMesh.tree;
+		
+		u32 size = tree.GetCookedSize();
+		void* buffer = b3AllocAligned(size, B3_COOKED_TREE_ALIGNMENT);
+		
+		const b3CookedTreeHeader* header = (const b3CookedTreeHeader*)buffer;
+
+		u32 rejectedCount = 0;
+		for (u32 i = 0; i < 2; ++i)
+		{
+			tree.Cook(buffer);
+
+			b3StaticTree::b3Node* nodes = (b3StaticTree::b3Node*)((u8*)buffer + header->nodeOffset);
+			u32 nodeCount = header->nodeCount;
+			
+			if (i == 0)
+			{
+				// A chain where both children of a node are the next node.
+				// The tree is too deep and the walk time is exponential.
+				for (u32 j = 0; j + 1 < nodeCount; ++j)
+				{
+					nodes[j].child1 = j + 1;
+					nodes[j].child2 = j + 1;
+				}
+			}
+			else
+			{
+				// A chain where the second child of a node is a leaf.
+				// No node has two parents but the tree is too deep.
+				for (u32 j = 0; j + 2 < nodeCount; j += 2)
+				{
+					nodes[j].child1 = j + 2;
+					nodes[j].child2 = j + 1;
+
+					nodes[j + 1].child1 = B3_NULL_NODE_S;
+					nodes[j + 1].index = 0;
+					nodes[j + 1].count = 1;
+				}
+
+				for (u32 j = nodeCount - 2 + (nodeCount & 1); j < nodeCount; ++j)
+				{
+					nodes[j].child1 = B3_NULL_NODE_S;
+					nodes[j].index = 0;
+					nodes[j].count = 1;
+				}
+			}
+
+			b3StaticTree loadedTree;
+			if (loadedTree.Load(buffer, size) == false)
+			{
+				++rejectedCount;
+			}
+		}
+
+		b3FreeAligned(buffer);
+
+		return rejectedCount;
+	}
+
+	~MeshTreeBenchmark()
+	{
+		b3FreeAligned(m_cookedBuffer);
+	}
+
+	void Step()
+	{
+		Test::Step();
+
+		Counter binaryQuery;
+		binaryQuery.hits = 0;
+		b3Time binaryQueryTime;
+		for (u32 i = 0; i < e_queryCount; ++i)
+		{
+			m_binaryMesh.tree.QueryAABB(&binaryQuery, m_queries[i]);
+		}
+		binaryQueryTime.Update();
+
+		Counter wideQuery;
+		wideQuery.hits = 0;
+		b3Time wideQueryTime;
+		for (u32 i = 0; i < e_queryCount; ++i)
+		{
+			m_wideMesh.tree.QueryAABB(&wideQuery, m_queries[i]);
+		}
+		wideQueryTime.Update();
+
+		Counter quantizedQuery;
+		quantizedQuery.hits = 0;
+		b3Time quantizedQueryTime;
+		for (u32 i = 0; i < e_queryCount; ++i)
+		{
+			m_quantizedMesh.tree.QueryAABB(&quantizedQuery, m_queries[i]);
+		}
+		quantizedQueryTime.Update();
+
+		Counter binaryRay;
+		binaryRay.hits = 0;
+		b3Time binaryRayTime;
+		for (u32 i = 0; i < e_rayCount; ++i)
+		{
+			m_binaryMesh.tree.RayCast(&binaryRay, m_rays[i]);
+		}
+		binaryRayTime.Update();
+
+		Counter wideRay;
+		wideRay.hits = 0;
+		b3Time wideRayTime;
+		for (u32 i = 0; i < e_rayCount; ++i)
+		{
+			m_wideMesh.tree.RayCast(&wideRay, m_rays[i]);
+		}
+		wideRayTime.Update();
+
+		Counter quantizedRay;
+		quantizedRay.hits = 0;
+		b3Time quantizedRayTime;
+		for (u32 i = 0; i < e_rayCount; ++i)
+		{
+			m_quantizedMesh.tree.RayCast(&quantizedRay, m_rays[i]);
+		}
+		quantizedRayTime.Update();
+
+		Counter cookedQuery;
+		cookedQuery.hits = 0;
+		for (u32 i = 0; i < e_queryCount; ++i)
+		{
+			m_cookedMesh.tree.QueryAABB(&cookedQuery, m_queries[i]);
+		}
+
+		g_draw->DrawString(b3Color_white, "Triangles %d", m_binaryMesh.triangleCount);
+		g_draw->DrawString(b3Color_white, "Build: binary %f ms, 4-ary %f ms, quantized %f ms", m_binaryBuildTime, m_wideBuildTime, m_quantizedBuildTime);
+		g_draw->DrawString(b3Color_white, "Tree memory: binary %d, 4-ary %d, quantized %d bytes", m_binaryMesh.tree.GetSize(), m_wideMesh.tree.GetSize(), m_quantizedMesh.tree.GetSize());
+		g_draw->DrawString(b3Color_white, "%d AABB queries: binary %f ms, 4-ary %f ms, quantized %f ms (%d, %d, %d hits)", e_queryCount, binaryQueryTime.GetCurrentMilis(), wideQueryTime.GetCurrentMilis(), quantizedQueryTime.GetCurrentMilis(), binaryQuery.hits, wideQuery.hits, quantizedQuery.hits);
+		g_draw->DrawString(b3Color_white, "%d ray casts: binary %f ms, 4-ary %f ms, quantized %f ms (%d, %d, %d hits)", e_rayCount, binaryRayTime.GetCurrentMilis(), wideRayTime.GetCurrentMilis(), quantizedRayTime.GetCurrentMilis(), binaryRay.hits, wideRay.hits, quantizedRay.hits);
+		g_draw->DrawString(b3Color_white, "Cooked 4-ary mesh: %d bytes, load %f ms (%d query hits)", m_cookedSize, m_loadTime, cookedQuery.hits);
+		g_draw->DrawString(b3Color_white, "Malformed cooked trees rejected: %d of 2", m_rejectedCount);
+	}
+
+	static Test* Create()
+	{
+		return new MeshTreeBenchmark();
+	}
+
+	enum
+	{
+		e_size = 256
+	};
+
+	b3GridMesh<e_size, e_size> m_binaryMesh;
+	b3GridMesh<e_size, e_size> m_wideMesh;
+	b3GridMesh<e_size, e_size> m_quantizedMesh;
+	
+	float64 m_binaryBuildTime;
+	float64 m_wideBuildTime;
+	float64 m_quantizedBuildTime;
+
+	u32 m_cookedSize;
+	void* m_cookedBuffer;
+	b3Mesh m_cookedMesh;
+	float64 m_loadTime;
+	u32 m_rejectedCount;
+
+	b3AABB3 m_queries[e_queryCount];
+	b3RayCastInput m_rays[e_rayCount];
+};
+
+#endif
@@ -0,0 +1,225 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef PAIR_BENCHMARK_H
+#define PAIR_BENCHMARK_H
+
+#include <algorithm>
+
+// This benchmark compares the two ways of pruning the duplicated 
+// overlapping pairs found by the broad-phase: sorting the pair buffer 
+// and skipping duplicates, and inserting the pairs into a hash table 
+// as they are found.
+class PairBenchmark : public Test
+{
+public:
+	enum
+	{
+		e_count = 4096,
+		e_iterations = 8
+	};
+
+	PairBenchmark()
+	{
+		for (u32 i = 0; i < e_count; ++i)
+		{
+			b3Vec3 center;
+			center.x = RandomFloat(-25.0f, 25.0f);
+			center.y = RandomFloat(-25.0f, 25.0f);
+			center.z = RandomFloat(-25.0f, 25.0f);
+
+			float32 r = RandomFloat(0.5f, 2.0f);
+
+			b3AABB3 aabb;
+			aabb.m_lower = center - b3Vec3(r, r, r);
+			aabb.m_upper = center + b3Vec3(r, r, r);
+
+			m_aabbs[i] = aabb;
+			
+			m_velocities[i].x = RandomFloat(-1.0f, 1.0f);
+			m_velocities[i].y = RandomFloat(-1.0f, 1.0f);
+			m_velocities[i].z = RandomFloat(-1.0f, 1.0f);
+
+			m_proxies[i] = m_tree.InsertNode(aabb, NULL);
+		}
+
+		m_pairs = (b3Pair*)b3Alloc(e_capacity * sizeof(b3Pair));
+		m_pairCount = 0;
+
+		m_sortTime = 0.0;
+		m_hashTime = 0.0;
+		m_uniqueCount = 0;
+	}
+
+	~PairBenchmark()
+	{
+		b3Free(m_pairs);
+	}
+
+	bool Report(u32 proxyId)
+	{
+		if (proxyId == m_queryProxyId || m_pairCount == e_capacity)
+		{
+			return true;
+		}
+
+		m_pairs[m_pairCount].proxy1 = b3Min(proxyId, m_queryProxyId);
+		m_pairs[m_pairCount].proxy2 = b3Max(proxyId, m_queryProxyId);
+		++m_pairCount;
+		
+		return true;
+	}
+
+	void Step()
+	{
+		Test::Step();
+
+		float32 dt = g_testSettings->inv_hertz;
+
+		// Move all proxies and collect the duplicated overlapping pairs.
+		m_pairCount = 0;
+		for (u32 i = 0; i < e_count; ++i)
+		{
+			b3AABB3& aabb = m_aabbs[i];
+			b3Vec3 d = dt * m_velocities[i];
+			aabb.m_lower += d;
+			aabb.m_upper += d;
+
+			// Bounce on the walls.
+			for (u32 j = 0; j < 3; ++j)
+			{
+				if (aabb.m_lower[j] < -25.0f || aabb.m_upper[j] > 25.0f)
+				{
+					m_velocities[i][j] = -m_velocities[i][j];
+				}
+			}
+
+			m_tree.UpdateNode(m_proxies[i], aabb);
+		}
+
+		for (u32 i = 0; i < e_count; ++i)
+		{
+			m_queryProxyId = m_proxies[i];
+			m_tree.QueryAABB(this, m_tree.GetAABB(m_queryProxyId));
+		}
+
+		b3Pair* buffer = (b3Pair*)b3Alloc(m_pairCount * sizeof(b3Pair) + 1);
+
+		// Sort and skip duplicates.
+		u32 sortCount = 0;
+		b3Time sortTime;
+		for (u32 iteration = 0; iteration < e_iterations; ++iteration)
+		{
+			memcpy(buffer, m_pairs, m_pairCount * sizeof(b3Pair));
+			std::sort(buffer, buffer + m_pairCount, ComparePairs);
+
+			sortCount = 0;
+			u32 index = 0;
+			while (index < m_pairCount)
+			{
+				const b3Pair* primaryPair = buffer + index;
+				++sortCount;
+
+				++index;
+				while (index < m_pairCount)
+				{
+					const b3Pair* secondaryPair = buffer + index;
+					if (secondaryPair->proxy1 != primaryPair->proxy1 || secondaryPair->proxy2 != primaryPair->proxy2)
+					{
+						break;
+					}
+					++index;
+				}
+			}
+		}
+		sortTime.Update();
+
+		// Prune duplicates as they are found.
+		u32 hashCount = 0;
+		b3Time hashTime;
+		for (u32 iteration = 0; iteration < e_iterations; ++iteration)
+		{
+			m_pairSet.Clear();
+
+			hashCount = 0;
+			for (u32 i = 0; i < m_pairCount; ++i)
+			{
+				const b3Pair* pair = m_pairs + i;
+				if (m_pairSet.Insert(pair->proxy1, pair->proxy2, NULL))
+				{
+					buffer[hashCount++] = *pair;
+				}
+			}
+		}
+		hashTime.Update();
+
+		b3Free(buffer);
+
+		B3_ASSERT(sortCount == hashCount);
+		
+		m_uniqueCount = hashCount;
+		m_sortTime = sortTime.GetCurrentMilis() / float64(e_iterations);
+		m_hashTime = hashTime.GetCurrentMilis() / float64(e_iterations);
+
+		g_draw->DrawString(b3Color_white, "Proxies %d", e_count);
+		g_draw->DrawString(b3Color_white, "Pairs %d (%d unique)", m_pairCount, m_uniqueCount);
+		g_draw->DrawString(b3Color_white, "Sort and Prune %f ms", m_sortTime);
+		g_draw->DrawString(b3Color_white, "Hash %f ms", m_hashTime);
+	}
+
+	static bool ComparePairs(const b3Pair& pair1, const b3Pair& pair2)
+	{
+		if (pair1.proxy1 < pair2.proxy1)
+		{
+			return true;
+		}
+
+		if (pair1.proxy1 == pair2.proxy1)
+		{
+			return pair1.proxy2 < pair2.proxy2;
+		}
+
+		return false;
+	}
+
+	static Test* Create()
+	{
+		return new PairBenchmark();
+	}
+
+	enum
+	{
+		e_capacity = 32 * e_count
+	};
+
+	b3DynamicTree m_tree;
+	b3AABB3 m_aabbs[e_count];
+	b3Vec3 m_velocities[e_count];
+	u32 m_proxies[e_count];
+	u32 m_queryProxyId;
+
+	b3Pair* m_pairs;
+	u32 m_pairCount;
+	b3PairHash m_pairSet;
+
+	u32 m_uniqueCount;
+	float64 m_sortTime;
+	float64 m_hashTime;
+};
+
+#endif
@@ -0,0 +1,181 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef RAY_CAST_BENCHMARK_H
+#define RAY_CAST_BENCHMARK_H
+
+// This benchmark casts many rays through a field of boxes above a ground mesh.
+// It compares gathering every hit, the closest hit query that clips the ray, 
+// and the any hit query that stops at the first hit.
+class RayCastBenchmark : public Test
+{
+public:
+	enum
+	{
+		e_rowCount = 32,
+		e_columnCount = 32,
+		e_rayCount = 4096
+	};
+
+	// Gather every hit and keep the closest one.
+	class AllHitsListener : public b3RayCastListener
+	{
+	public:
+		float32 ReportShape(b3Shape* shape, const b3Vec3& point, const b3Vec3& normal, float32 fraction)
+		{
+			B3_NOT_USED(point);
+			B3_NOT_USED(normal);
+			++hitCount;
+			if (fraction < minFraction)
+			{
+				minFraction = fraction;
+				minShape = shape;
+			}
+			return 1.0f;
+		}
+
+		u32 hitCount;
+		float32 minFraction;
+		b3Shape* minShape;
+	};
+
+	RayCastBenchmark()
+	{
+		{
+			b3BodyDef bd;
+			b3Body* ground = m_world.CreateBody(bd);
+
+			b3MeshShape ms;
+			ms.m_mesh = &m_groundMesh;
+
+			b3ShapeDef sd;
+			sd.shape = &ms;
+
+			ground->CreateShape(sd);
+		}
+
+		for (u32 i = 0; i < e_rowCount; ++i)
+		{
+			for (u32 j = 0; j < e_columnCount; ++j)
+			{
+				b3BodyDef bd;
+				bd.position.x = -40.0f + 2.5f * float32(i);
+				bd.position.y = RandomFloat(1.0f, 4.0f);
+				bd.position.z = -40.0f + 2.5f * float32(j);
+				bd.orientation = b3QuatRotationY(RandomFloat(0.0f, B3_PI));
+
+				b3Body* body = m_world.CreateBody(bd);
+
+				b3HullShape hs;
+				hs.m_hull = &b3BoxHull_identity;
+
+				b3ShapeDef sd;
+				sd.shape = &hs;
+
+				body->CreateShape(sd);
+			}
+		}
+
+		for (u32 i = 0; i < e_rayCount; ++i)
+		{
+			m_p1s[i].Set(RandomFloat(-45.0f, 45.0f), RandomFloat(1.0f, 6.0f), RandomFloat(-45.0f, 45.0f));
+			m_p2s[i].Set(RandomFloat(-45.0f, 45.0f), RandomFloat(-1.0f, 6.0f), RandomFloat(-45.0f, 45.0f));
+		}
+	}
+
+	void Step()
+	{
+		Test::Step();
+
+		u32 allHitCount = 0;
+		u32 singleHitCount = 0;
+		u32 anyHitCount = 0;
+		u32 mismatchCount = 0;
+		u32 batchMismatchCount = 0;
+
+		AllHitsListener listener;
+
+		b3Time allTime;
+		for (u32 i = 0; i < e_rayCount; ++i)
+		{
+			listener.hitCount = 0;
+			listener.minFraction = B3_MAX_FLOAT;
+			listener.minShape = NULL;
+			m_world.RayCast(&listener, m_p1s[i], m_p2s[i]);
+			allHitCount += listener.hitCount;
+			m_closestShapes[i] = listener.minShape;
+		}
+		allTime.Update();
+
+		b3Time singleTime;
+		for (u32 i = 0; i < e_rayCount; ++i)
+		{
+			b3RayCastSingleOutput output;
+			if (m_world.RayCastSingle(&output, m_p1s[i], m_p2s[i]))
+			{
+				++singleHitCount;
+				if (output.shape != m_closestShapes[i])
+				{
+					++mismatchCount;
+				}
+			}
+		}
+		singleTime.Update();
+
+		b3Time anyTime;
+		for (u32 i = 0; i < e_rayCount; ++i)
+		{
+			b3RayCastSingleOutput output;
+			if (m_world.RayCastAny(&output, m_p1s[i], m_p2s[i]))
+			{
+				++anyHitCount;
+			}
+		}
+		anyTime.Update();
+
+		b3Time batchTime;
+		u32 batchHitCount = m_world.RayCastBatch(m_outputs, m_p1s, m_p2s, e_rayCount);
+		batchTime.Update();
+
+		for (u32 i = 0; i < e_rayCount; ++i)
+		{
+			if (m_outputs[i].shape != m_closestShapes[i])
+			{
+				++batchMismatchCount;
+			}
+		}
+
+		g_draw->DrawString(b3Color_white, "%d rays, %d boxes", e_rayCount, e_rowCount * e_columnCount);
+		g_draw->DrawString(b3Color_white, "All hits %f ms (%d hits)", allTime.GetCurrentMilis(), allHitCount);
+		g_draw->DrawString(b3Color_white, "Closest hit %f ms (%d rays hit, %d mismatches)", singleTime.GetCurrentMilis(), singleHitCount, mismatchCount);
+		g_draw->DrawString(b3Color_white, "Any hit %f ms (%d rays hit)", anyTime.GetCurrentMilis(), anyHitCount);
+		g_draw->DrawString(b3Color_white, "Batch %f ms (%d rays hit, %d mismatches)", batchTime.GetCurrentMilis(), batchHitCount, batchMismatchCount);
+	}
+
+	static Test* Create()
+	{
+		return new RayCastBenchmark();
+	}
+
+	b3Vec3 m_p1s[e_rayCount];
+	b3Vec3 m_p2s[e_rayCount];
+	b3Shape* m_closestShapes[e_rayCount];
+	b3RayCastSingleOutput m_outputs[e_rayCount];
+};
+
+#endif
@@ -0,0 +1,166 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef SHAPE_CAST_H
+#define SHAPE_CAST_H
+
+class ShapeCast : public Test
+{
+public:
+	ShapeCast()
+	{
+		{
+			b3BodyDef bdef;
+			b3Body* body = m_world.CreateBody(bdef);
+
+			b3MeshShape ms;
+			ms.m_mesh = &m_groundMesh;
+
+			b3ShapeDef sdef;
+			sdef.shape = &ms;
+
+			body->CreateShape(sdef);
+		}
+
+		{
+			b3BodyDef bdef;
+			bdef.position.Set(0.0f, 1.0f, 10.0f);
+			bdef.orientation = b3QuatRotationY(0.25f * B3_PI);
+
+			b3Body* body = m_world.CreateBody(bdef);
+
+			b3HullShape hs;
+			hs.m_hull = &b3BoxHull_identity;
+
+			b3ShapeDef sdef;
+			sdef.shape = &hs;
+
+			body->CreateShape(sdef);
+		}
+
+		{
+			b3BodyDef bdef;
+			bdef.position.Set(10.0f, 2.5f, 0.0f);
+
+			b3Body* body = m_world.CreateBody(bdef);
+
+			b3SphereShape ss;
+			ss.m_center.SetZero();
+			ss.m_radius = 2.5f;
+
+			b3ShapeDef sdef;
+			sdef.shape = &ss;
+
+			body->CreateShape(sdef);
+		}
+
+		{
+			b3BodyDef bdef;
+			bdef.position.Set(-8.0f, 1.0f, -8.0f);
+			bdef.orientation = b3QuatRotationZ(0.5f * B3_PI);
+
+			b3Body* body = m_world.CreateBody(bdef);
+
+			b3CapsuleShape cs;
+			cs.m_centers[0].Set(0.0f, 2.0f, 0.0f);
+			cs.m_centers[1].Set(0.0f, -2.0f, 0.0f);
+			cs.m_radius = 1.0f;
+
+			b3ShapeDef sdef;
+			sdef.shape = &cs;
+
+			body->CreateShape(sdef);
+		}
+
+		m_sphere.m_center.SetZero();
+		m_sphere.m_radius = 1.0f;
+
+		m_capsule.m_centers[0].Set(0.0f, 0.5f, 0.0f);
+		m_capsule.m_centers[1].Set(0.0f, -0.5f, 0.0f);
+		m_capsule.m_radius = 0.5f;
+
+		m_box.m_hull = &b3BoxHull_identity;
+
+		m_shapes[0] = &m_sphere;
+		m_shapes[1] = &m_capsule;
+		m_shapes[2] = &m_box;
+
+		m_xf.position.Set(0.0f, 6.0f, 0.0f);
+		m_xf.rotation.SetIdentity();
+		m_translation.Set(20.0f, -4.0f, 0.0f);
+	}
+
+	void CastShape(const b3Shape* shape, const b3Transform& xf, const b3Vec3& translation) const
+	{
+		b3Transform xf2 = xf;
+		xf2.position += translation;
+
+		b3ShapeCastSingleOutput out;
+		if (m_world.ShapeCast(&out, shape, xf, translation))
+		{
+			b3Transform xfHit = xf;
+			xfHit.position += out.fraction * translation;
+
+			g_draw->DrawSegment(xf.position, xfHit.position, b3Color_green);
+			m_world.DrawShape(xfHit, shape);
+
+			g_draw->DrawPoint(out.point, 4.0f, b3Color_red);
+			g_draw->DrawSegment(out.point, out.point + out.normal, b3Color_white);
+		}
+		else
+		{
+			g_draw->DrawSegment(xf.position, xf2.position, b3Color_green);
+			m_world.DrawShape(xf2, shape);
+		}
+	}
+
+	void Step()
+	{
+		float32 dt = g_testSettings->inv_hertz;
+		b3Quat dq = b3QuatRotationY(0.05f * B3_PI * dt);
+		
+		m_translation = b3Mul(dq, m_translation);
+
+		for (u32 i = 0; i < 3; ++i)
+		{
+			b3Transform xf = m_xf;
+			xf.position.y += 2.0f * float32(i);
+			
+			b3Quat q = b3QuatRotationY(2.0f * B3_PI * float32(i) / 3.0f);
+			
+			CastShape(m_shapes[i], xf, b3Mul(q, m_translation));
+		}
+
+		Test::Step();
+	}
+
+	static Test* Create()
+	{
+		return new ShapeCast();
+	}
+
+	b3SphereShape m_sphere;
+	b3CapsuleShape m_capsule;
+	b3HullShape m_box;
+	b3Shape* m_shapes[3];
+
+	b3Transform m_xf;
+	b3Vec3 m_translation;
+};
+
+#endif
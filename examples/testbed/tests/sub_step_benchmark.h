@@ -0,0 +1,182 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef SUB_STEP_BENCHMARK_H
+#define SUB_STEP_BENCHMARK_H
+
+// A tall box stack with a heavy box on the top.
+class SubStepStack : public Test
+{
+public:
+	enum
+	{
+		e_count = 20
+	};
+
+	SubStepStack(float32 x)
+	{
+		m_world.SetSleeping(false);
+
+		{
+			b3BodyDef bdef;
+			bdef.type = b3BodyType::e_staticBody;
+
+			b3Body* body = m_world.CreateBody(bdef);
+
+			b3HullShape hs;
+			hs.m_hull = &m_groundHull;
+
+			b3ShapeDef sdef;
+			sdef.shape = &hs;
+			sdef.friction = 1.0f;
+
+			body->CreateShape(sdef);
+		}
+
+		for (u32 i = 0; i < e_count; ++i)
+		{
+			b3BodyDef bdef;
+			bdef.type = b3BodyType::e_dynamicBody;
+			bdef.position.Set(x, 2.0f + 2.0f * float32(i), 0.0f);
+
+			b3Body* body = m_world.CreateBody(bdef);
+
+			b3HullShape hs;
+			hs.m_hull = &b3BoxHull_identity;
+
+			b3ShapeDef sdef;
+			sdef.shape = &hs;
+			sdef.friction = 0.6f;
+			
+			// The top box is twenty times heavier than the others.
+			sdef.density = i == e_count - 1 ? 20.0f : 1.0f;
+
+			body->CreateShape(sdef);
+
+			m_top = body;
+		}
+
+		m_topPosition = m_top->GetPosition();
+	}
+
+	// The distance the top box moved from its initial position.
+	float32 GetTopDrift() const
+	{
+		return b3Length(m_top->GetPosition() - m_topPosition);
+	}
+
+	// The maximum body speed.
+	float32 GetMaxSpeed() const
+	{
+		float32 maxSpeed = 0.0f;
+		for (b3Body* b = m_world.GetBodyList().m_head; b; b = b->GetNext())
+		{
+			maxSpeed = b3Max(maxSpeed, b3Length(b->GetLinearVelocity()));
+		}
+		return maxSpeed;
+	}
+
+	b3Body* m_top;
+	b3Vec3 m_topPosition;
+};
+
+// This benchmark steps copies of a tall box stack with a large mass ratio using 
+// different numbers of velocity iterations and sub-steps. 
+// The solver with sub-steps keeps the stack standing with fewer iterations per 
+// sub-step than the solver without sub-steps needs per step.
+class SubStepBenchmark : public Test
+{
+public:
+	enum
+	{
+		e_configCount = 4
+	};
+
+	SubStepBenchmark()
+	{
+		m_velocityIterations[0] = 8;
+		m_subStepCounts[0] = 1;
+
+		m_velocityIterations[1] = 32;
+		m_subStepCounts[1] = 1;
+
+		m_velocityIterations[2] = 1;
+		m_subStepCounts[2] = 8;
+
+		m_velocityIterations[3] = 8;
+		m_subStepCounts[3] = 4;
+
+		for (u32 i = 0; i < e_configCount; ++i)
+		{
+			m_stacks[i] = new SubStepStack(-15.0f + 10.0f * float32(i));
+			m_stacks[i]->m_world.SetSubStepCount(m_subStepCounts[i]);
+			m_times[i] = 0.0;
+		}
+	}
+
+	~SubStepBenchmark()
+	{
+		for (u32 i = 0; i < e_configCount; ++i)
+		{
+			delete m_stacks[i];
+		}
+	}
+
+	void Step()
+	{
+		Test::Step();
+
+		float32 dt = g_testSettings->inv_hertz;
+		u32 positionIterations = g_testSettings->positionIterations;
+
+		for (u32 i = 0; i < e_configCount; ++i)
+		{
+			b3World& world = m_stacks[i]->m_world;
+			world.SetWarmStart(g_testSettings->warmStart);
+
+			b3Time time;
+			world.Step(dt, m_velocityIterations[i], positionIterations);
+			time.Update();
+
+			// Smooth the step time.
+			m_times[i] = 0.9 * m_times[i] + 0.1 * time.GetCurrentMilis();
+
+			world.Draw();
+		}
+
+		for (u32 i = 0; i < e_configCount; ++i)
+		{
+			SubStepStack* stack = m_stacks[i];
+
+			g_draw->DrawString(b3Color_white, "%d Iterations %d Sub-Steps", m_velocityIterations[i], m_subStepCounts[i]);
+			g_draw->DrawString(b3Color_white, "Step %f ms Top Drift %f Max Speed %f", m_times[i], stack->GetTopDrift(), stack->GetMaxSpeed());
+		}
+	}
+
+	static Test* Create()
+	{
+		return new SubStepBenchmark();
+	}
+
+	SubStepStack* m_stacks[e_configCount];
+	u32 m_velocityIterations[e_configCount];
+	u32 m_subStepCounts[e_configCount];
+	float64 m_times[e_configCount];
+};
+
+#endif
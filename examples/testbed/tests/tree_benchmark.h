@@ -0,0 +1,170 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef TREE_BENCHMARK_H
+#define TREE_BENCHMARK_H
+
+// This benchmark measures the time spent traversing a large dynamic tree 
+// of random boxes with AABB queries and ray casts.
+// Press C to cycle the box count. The largest tree, with about a million 
+// boxes, does not fit in the L1 and L2 caches.
+class TreeBenchmark : public Test
+{
+public:
+	enum
+	{
+		e_sizeCount = 3,
+		e_queryCount = 1024,
+		e_rayCount = 1024
+	};
+
+	TreeBenchmark()
+	{
+		m_tree = NULL;
+		m_queryTime = 0.0;
+		m_rayTime = 0.0;
+
+		Build(0);
+	}
+
+	~TreeBenchmark()
+	{
+		delete m_tree;
+	}
+
+	void Build(u32 size)
+	{
+		// The extent grows with the cube root of the box count 
+		// so that the box density stays the same.
+		static const u32 counts[e_sizeCount] = { 32768, 131072, 1048576 };
+		static const float32 extents[e_sizeCount] = { 100.0f, 158.7f, 317.5f };
+
+		delete m_tree;
+		m_tree = new b3DynamicTree();
+
+		m_size = size;
+		m_count = counts[size];
+		m_extent = extents[size];
+
+		for (u32 i = 0; i < m_count; ++i)
+		{
+			b3AABB3 aabb = RandomAABB(0.1f, 1.0f);
+			m_tree->InsertNode(aabb, NULL);
+		}
+
+		for (u32 i = 0; i < e_queryCount; ++i)
+		{
+			m_queries[i] = RandomAABB(1.0f, 4.0f);
+		}
+
+		for (u32 i = 0; i < e_rayCount; ++i)
+		{
+			m_rays[i].p1.Set(RandomFloat(-m_extent, m_extent), RandomFloat(-m_extent, m_extent), RandomFloat(-m_extent, m_extent));
+			m_rays[i].p2.Set(RandomFloat(-m_extent, m_extent), RandomFloat(-m_extent, m_extent), RandomFloat(-m_extent, m_extent));
+			m_rays[i].maxFraction = 1.0f;
+		}
+	}
+
+	void KeyDown(int button)
+	{
+		if (button == GLFW_KEY_C)
+		{
+			Build((m_size + 1) % e_sizeCount);
+		}
+	}
+
+	b3AABB3 RandomAABB(float32 minSize, float32 maxSize)
+	{
+		b3Vec3 center;
+		center.x = RandomFloat(-m_extent, m_extent);
+		center.y = RandomFloat(-m_extent, m_extent);
+		center.z = RandomFloat(-m_extent, m_extent);
+
+		b3Vec3 h;
+		h.x = RandomFloat(minSize, maxSize);
+		h.y = RandomFloat(minSize, maxSize);
+		h.z = RandomFloat(minSize, maxSize);
+
+		b3AABB3 aabb;
+		aabb.m_lower = center - h;
+		aabb.m_upper = center + h;
+		return aabb;
+	}
+
+	bool Report(u32 proxyId)
+	{
+		B3_NOT_USED(proxyId);
+		++m_queryHits;
+		return true;
+	}
+
+	float32 Report(const b3RayCastInput& input, u32 proxyId)
+	{
+		B3_NOT_USED(proxyId);
+		++m_rayHits;
+		return input.maxFraction;
+	}
+
+	void Step()
+	{
+		Test::Step();
+
+		m_queryHits = 0;
+		b3Time queryTime;
+		for (u32 i = 0; i < e_queryCount; ++i)
+		{
+			m_tree->QueryAABB(this, m_queries[i]);
+		}
+		queryTime.Update();
+
+		m_rayHits = 0;
+		b3Time rayTime;
+		for (u32 i = 0; i < e_rayCount; ++i)
+		{
+			m_tree->RayCast(this, m_rays[i]);
+		}
+		rayTime.Update();
+
+		m_queryTime = queryTime.GetCurrentMilis();
+		m_rayTime = rayTime.GetCurrentMilis();
+
+		g_draw->DrawString(b3Color_white, "Boxes %d, tree height %d", m_count, m_tree->GetHeight());
+		g_draw->DrawString(b3Color_white, "%d AABB queries %f ms (%d hits)", e_queryCount, m_queryTime, m_queryHits);
+		g_draw->DrawString(b3Color_white, "%d ray casts %f ms (%d hits)", e_rayCount, m_rayTime, m_rayHits);
+		g_draw->DrawString(b3Color_white, "C - Box count");
+	}
+
+	static Test* Create()
+	{
+		return new TreeBenchmark();
+	}
+
+	u32 m_size;
+	u32 m_count;
+	float32 m_extent;
+	b3DynamicTree* m_tree;
+	b3AABB3 m_queries[e_queryCount];
+	b3RayCastInput m_rays[e_rayCount];
+
+	u32 m_queryHits;
+	u32 m_rayHits;
+	float64 m_queryTime;
+	float64 m_rayTime;
+};
+
+#endif
@@ -0,0 +1,137 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef TREE_BUILDER_BENCHMARK_H
+#define TREE_BUILDER_BENCHMARK_H
+
+// This benchmark compares the static tree builders on an irregular 
+// triangle soup made of clusters of triangles of very different sizes.
+class TreeBuilderBenchmark : public Test
+{
+public:
+	enum
+	{
+		e_count = 65536,
+		e_clusterCount = 64,
+		e_queryCount = 4096,
+		e_treeCount = 3
+	};
+
+	struct Counter
+	{
+		bool Report(u32 proxyId)
+		{
+			B3_NOT_USED(proxyId);
+			++hits;
+			return true;
+		}
+
+		u32 hits;
+	};
+
+	TreeBuilderBenchmark()
+	{
+		b3AABB3* aabbs = (b3AABB3*)b3Alloc(e_count * sizeof(b3AABB3));
+
+		b3Vec3 clusters[e_clusterCount];
+		for (u32 i = 0; i < e_clusterCount; ++i)
+		{
+			clusters[i].Set(RandomFloat(-100.0f, 100.0f), RandomFloat(-20.0f, 20.0f), RandomFloat(-100.0f, 100.0f));
+		}
+
+		for (u32 i = 0; i < e_count; ++i)
+		{
+			const b3Vec3& cluster = clusters[i % e_clusterCount];
+
+			b3Vec3 v1 = cluster + b3Vec3(RandomFloat(-10.0f, 10.0f), RandomFloat(-10.0f, 10.0f), RandomFloat(-10.0f, 10.0f));
+			
+			// A few large triangles among many small ones.
+			float32 size = i % 64 == 0 ? 20.0f : RandomFloat(0.05f, 1.0f);
+			b3Vec3 v2 = v1 + b3Vec3(RandomFloat(-size, size), RandomFloat(-size, size), RandomFloat(-size, size));
+			b3Vec3 v3 = v1 + b3Vec3(RandomFloat(-size, size), RandomFloat(-size, size), RandomFloat(-size, size));
+
+			aabbs[i].m_lower = b3Min(b3Min(v1, v2), v3);
+			aabbs[i].m_upper = b3Max(b3Max(v1, v2), v3);
+		}
+
+		m_names[0] = "Median, 1 per leaf";
+		m_defs[0].builder = e_medianBuilder;
+		m_defs[0].maxLeafSize = 1;
+
+		m_names[1] = "SAH, 1 per leaf";
+		m_defs[1].builder = e_sahBuilder;
+		m_defs[1].maxLeafSize = 1;
+
+		m_names[2] = "SAH, up to 4 per leaf";
+		m_defs[2].builder = e_sahBuilder;
+		m_defs[2].maxLeafSize = 4;
+
+		for (u32 i = 0; i < e_treeCount; ++i)
+		{
+			m_trees[i].Build(aabbs, e_count, m_defs[i]);
+		}
+
+		for (u32 i = 0; i < e_queryCount; ++i)
+		{
+			const b3AABB3& aabb = aabbs[RandomFloat(0.0f, 1.0f) < 0.5f ? i : e_count - 1 - i];
+			
+			b3Vec3 center = aabb.Centroid();
+			float32 r = RandomFloat(0.5f, 2.0f);
+
+			m_queries[i].m_lower = center - b3Vec3(r, r, r);
+			m_queries[i].m_upper = center + b3Vec3(r, r, r);
+		}
+
+		b3Free(aabbs);
+	}
+
+	void Step()
+	{
+		Test::Step();
+
+		g_draw->DrawString(b3Color_white, "Triangles %d", e_count);
+
+		for (u32 i = 0; i < e_treeCount; ++i)
+		{
+			Counter counter;
+			counter.hits = 0;
+
+			b3Time time;
+			for (u32 j = 0; j < e_queryCount; ++j)
+			{
+				m_trees[i].QueryAABB(&counter, m_queries[j]);
+			}
+			time.Update();
+
+			g_draw->DrawString(b3Color_white, "%s: build %f ms, cost %f, %d queries %f ms (%d hits)", 
+				m_names[i], m_trees[i].GetBuildTime(), m_trees[i].GetTraversalCost(), e_queryCount, time.GetCurrentMilis(), counter.hits);
+		}
+	}
+
+	static Test* Create()
+	{
+		return new TreeBuilderBenchmark();
+	}
+
+	const char* m_names[e_treeCount];
+	b3StaticTreeDef m_defs[e_treeCount];
+	b3StaticTree m_trees[e_treeCount];
+	b3AABB3 m_queries[e_queryCount];
+};
+
+#endif
@@ -24,6 +24,7 @@
 #include <bounce/common/settings.h>
 #include <bounce/common/time.h>
 #include <bounce/common/draw.h>
+#include <bounce/common/job_system.h>
 
 #include <bounce/common/math/math.h>
 
@@ -20,18 +20,22 @@
 #define B3_BROAD_PHASE_H
 
 #include <bounce/collision/trees/dynamic_tree.h>
-#include <algorithm>
+#include <bounce/collision/pair_hash.h>
 
-// A pair of broad-phase proxies.
-struct b3Pair
-{
-	u32 proxy1;
-	u32 proxy2;
-};
+class b3JobSystem;
+
+template<class T>
+struct b3ProxyCallback;
+
+// This bit is set in the indices of the proxies stored in the static tree.
+#define B3_STATIC_PROXY_BIT (0x80000000)
 
 // The broad-phase interface. 
 // It is used to perform ray casts, volume queries, and overlapping queries 
 // against AABBs.
+// Static and dynamic proxies are stored in two separate trees. 
+// Static proxies are never tested for overlap against each other 
+// and aren't fattened since they rarely move.
 class b3BroadPhase 
 {
 public:
@@ -39,8 +43,14 @@ public:
 	~b3BroadPhase();
 
 	// Create a proxy and return a index to it.
-	u32 CreateProxy(const b3AABB3& aabb, void* userData);
+	// Set isStatic to true if the proxy will rarely move, e.g. if it belongs to the level geometry.
+	u32 CreateProxy(const b3AABB3& aabb, void* userData, bool isStatic);
 	
+	// Create a list of proxies and output their indices.
+	// The proxies are inserted into the tree in one pass. 
+	// This is faster than creating the proxies one by one. 
+	void CreateProxies(u32* proxyIds, const b3AABB3* aabbs, void* const* userDatas, u32 count, bool isStatic);
+
 	// Destroy a given proxy and remove it from the broadphase.
 	void DestroyProxy(u32 proxyId);
 
@@ -53,6 +63,16 @@ public:
 	// Only moved proxies will be used internally as an AABB query reference object.
 	void BufferMove(u32 proxyId);
 
+	// Rebuild the trees from scratch. 
+	// This is usually called after a large number of proxies were created.
+	void RebuildTree();
+
+	// Incrementally optimize the dynamic tree by reinserting a given number of proxies.
+	void OptimizeTree(u32 proxyCount);
+
+	// Test if a given proxy is stored in the static tree.
+	bool IsStaticProxy(u32 proxyId) const;
+
 	// Get the AABB of a given proxy.
 	const b3AABB3& GetAABB(u32 proxyId) const;
 
@@ -71,24 +91,87 @@ public:
 	template<class T>
 	void RayCast(T* callback, const b3RayCastInput& input) const;
 
+	// Notify the client callback the AABBs that are hit by the rays of a packet.
+	template<class T>
+	void RayCastPacket(T* callback, b3RayPacket* packet) const;
+
 	// Find and store overlapping AABB pairs.
 	// Notify the client callback the AABB pairs that are overlapping.
 	// The client must store the notified pairs.
 	template<class T>
 	void FindPairs(T* callback);
 
+	// Set the job system used to find the overlapping pairs in parallel.
+	// The pairs are reported in the same order as when no job system is used.
+	// Set to NULL to find the pairs on the calling thread.
+	void SetJobSystem(b3JobSystem* jobSystem);
+
+	// Get the height of the dynamic tree.
+	// This can be used to track the degradation of the tree.
+	u32 GetTreeHeight() const;
+
+	// Get the maximum height difference between the children of any dynamic tree node.
+	u32 GetTreeBalance() const;
+
+	// Get the sum of the surface areas of all internal dynamic tree nodes.
+	float32 GetTreeInternalArea() const;
+
+	// Get the ratio of the sum of the internal dynamic tree node surface areas to the root surface area.
+	float32 GetTreeQuality() const;
+
+	// Get the height of the static tree.
+	u32 GetStaticTreeHeight() const;
+
 	// Draw the proxy AABBs.
 	void Draw() const;
 private :
-	friend class b3DynamicTree;
+	template<class T>
+	friend struct b3ProxyCallback;
+	friend struct b3PairQueryCallback;
 	
+	// The pairs found by a thread.
+	struct b3PairBuffer
+	{
+		b3Pair* pairs;
+		u32 count;
+		u32 capacity;
+	};
+
+	// A contiguous range of the move buffer queried by a task.
+	// Its pairs are stored in a range of a thread pair buffer.
+	struct b3PairTask
+	{
+		u32 threadIndex;
+		u32 pairIndex;
+		u32 pairCount;
+	};
+
 	// The client callback used to add an overlapping pair
 	// to the overlapping pair buffer.
 	bool Report(u32 proxyId);
+
+	// Add a pair to the overlapping pair buffer if it wasn't found yet.
+	void AddPair(u32 proxy1, u32 proxy2);
+
+	// Find the unique overlapping pairs of the moved proxies.
+	void UpdatePairs();
+
+	// Find the unique overlapping pairs of the moved proxies using the job system.
+	void UpdatePairsParallel();
+
+	// Execute the queries of a range of pair tasks.
+	static void QueryTasks(void* context, u32 begin, u32 end, u32 threadIndex);
 	
-	// The dynamic tree.
+	// Query the trees for the proxies overlapping a moved proxy.
+	template<class T>
+	void QueryMovedProxy(T* callback, u32 proxyId) const;
+
+	// The tree storing the proxies that can move.
 	b3DynamicTree m_tree;
 
+	// The tree storing the static proxies.
+	b3DynamicTree m_staticTree;
+
 	// The current proxy being queried for overlap with another proxies. 
 	// It is used to avoid a proxy overlap with itself.
 	u32 m_queryProxyId;
@@ -102,97 +185,229 @@ private :
 	b3Pair* m_pairs;
 	u32 m_pairCapacity;
 	u32 m_pairCount;
+
+	// The set of pairs found in a step. 
+	// It is used to prune duplicated pairs as they are found.
+	b3PairHash m_pairSet;
+
+	// The job system.
+	b3JobSystem* m_jobSystem;
+
+	// The per-thread pair buffers used when finding pairs in parallel.
+	b3PairBuffer* m_threadBuffers;
+	u32 m_threadBufferCount;
+
+	// The tasks used when finding pairs in parallel.
+	b3PairTask* m_tasks;
+	u32 m_taskCapacity;
+};
+
+// Converts the node indices reported by one of the broad-phase trees 
+// to proxy indices and forwards them to the client callback.
+template<class T>
+struct b3ProxyCallback
+{
+	bool Report(u32 nodeId)
+	{
+		if (callback->Report(nodeId | proxyBit) == false)
+		{
+			stopped = true;
+			return false;
+		}
+		return true;
+	}
+
+	float32 Report(const b3RayCastInput& input, u32 nodeId)
+	{
+		float32 fraction = callback->Report(input, nodeId | proxyBit);
+		if (b3ClipRayCast(maxFraction, fraction) == false)
+		{
+			stopped = true;
+		}
+		return fraction;
+	}
+
+	float32 Report(const b3RayCastInput& input, u32 nodeId, u32 lane)
+	{
+		return callback->Report(input, nodeId | proxyBit, lane);
+	}
+
+	T* callback;
+	u32 proxyBit;
+	bool stopped;
+	
+	// The ray cast fraction clipped by the first tree.
+	float32 maxFraction;
 };
 
+inline bool b3BroadPhase::IsStaticProxy(u32 proxyId) const
+{
+	return (proxyId & B3_STATIC_PROXY_BIT) != 0;
+}
+
 inline const b3AABB3& b3BroadPhase::GetAABB(u32 proxyId) const 
 {
+	if (IsStaticProxy(proxyId))
+	{
+		return m_staticTree.GetAABB(proxyId & ~B3_STATIC_PROXY_BIT);
+	}
 	return m_tree.GetAABB(proxyId);
 }
 
 inline void* b3BroadPhase::GetUserData(u32 proxyId) const 
 {
+	if (IsStaticProxy(proxyId))
+	{
+		return m_staticTree.GetUserData(proxyId & ~B3_STATIC_PROXY_BIT);
+	}
 	return m_tree.GetUserData(proxyId);
 }
 
+inline void b3BroadPhase::SetJobSystem(b3JobSystem* jobSystem)
+{
+	m_jobSystem = jobSystem;
+}
+
+inline void b3BroadPhase::RebuildTree()
+{
+	m_tree.Rebuild();
+	m_staticTree.Rebuild();
+}
+
+inline void b3BroadPhase::OptimizeTree(u32 proxyCount)
+{
+	m_tree.Optimize(proxyCount);
+}
+
+inline u32 b3BroadPhase::GetTreeHeight() const
+{
+	return m_tree.GetHeight();
+}
+
+inline u32 b3BroadPhase::GetTreeBalance() const
+{
+	return m_tree.GetMaxBalance();
+}
+
+inline float32 b3BroadPhase::GetTreeInternalArea() const
+{
+	return m_tree.GetInternalArea();
+}
+
+inline float32 b3BroadPhase::GetTreeQuality() const
+{
+	return m_tree.GetAreaRatio();
+}
+
+inline u32 b3BroadPhase::GetStaticTreeHeight() const
+{
+	return m_staticTree.GetHeight();
+}
+
 template<class T>
 inline void b3BroadPhase::QueryAABB(T* callback, const b3AABB3& aabb) const 
 {
-	return m_tree.QueryAABB(callback, aabb);
+	b3ProxyCallback<T> proxyCallback;
+	proxyCallback.callback = callback;
+	proxyCallback.proxyBit = 0;
+	proxyCallback.stopped = false;
+	
+	m_tree.QueryAABB(&proxyCallback, aabb);
+	
+	if (proxyCallback.stopped)
+	{
+		return;
+	}
+
+	proxyCallback.proxyBit = B3_STATIC_PROXY_BIT;
+	m_staticTree.QueryAABB(&proxyCallback, aabb);
 }
 
 template<class T>
 inline void b3BroadPhase::RayCast(T* callback, const b3RayCastInput& input) const 
 {
-	return m_tree.RayCast(callback, input);
-}
+	b3ProxyCallback<T> proxyCallback;
+	proxyCallback.callback = callback;
+	proxyCallback.proxyBit = 0;
+	proxyCallback.stopped = false;
+	proxyCallback.maxFraction = input.maxFraction;
 
-static B3_FORCE_INLINE bool operator<(const b3Pair& pair1, const b3Pair& pair2) 
-{
-	if (pair1.proxy1 < pair2.proxy1) 
+	m_tree.RayCast(&proxyCallback, input);
+
+	if (proxyCallback.stopped)
 	{
-		return true;
+		return;
 	}
 
-	if (pair1.proxy1 == pair2.proxy1) 
+	// Don't look for static proxies behind the clipped ray.
+	b3RayCastInput staticInput = input;
+	staticInput.maxFraction = proxyCallback.maxFraction;
+
+	proxyCallback.proxyBit = B3_STATIC_PROXY_BIT;
+	m_staticTree.RayCast(&proxyCallback, staticInput);
+}
+
+template<class T>
+inline void b3BroadPhase::RayCastPacket(T* callback, b3RayPacket* packet) const
+{
+	b3ProxyCallback<T> proxyCallback;
+	proxyCallback.callback = callback;
+	proxyCallback.proxyBit = 0;
+	proxyCallback.stopped = false;
+
+	m_tree.RayCastPacket(&proxyCallback, packet);
+
+	if (packet->activeMask == 0)
 	{
-		return pair1.proxy2 < pair2.proxy2;
+		return;
 	}
 
-	return false;
+	// The packet keeps the fractions clipped by the first tree.
+	proxyCallback.proxyBit = B3_STATIC_PROXY_BIT;
+	m_staticTree.RayCastPacket(&proxyCallback, packet);
 }
 
 template<class T>
-inline void b3BroadPhase::FindPairs(T* callback) 
+inline void b3BroadPhase::QueryMovedProxy(T* callback, u32 proxyId) const
 {
-	// Reset the overlapping pairs buffer count for the current step.
-	m_pairCount = 0;
+	b3ProxyCallback<T> proxyCallback;
+	proxyCallback.callback = callback;
+	proxyCallback.stopped = false;
 
-	// Notifying this class with QueryCallback(), gets the (duplicated) overlapping pair buffer.
-	for (u32 i = 0; i < m_moveBufferCount; ++i) 
-	{
-		// Keep the current queried proxy ID to avoid self overlapping.
-		m_queryProxyId = m_moveBuffer[i];
-		if (m_queryProxyId == B3_NULL_NODE_D) 
-		{
-			continue;
-		}
+	const b3AABB3& aabb = GetAABB(proxyId);
 
-		const b3AABB3& aabb = m_tree.GetAABB(m_queryProxyId);
-		m_tree.QueryAABB(this, aabb);
+	// Static proxies only need to be tested against dynamic proxies.
+	proxyCallback.proxyBit = 0;
+	m_tree.QueryAABB(&proxyCallback, aabb);
+
+	if (IsStaticProxy(proxyId) == false)
+	{
+		proxyCallback.proxyBit = B3_STATIC_PROXY_BIT;
+		m_staticTree.QueryAABB(&proxyCallback, aabb);
 	}
+}
+
+template<class T>
+inline void b3BroadPhase::FindPairs(T* callback) 
+{
+	// Get the unique overlapping pair buffer.
+	UpdatePairs();
 
 	// Reset the move buffer for the next step.
 	m_moveBufferCount = 0;
 
-	// Sort the (duplicated) overlapping pair buffer to prune duplicated pairs.
-	std::sort(m_pairs, m_pairs + m_pairCount);
-
-	// Skip duplicated overlapping pairs.
-	u32 index = 0;
-	while (index < m_pairCount) 
+	// Report the unique overlapping pairs to the client in the order they were found.
+	for (u32 i = 0; i < m_pairCount; ++i)
 	{
-		const b3Pair* primaryPair = m_pairs + index;
-
-		// Report an unique overlapping pair to the client.
-		callback->AddPair(m_tree.GetUserData(primaryPair->proxy1), m_tree.GetUserData(primaryPair->proxy2));
-
-		// Skip all duplicated pairs until an unique pair is found.
-		++index;
-		while (index < m_pairCount) 
-		{
-			const b3Pair* secondaryPair = m_pairs + index;
-			if (secondaryPair->proxy1 != primaryPair->proxy1 || secondaryPair->proxy2 != primaryPair->proxy2) 
-			{
-				break;
-			}
-			++index;
-		}
+		const b3Pair* pair = m_pairs + i;
+		callback->AddPair(GetUserData(pair->proxy1), GetUserData(pair->proxy2));
 	}
 }
 
 inline void b3BroadPhase::Draw() const
 {
 	m_tree.Draw();
+	m_staticTree.Draw();
 }
 
 #endif
\ No newline at end of file
@@ -114,4 +114,29 @@ b3GJKOutput b3GJK(const b3Transform& xf1, const b3GJKProxy& proxy1,
 	const b3Transform& xf2, const b3GJKProxy& proxy2,
 	bool applyRadius, b3SimplexCache* cache);
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The output of a GJK shape cast.
+// It contains the time of impact between two proxies 
+// and the contact point and normal at that time.
+struct b3GJKShapeCastOutput
+{
+	float32 t; // time of impact as a fraction of the translation
+	b3Vec3 point; // contact point on proxy 1 
+	b3Vec3 normal; // contact normal pointing from proxy 1 to proxy 2
+	u32 iterations; // number of conservative advancement iterations
+};
+
+// Find the first time of impact between two proxies when proxy 2 
+// is translated by a given translation.
+// The time of impact is found using conservative advancement on the GJK distance, 
+// which stops the proxies slightly before they touch. 
+// Return false if the proxies don't hit each other before maxFraction.
+// If the proxies are initially touching then the time of impact is zero. 
+// If they are initially overlapping then the normal is also zero.
+bool b3GJKShapeCast(b3GJKShapeCastOutput* output, 
+	const b3Transform& xf1, const b3GJKProxy& proxy1,
+	const b3Transform& xf2, const b3GJKProxy& proxy2, 
+	const b3Vec3& translation2, float32 maxFraction);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,82 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B3_PAIR_HASH_H
+#define B3_PAIR_HASH_H
+
+#include <bounce/common/settings.h>
+
+// A pair of broad-phase proxies.
+struct b3Pair
+{
+	u32 proxy1;
+	u32 proxy2;
+};
+
+// An open-addressing hash table keyed on unordered pairs of proxies. 
+// The pair (a, b) is the same as the pair (b, a).
+// Each pair can be associated with a user data.
+// Lookups, insertions and removals run in expected constant time.
+class b3PairHash
+{
+public:
+	b3PairHash();
+	~b3PairHash();
+
+	// Insert a pair and associate it with a given user data.
+	// Return true if the pair was inserted or false if the pair is already in the table.
+	bool Insert(u32 proxy1, u32 proxy2, void* userData);
+
+	// Remove a pair from the table. 
+	// Return true if the pair was removed or false if the pair is not in the table.
+	bool Remove(u32 proxy1, u32 proxy2);
+
+	// Get the user data associated with a pair.
+	// Return NULL if the pair is not in the table.
+	void* Find(u32 proxy1, u32 proxy2) const;
+
+	// Remove all pairs from the table. 
+	// The capacity of the table is kept.
+	void Clear();
+
+	// Get the number of pairs in the table.
+	u32 GetCount() const;
+private:
+	struct b3Entry
+	{
+		b3Pair pair;
+		void* userData;
+	};
+
+	// Find the slot of a pair or the empty slot where the pair should be inserted.
+	u32 FindSlot(u32 proxy1, u32 proxy2) const;
+
+	// Double the capacity of the table and reinsert all pairs.
+	void Grow();
+
+	b3Entry* m_entries;
+	u32 m_capacity;
+	u32 m_count;
+};
+
+inline u32 b3PairHash::GetCount() const
+{
+	return m_count;
+}
+
+#endif
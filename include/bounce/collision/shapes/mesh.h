@@ -53,6 +53,35 @@ struct b3Mesh
 	b3AABB3 GetTriangleAABB(u32 index) const;
 
 	void BuildTree();
+
+	// Build the tree using given settings.
+	void BuildTree(const b3StaticTreeDef& def);
+	
+	// Build the tree and its 4-ary version.
+	// The queries against this mesh then test four AABBs at once.
+	void BuildWideTree();
+
+	// Build the tree and quantize its nodes.
+	// The tree then takes less than half of the memory at the cost of 
+	// a few more triangles reported near the leaf boundaries. 
+	// The regular nodes are kept if the tree can't be quantized.
+	void BuildQuantizedTree();
+
+	// Get the number of bytes needed to cook this mesh.
+	u32 GetCookedSize() const;
+
+	// Write the vertices, the triangles and the tree of this mesh into a 
+	// buffer of GetCookedSize() bytes aligned to B3_COOKED_TREE_ALIGNMENT.
+	// The tree must have been built.
+	void Cook(void* buffer) const;
+
+	// Use a cooked mesh in place without copying or building anything. 
+	// The vertices, the triangles and the tree of this mesh point into the buffer 
+	// afterwards, so the buffer must stay valid while this mesh is used. 
+	// A memory-mapped file can be shared by many processes this way.
+	// Return false if the buffer is not a valid cooked mesh of this version. 
+	// The whole buffer is validated first, so this mesh is left unchanged if false is returned.
+	bool Load(const void* buffer, u32 size);
 };
 
 inline const b3Vec3& b3Mesh::GetVertex(u32 index) const
@@ -90,6 +119,12 @@ inline b3AABB3 b3Mesh::GetTriangleAABB(u32 index) const
 }
 
 inline void b3Mesh::BuildTree()
+{
+	b3StaticTreeDef def;
+	BuildTree(def);
+}
+
+inline void b3Mesh::BuildTree(const b3StaticTreeDef& def)
 {
 	b3AABB3* aabbs = (b3AABB3*)b3Alloc(triangleCount * sizeof(b3AABB3));
 	for (u32 i = 0; i < triangleCount; ++i)
@@ -97,9 +132,21 @@ inline void b3Mesh::BuildTree()
 		aabbs[i] = GetTriangleAABB(i);
 	}
 
-	tree.Build(aabbs, triangleCount);
+	tree.Build(aabbs, triangleCount, def);
 
 	b3Free(aabbs);
 }
 
+inline void b3Mesh::BuildWideTree()
+{
+	BuildTree();
+	tree.BuildWide();
+}
+
+inline void b3Mesh::BuildQuantizedTree()
+{
+	BuildTree();
+	tree.Quantize();
+}
+
 #endif
@@ -0,0 +1,52 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B3_TIME_OF_IMPACT_H
+#define B3_TIME_OF_IMPACT_H
+
+#include <bounce/common/math/transform.h>
+
+struct b3GJKProxy;
+
+// The state of a time of impact computation.
+enum b3TOIState
+{
+	e_toiFailed, // the maximum number of iterations was reached
+	e_toiOverlapped, // the proxies overlap at the beginning of the sweeps
+	e_toiTouching, // the proxies touch at the time of impact
+	e_toiSeparated // the proxies don't touch before the maximum time
+};
+
+// The output of the time of impact computation.
+struct b3TOIOutput
+{
+	b3TOIState state; // time of impact state
+	float32 t; // time of impact in the sweep interval
+	u32 iterations; // number of conservative advancement iterations
+};
+
+// Compute the time of impact between two proxies moving along their sweeps 
+// in the interval [0, tMax].
+// This uses conservative advancement on the GJK distance and a bound 
+// on the linear and angular motion of the proxies. 
+// At the time of impact the proxies overlap by a few linear slops, 
+// so that contact points can be generated for them.
+b3TOIOutput b3TimeOfImpact(const b3Sweep& sweep1, const b3GJKProxy& proxy1,
+	const b3Sweep& sweep2, const b3GJKProxy& proxy2, float32 tMax);
+
+#endif
@@ -20,12 +20,15 @@
 #define B3_DYNAMIC_TREE_H
 
 #include <bounce/common/template/stack.h>
+#include <bounce/collision/trees/tree_traversal.h>
 #include <bounce/collision/shapes/aabb3.h>
 #include <bounce/collision/collision.h>
 
 #define B3_NULL_NODE_D (0xFFFFFFFF)
 
 // AABB tree for dynamic AABBs.
+// The node data used by the traversals is stored apart from the data used 
+// to update the tree so that queries touch less memory.
 class b3DynamicTree 
 {
 public :
@@ -35,12 +38,33 @@ public :
 	// Insert a node into the tree and return its ID.
 	u32 InsertNode(const b3AABB3& aabb, void* userData);
 	
+	// Insert a list of nodes into the tree and output their IDs.
+	// The nodes are assembled into a subtree in one pass and the subtree 
+	// is inserted into the tree as a whole. 
+	// This is much faster than inserting the nodes one by one 
+	// if the AABBs are spatially coherent.
+	void InsertNodes(u32* proxyIds, const b3AABB3* aabbs, void* const* userDatas, u32 count);
+
 	// Remove a node from the tree.
 	void RemoveNode(u32 proxyId);
 
 	// Update a node AABB.
 	void UpdateNode(u32 proxyId, const b3AABB3& aabb);
 
+	// Rebuild the hierarchy of this tree from scratch using a top-down 
+	// binned surface area heuristic (SAH) builder. 
+	// The proxy IDs remain valid.
+	// This is expensive but produces a high quality tree. 
+	// It is usually called once after a large number of insertions 
+	// such as after loading a level.
+	void Rebuild();
+
+	// Incrementally improve the hierarchy of this tree by reinserting 
+	// a given number of leaves. 
+	// Each call resumes from where the last call has stopped, so 
+	// the whole tree is eventually optimized over many calls.
+	void Optimize(u32 leafCount);
+
 	// Get the (fat) AABB of a given proxy.
 	const b3AABB3& GetAABB(u32 proxyId) const;
 
@@ -58,16 +82,41 @@ public :
 
 	// Keep reporting the client callback all AABBs that are overlapping with
 	// the given ray. The client callback must return the new intersection fraction.
+	// The nodes are visited from front to back and the ray is clipped 
+	// to the returned fraction if it is smaller. 
 	// If the fraction == 0 then the query is cancelled immediately.
 	template<class T>
 	void RayCast(T* callback, const b3RayCastInput& input) const;
 
+	// Report the client callback the AABBs hit by the rays of a packet.
+	// The rays walk the tree together. The client callback is called with the lane 
+	// of the ray and must return the new intersection fraction of the ray.
+	// If the fraction == 0 then the ray is stopped.
+	template<class T>
+	void RayCastPacket(T* callback, b3RayPacket* packet) const;
+
+	// Get the height of this tree. 
+	// The height of an empty tree is zero.
+	u32 GetHeight() const;
+
+	// Get the maximum height difference between the children of any internal node.
+	u32 GetMaxBalance() const;
+
+	// Get the sum of the surface areas of all internal nodes.
+	float32 GetInternalArea() const;
+
+	// Get the ratio of the sum of the internal node surface areas to the root surface area.
+	// This is a measure of the quality of the tree. Lower is better.
+	float32 GetAreaRatio() const;
+
 	// Validate a given node of this tree.
 	void Validate(u32 node) const;
 
 	// Draw this tree.
 	void Draw() const;
 private :
+	// The node data read by the traversals.
+	// It is 32 bytes, so two nodes share a cache line.
 	struct b3Node 
 	{
 		// Is this node a leaf?
@@ -80,24 +129,25 @@ private :
 		// The fattened node AABB.
 		b3AABB3 aabb;
 
-		// The associated user data.
-		void* userData;
+		u32 child1;
+		u32 child2;
+	};
 
+	// The node data only used to update the tree.
+	struct b3NodeInfo
+	{
 		union 
 		{
 			u32 parent;
 			u32 next;
 		};
 
-		u32 child1;
-		u32 child2;
-
 		// Flag
 		// leaf if 0, free node if -1
 		i32 height;
 	};
 	
-	// Insert a node into the tree.
+	// Insert a leaf or a subtree root into the tree.
 	void InsertLeaf(u32 node);
 	
 	// Remove a node from the tree.
@@ -105,6 +155,15 @@ private :
 
 	// Rebuild the hierarchy starting from the given node.
 	void WalkBackNodeAndCombineVolumes(u32 node);
+
+	// Build a subtree from a list of leaves using the binned SAH. 
+	// The depth of the subtree root is used to bound the tree height.
+	// Return the root of the subtree.
+	u32 BuildTopDown(u32* leaves, u32 count, u32 depth);
+
+	// Perform a left or right rotation if the given node is imbalanced.
+	// Return the index of the node that replaces the given node in the hierarchy.
+	u32 Balance(u32 node);
 	
 	// Find the best node that can be merged with a given AABB.
 	u32 FindBest(const b3AABB3& aabb) const;
@@ -122,11 +181,21 @@ private :
 	// The root of this tree.
 	u32 m_root;
 
-	// The nodes of this tree stored in an array.
+	// The nodes of this tree stored in an array aligned to a cache line.
 	b3Node* m_nodes;
+	
+	// The hierarchy information of each node.
+	b3NodeInfo* m_nodeInfos;
+	
+	// The user data of each node.
+	void** m_userDatas;
+
 	u32 m_nodeCount;
 	u32 m_nodeCapacity;
 	u32 m_freeList;
+
+	// The bit path used to select the next leaf to be reinserted by Optimize.
+	u32 m_path;
 };
 
 inline const b3AABB3& b3DynamicTree::GetAABB(u32 proxyId) const
@@ -138,7 +207,7 @@ inline const b3AABB3& b3DynamicTree::GetAABB(u32 proxyId) const
 inline void* b3DynamicTree::GetUserData(u32 proxyId) const
 {
 	B3_ASSERT(proxyId != B3_NULL_NODE_D && proxyId < m_nodeCapacity);
-	return m_nodes[proxyId].userData;
+	return m_userDatas[proxyId];
 }
 
 inline bool b3DynamicTree::TestOverlap(u32 proxy1, u32 proxy2) const
@@ -151,18 +220,17 @@ inline bool b3DynamicTree::TestOverlap(u32 proxy1, u32 proxy2) const
 template<class T>
 inline void b3DynamicTree::QueryAABB(T* callback, const b3AABB3& aabb) const 
 {
-	b3Stack<u32, 256> stack;
+	if (m_root == B3_NULL_NODE_D)
+	{
+		return;
+	}
+
+	b3TreeStack<u32, 2> stack;
 	stack.Push(m_root);
 
 	while (stack.IsEmpty() == false) 
 	{
-		u32 nodeIndex = stack.Top();
-		stack.Pop();
-
-		if (nodeIndex == B3_NULL_NODE_D)
-		{
-			continue;
-		}
+		u32 nodeIndex = stack.Pop();
 
 		const b3Node* node = m_nodes + nodeIndex;
 
@@ -187,6 +255,11 @@ inline void b3DynamicTree::QueryAABB(T* callback, const b3AABB3& aabb) const
 template<class T>
 inline void b3DynamicTree::RayCast(T* callback, const b3RayCastInput& input) const 
 {
+	if (m_root == B3_NULL_NODE_D)
+	{
+		return;
+	}
+
 	b3Vec3 p1 = input.p1;
 	b3Vec3 p2 = input.p2;
 	b3Vec3 d = p2 - p1;
@@ -195,41 +268,97 @@ inline void b3DynamicTree::RayCast(T* callback, const b3RayCastInput& input) con
 	// Ensure non-degenerate segment.
 	B3_ASSERT(b3Dot(d, d) > B3_EPSILON * B3_EPSILON);
 
-	b3Stack<u32, 256> stack;
-	stack.Push(m_root);
+	b3RayCastStack stack;
+
+	float32 rootFraction = 0.0f;
+	if (m_nodes[m_root].aabb.TestRay(p1, p2, maxFraction, rootFraction) == true)
+	{
+		b3PushRayCastNode(stack, m_root, rootFraction);
+	}
 
+	// Visit the nodes from front to back.
 	while (stack.IsEmpty() == false) 
 	{
-		u32 nodeIndex = stack.Top();
-		
-		stack.Pop();
+		b3RayCastNode rayNode = stack.Pop();
 
-		if (nodeIndex == B3_NULL_NODE_D) 
+		if (rayNode.fraction > maxFraction)
 		{
+			// The ray was clipped before this node.
 			continue;
 		}
 
-		const b3Node* node = m_nodes + nodeIndex;
+		const b3Node* node = m_nodes + rayNode.node;
 
-		float32 minFraction = 0.0f;
-		if (node->aabb.TestRay(p1, p2, maxFraction, minFraction) == true) 
+		if (node->IsLeaf() == true) 
 		{
-			if (node->IsLeaf() == true) 
+			b3RayCastInput subInput;
+			subInput.p1 = input.p1;
+			subInput.p2 = input.p2;
+			subInput.maxFraction = maxFraction;
+
+			float32 newFraction = callback->Report(subInput, rayNode.node);
+
+			if (b3ClipRayCast(maxFraction, newFraction) == false)
 			{
-				b3RayCastInput subInput;
-				subInput.p1 = input.p1;
-				subInput.p2 = input.p2;
-				subInput.maxFraction = maxFraction;
+				// The client has stopped the query.
+				return;
+			}
+		}
+		else 
+		{
+			float32 fraction1 = 0.0f, fraction2 = 0.0f;
+			bool hit1 = m_nodes[node->child1].aabb.TestRay(p1, p2, maxFraction, fraction1);
+			bool hit2 = m_nodes[node->child2].aabb.TestRay(p1, p2, maxFraction, fraction2);
+
+			b3PushRayCastChildren(stack, node->child1, hit1, fraction1, node->child2, hit2, fraction2);
+		}
+	}
+}
 
-				float32 newFraction = callback->Report(subInput, nodeIndex);
+template<class T>
+inline void b3DynamicTree::RayCastPacket(T* callback, b3RayPacket* packet) const
+{
+	if (m_root == B3_NULL_NODE_D)
+	{
+		return;
+	}
+
+	b3TreeStack<u32, 2> stack;
+	stack.Push(m_root);
 
-				if (newFraction == 0.0f)
+	while (stack.IsEmpty() == false && packet->activeMask != 0)
+	{
+		u32 nodeIndex = stack.Pop();
+
+		const b3Node* node = m_nodes + nodeIndex;
+
+		// Test the node against the rays that weren't clipped before it.
+		u32 mask = packet->TestAABB(node->aabb);
+		if (mask == 0)
+		{
+			continue;
+		}
+
+		if (node->IsLeaf() == true)
+		{
+			for (u32 i = 0; i < 4; ++i)
+			{
+				if (mask & (1 << i))
 				{
-					// The client has stopped the query.
-					return;
+					float32 newFraction = callback->Report(packet->GetInput(i), nodeIndex, i);
+					packet->Clip(i, newFraction);
 				}
 			}
-			else 
+		}
+		else
+		{
+			// Visit the nearest child first.
+			if (packet->IsNearFirst(m_nodes[node->child1].aabb, m_nodes[node->child2].aabb))
+			{
+				stack.Push(node->child2);
+				stack.Push(node->child1);
+			}
+			else
 			{
 				stack.Push(node->child1);
 				stack.Push(node->child2);
@@ -20,27 +20,163 @@
 #define B3_STATIC_TREE_H
 
 #include <bounce/common/template/stack.h>
+#include <bounce/common/template/array.h>
+#include <bounce/collision/trees/tree_traversal.h>
 #include <bounce/collision/shapes/aabb3.h>
 #include <bounce/collision/collision.h>
+#include <bounce/common/math/simd.h>
 
 #define B3_NULL_NODE_S (0xFFFFFFFF)
 
+// This bit is set in the children of a wide node that are binary tree leaves.
+#define B3_WIDE_LEAF_BIT (0x80000000)
+
+// This bit is set in the data of a quantized node that is a leaf.
+#define B3_QUANTIZED_LEAF_BIT (0x80000000)
+
+// The maximum number of proxies in a leaf of a quantized tree.
+#define B3_QUANTIZED_MAX_LEAF_SIZE (64)
+
+// The version of the cooked tree format. 
+// Increment this when the layout of the nodes changes.
+#define B3_COOKED_TREE_VERSION (2)
+
+// The required alignment of a cooked tree in memory.
+#define B3_COOKED_TREE_ALIGNMENT (16)
+
+// Round up an offset in a cooked buffer to B3_COOKED_TREE_ALIGNMENT.
+inline u32 b3AlignCooked(u32 offset)
+{
+	return (offset + B3_COOKED_TREE_ALIGNMENT - 1) & ~(B3_COOKED_TREE_ALIGNMENT - 1);
+}
+
+// "B3ST"
+#define B3_COOKED_TREE_MAGIC (0x54533342)
+
+// The header of a cooked tree.
+// The offsets are relative to the beginning of the header.
+// The nodes are quantized nodes if the tree is quantized.
+struct b3CookedTreeHeader
+{
+	u32 magic;
+	u32 version;
+	u32 size;
+	u32 nodeCount;
+	u32 nodeOffset;
+	u32 proxyCount;
+	u32 proxyOffset;
+	u32 wideNodeCount;
+	u32 wideNodeOffset;
+	u32 quantized;
+	b3AABB3 quantizedAABB;
+	b3Vec3 quantizationScale;
+};
+
+class b3JobSystem;
+
+// The algorithm used to build a static tree.
+enum b3StaticTreeBuilder
+{
+	// Split each node at the centroid of its longest axis after sorting its AABBs. 
+	e_medianBuilder,
+
+	// Split each node where the binned surface area heuristic (SAH) is minimized.
+	e_sahBuilder
+};
+
+// The settings used to build a static tree.
+struct b3StaticTreeDef
+{
+	b3StaticTreeDef()
+	{
+		builder = e_sahBuilder;
+		maxLeafSize = 1;
+		jobSystem = NULL;
+	}
+
+	// The build algorithm.
+	b3StaticTreeBuilder builder;
+
+	// The maximum number of AABBs stored in a leaf.
+	// The SAH builder can store less AABBs in a leaf if it is cheaper.
+	// The queries report all AABBs of a leaf that passes the test 
+	// without testing them individually.
+	u32 maxLeafSize;
+
+	// If this is not NULL then the SAH builder builds the top levels of the tree 
+	// and builds the subtrees below in parallel using this job system.
+	// The resulting tree is the same as the one built on a single thread.
+	b3JobSystem* jobSystem;
+};
+
 // AABB tree for static AABBs.
+// A proxy is the position of an AABB in the tree and 
+// its user data is the index of the AABB in the list the tree was built from.
 class b3StaticTree 
 {
 public:
 	b3StaticTree();
 	~b3StaticTree();
 
-	// Build this tree from a list of AABBs.
+	// Build this tree from a list of AABBs using the default settings.
 	void Build(const b3AABB3* aabbs, u32 count);
 
-	// Get the AABB of a given proxy.
-	const b3AABB3& GetAABB(u32 proxyId) const;
+	// Build this tree from a list of AABBs.
+	void Build(const b3AABB3* aabbs, u32 count, const b3StaticTreeDef& def);
+
+	// Build a 4-ary tree from the binary tree. 
+	// The queries walk the 4-ary tree afterwards, testing 
+	// a box or a ray against four child AABBs at once.
+	// This must be called after Build.
+	void BuildWide();
+
+	// Return true if the queries walk the 4-ary tree.
+	bool IsWide() const;
+
+	// Replace the nodes of this tree with nodes that store their AABB as 16-bit 
+	// integers in the space of the root AABB. This takes less than half of the memory 
+	// of the regular nodes. The quantized AABBs are conservative, so the queries may 
+	// report a few more proxies near the boundary of a leaf AABB but never less.
+	// This must be called after Build and can't be used together with BuildWide.
+	// Return false and keep the regular nodes if a leaf has more than 
+	// B3_QUANTIZED_MAX_LEAF_SIZE proxies or the tree has more than 2^25 proxies.
+	bool Quantize();
+
+	// Return true if the nodes of this tree are quantized.
+	bool IsQuantized() const;
+
+	// Get the number of bytes needed to cook this tree.
+	u32 GetCookedSize() const;
+
+	// Write this tree into a buffer of GetCookedSize() bytes aligned to B3_COOKED_TREE_ALIGNMENT.
+	// The cooked tree stores offsets instead of pointers so it can be 
+	// saved to a file and loaded at any address.
+	void Cook(void* buffer) const;
+
+	// Use a cooked tree in place without copying it. 
+	// The buffer must stay valid and unchanged while this tree uses it.
+	// Return false if the buffer is not a valid cooked tree of this version. 
+	// This tree is left unchanged if false is returned.
+	bool Load(const void* buffer, u32 size);
+
+	// Return true if a buffer holds a valid cooked tree of this version whose 
+	// proxies are less than a given bound. 
+	// All arrays must be inside the buffer, all node indices must be in range, 
+	// no node can have two parents and the tree can't be deeper than B3_MAX_TREE_HEIGHT, 
+	// so a tree loaded from the buffer never reads out of bounds or overflows a walk.
+	static bool IsCookedValid(const void* buffer, u32 size, u32 proxyBound);
 
 	// Get the user data associated with a given proxy.
 	u32 GetUserData(u32 proxyId) const;
 
+	// Get the time spent in the last call to Build in milliseconds.
+	float64 GetBuildTime() const;
+
+	// Get the expected cost of a query against this tree according to the 
+	// surface area heuristic, relative to the cost of testing one AABB.
+	// Lower is better.
+	float32 GetTraversalCost() const;
+
 	// Report the client callback all AABBs that are overlapping with
 	// the given AABB. The client callback must return true if the query 
 	// must be stopped or false to continue looking for more overlapping pairs.
@@ -49,16 +185,29 @@ public:
 
 	// Report the client callback all AABBs that are overlapping with
 	// the given ray. The client callback must return the new intersection fraction 
-	// (real). If the fraction == 0 then the query is cancelled immediatly.
+	// (real). The nodes are visited from front to back and the ray is clipped 
+	// to the returned fraction if it is smaller. 
+	// If the fraction == 0 then the query is cancelled immediatly.
 	template<class T>
 	void RayCast(T* callback, const b3RayCastInput& input) const;
 
+	// Report the client callback the AABBs hit by the rays of a packet.
+	// The rays walk the binary or the quantized tree together. 
+	// The client callback is called with the lane of the ray and must return 
+	// the new intersection fraction of the ray.
+	// If the fraction == 0 then the ray is stopped.
+	template<class T>
+	void RayCastPacket(T* callback, b3RayPacket* packet) const;
+
 	// Draw this tree.
 	void Draw() const;
 
 	u32 GetSize() const;
-private :
+
+	// The node layouts are public so that tools can write and check cooked trees.
+
 	// A node in a static tree.
+	// A leaf stores a range of proxies.
 	struct b3Node
 	{
 		b3AABB3 aabb;
@@ -68,6 +217,7 @@ private :
 			u32 child2;
 			u32 index;
 		};
+		u32 count;
 
 		// Is this node a leaf?
 		bool IsLeaf() const
@@ -76,25 +226,197 @@ private :
 		}
 	};
 
-	// 
-	void Build(const b3AABB3* set, b3Node* node, u32* indices, u32 count, u32 minObjectsPerLeaf, u32 nodeCapacity, u32& leafCount, u32& internalCount);
+	// A node in the 4-ary tree.
+	// The child AABBs are stored as arrays of coordinates so they can be tested at once.
+	// A child is a wide node index, a binary tree leaf index with B3_WIDE_LEAF_BIT set, 
+	// or B3_NULL_NODE_S if the slot is empty. Empty slots are always the last ones.
+	struct b3WideNode
+	{
+		float32 lowerX[4];
+		float32 lowerY[4];
+		float32 lowerZ[4];
+		float32 upperX[4];
+		float32 upperY[4];
+		float32 upperZ[4];
+		u32 children[4];
+	};
+
+	// A node in the quantized tree.
+	// The nodes are stored in depth-first order so the first child 
+	// of an internal node is the next node.
+	// The data of an internal node is the index of its second child.
+	// The data of a leaf is its first proxy shifted by 6 bits, the number of its proxies 
+	// minus one, and B3_QUANTIZED_LEAF_BIT.
+	struct b3QuantizedNode
+	{
+		u16 lower[3];
+		u16 upper[3];
+		u32 data;
+
+		// Is this node a leaf?
+		bool IsLeaf() const
+		{
+			return (data & B3_QUANTIZED_LEAF_BIT) != 0;
+		}
+
+		// Get the first proxy of this leaf.
+		u32 GetIndex() const
+		{
+			return (data & ~B3_QUANTIZED_LEAF_BIT) >> 6;
+		}
+
+		// Get the number of proxies of this leaf.
+		u32 GetCount() const
+		{
+			return (data & 63) + 1;
+		}
+	};
+
+private :
+	// Free the memory of this tree if this tree owns it.
+	void Free();
+
+	// Build a subtree using the median builder.
+	void BuildMedian(const b3AABB3* set, b3Node* node, u32* indices, u32 count, u32 maxLeafSize, u32 nodeCapacity, u32 depth);
+
+	// A subtree built by a task.
+	// The task builds the subtree nodes in a reserved range of the node array.
+	struct b3SubtreeTask
+	{
+		u32 node;
+		u32 proxyIndex;
+		u32 proxyCount;
+		u32 nodeBase;
+		u32 nodeCount;
+		u32 depth;
+	};
+
+	// Build a subtree using the SAH builder.
+	// If a task list is given then subtrees with no more than taskSize AABBs 
+	// are added to the list instead of being built.
+	void BuildSAH(const b3AABB3* set, u32 node, u32* indices, u32 count, u32 maxLeafSize, 
+		u32& nodeCount, u32 nodeCapacity, u32 depth, u32 taskSize, b3Array<b3SubtreeTask>* tasks);
+
+	// Build the subtrees of a range of tasks.
+	static void BuildSubtrees(void* context, u32 begin, u32 end, u32 threadIndex);
+
+	// Build a wide node from the subtree rooted at a given binary node.
+	// Return the index of the wide node.
+	u32 BuildWide(u32 node);
+
+	// Copy a subtree into the quantized nodes in depth-first order.
+	void Quantize(u32 node, u32& quantizedCount);
+
+	// Convert a point into the space of the quantized nodes.
+	// The lower bound is rounded down and the upper bound is rounded up.
+	void QuantizeLower(u16 out[3], const b3Vec3& point) const;
+	void QuantizeUpper(u16 out[3], const b3Vec3& point) const;
+
+	// Get the AABB of a quantized node.
+	b3AABB3 GetQuantizedAABB(const b3QuantizedNode* node) const;
+
+	// Report a range of proxies hit by a ray and clip the ray.
+	// Return false if the client has stopped the query.
+	template<class T>
+	bool ReportRayCast(T* callback, const b3RayCastInput& input, u32 index, u32 count, float32& maxFraction) const;
+
+	// Report a range of proxies to the rays of a packet in a given mask.
+	template<class T>
+	void ReportRayPacket(T* callback, b3RayPacket* packet, u32 mask, u32 index, u32 count) const;
+
+	// Walk the quantized tree.
+	template<class T>
+	void QueryAABBQuantized(T* callback, const b3AABB3& aabb) const;
+
+	// Walk the quantized tree.
+	template<class T>
+	void RayCastQuantized(T* callback, const b3RayCastInput& input) const;
+
+	// Walk the 4-ary tree.
+	template<class T>
+	void QueryAABBWide(T* callback, const b3AABB3& aabb) const;
+	
+	// Walk the 4-ary tree.
+	template<class T>
+	void RayCastWide(T* callback, const b3RayCastInput& input) const;
 
 	// The nodes of this tree stored in an array.
+	// This is NULL if the nodes are quantized.
 	u32 m_nodeCount;
 	b3Node* m_nodes;
+
+	// The quantized nodes of this tree. 
+	// The number of quantized nodes is the node count.
+	// This is NULL if the nodes are not quantized.
+	b3QuantizedNode* m_quantizedNodes;
+	b3AABB3 m_quantizedAABB;
+	b3Vec3 m_quantizationScale;
+
+	// The user data of each proxy. 
+	// The proxies of a leaf are contiguous.
+	u32 m_proxyCount;
+	u32* m_proxies;
+
+	float64 m_buildTime;
+
+	// The nodes of the 4-ary tree. 
+	// This is NULL if the 4-ary tree wasn't built.
+	u32 m_wideNodeCount;
+	b3WideNode* m_wideNodes;
+
+	// This is false if this tree was loaded from a cooked buffer.
+	bool m_ownsMemory;
 };
 
-inline const b3AABB3& b3StaticTree::GetAABB(u32 proxyId) const
+inline bool b3StaticTree::IsWide() const
 {
-	B3_ASSERT(proxyId < m_nodeCount);
-	return m_nodes[proxyId].aabb;
+	return m_wideNodes != NULL;
+}
+
+inline bool b3StaticTree::IsQuantized() const
+{
+	return m_quantizedNodes != NULL;
+}
+
+inline void b3StaticTree::QuantizeLower(u16 out[3], const b3Vec3& point) const
+{
+	for (u32 i = 0; i < 3; ++i)
+	{
+		float32 x = std::floor((point[i] - m_quantizedAABB.m_lower[i]) * m_quantizationScale[i]);
+		out[i] = u16(b3Clamp(x, 0.0f, 65535.0f));
+	}
+}
+
+inline void b3StaticTree::QuantizeUpper(u16 out[3], const b3Vec3& point) const
+{
+	for (u32 i = 0; i < 3; ++i)
+	{
+		float32 x = std::ceil((point[i] - m_quantizedAABB.m_lower[i]) * m_quantizationScale[i]);
+		out[i] = u16(b3Clamp(x, 0.0f, 65535.0f));
+	}
+}
+
+inline b3AABB3 b3StaticTree::GetQuantizedAABB(const b3QuantizedNode* node) const
+{
+	b3AABB3 aabb;
+	for (u32 i = 0; i < 3; ++i)
+	{
+		float32 invScale = m_quantizationScale[i] > 0.0f ? 1.0f / m_quantizationScale[i] : 0.0f;
+		aabb.m_lower[i] = m_quantizedAABB.m_lower[i] + float32(node->lower[i]) * invScale;
+		aabb.m_upper[i] = m_quantizedAABB.m_lower[i] + float32(node->upper[i]) * invScale;
+	}
+	return aabb;
 }
 
 inline u32 b3StaticTree::GetUserData(u32 proxyId) const
 {
-	B3_ASSERT(proxyId < m_nodeCount);
-	B3_ASSERT(m_nodes[proxyId].IsLeaf());
-	return m_nodes[proxyId].index;
+	B3_ASSERT(proxyId < m_proxyCount);
+	return m_proxies[proxyId];
+}
+
+inline float64 b3StaticTree::GetBuildTime() const
+{
+	return m_buildTime;
 }
 
 template<class T>
@@ -105,21 +427,24 @@ inline void b3StaticTree::QueryAABB(T* callback, const b3AABB3& aabb) const
 		return;
 	}
 
-	u32 root = 0;
-
-	b3Stack<u32, 256> stack;
-	stack.Push(root);
+	if (m_wideNodes)
+	{
+		QueryAABBWide(callback, aabb);
+		return;
+	}
 
-	while (stack.IsEmpty() == false) 
+	if (m_quantizedNodes)
 	{
-		u32 nodeIndex = stack.Top();
+		QueryAABBQuantized(callback, aabb);
+		return;
+	}
 
-		if (nodeIndex == B3_NULL_NODE_S)
-		{
-			continue;
-		}
+	b3TreeStack<u32, 2> stack;
+	stack.Push(0);
 
-		stack.Pop();
+	while (stack.IsEmpty() == false) 
+	{
+		u32 nodeIndex = stack.Pop();
 
 		const b3Node* node = m_nodes + nodeIndex;
 
@@ -127,9 +452,12 @@ inline void b3StaticTree::QueryAABB(T* callback, const b3AABB3& aabb) const
 		{
 			if (node->IsLeaf() == true) 
 			{
-				if (callback->Report(nodeIndex) == false) 
+				for (u32 i = 0; i < node->count; ++i)
 				{
-					return;
+					if (callback->Report(node->index + i) == false) 
+					{
+						return;
+					}
 				}
 			}
 			else 
@@ -141,6 +469,29 @@ inline void b3StaticTree::QueryAABB(T* callback, const b3AABB3& aabb) const
 	}
 }
 
+template<class T>
+inline bool b3StaticTree::ReportRayCast(T* callback, const b3RayCastInput& input, u32 index, u32 count, float32& maxFraction) const
+{
+	b3RayCastInput subInput;
+	subInput.p1 = input.p1;
+	subInput.p2 = input.p2;
+
+	for (u32 i = 0; i < count; ++i)
+	{
+		subInput.maxFraction = maxFraction;
+
+		float32 newFraction = callback->Report(subInput, index + i);
+
+		if (b3ClipRayCast(maxFraction, newFraction) == false)
+		{
+			// The client has stopped the query.
+			return false;
+		}
+	}
+
+	return true;
+}
+
 template<class T>
 inline void b3StaticTree::RayCast(T* callback, const b3RayCastInput& input) const 
 {
@@ -149,6 +500,18 @@ inline void b3StaticTree::RayCast(T* callback, const b3RayCastInput& input) cons
 		return;
 	}
 
+	if (m_wideNodes)
+	{
+		RayCastWide(callback, input);
+		return;
+	}
+
+	if (m_quantizedNodes)
+	{
+		RayCastQuantized(callback, input);
+		return;
+	}
+
 	b3Vec3 p1 = input.p1;
 	b3Vec3 p2 = input.p2;
 	b3Vec3 d = p2 - p1;
@@ -157,46 +520,406 @@ inline void b3StaticTree::RayCast(T* callback, const b3RayCastInput& input) cons
 	// Ensure non-degenerate segment.
 	B3_ASSERT(b3Dot(d, d) > B3_EPSILON * B3_EPSILON);
 
-	u32 root = 0;
+	b3RayCastStack stack;
 
-	b3Stack<u32, 256> stack;
-	stack.Push(root);
+	float32 rootFraction = 0.0f;
+	if (m_nodes[0].aabb.TestRay(p1, p2, maxFraction, rootFraction) == true)
+	{
+		b3PushRayCastNode(stack, 0, rootFraction);
+	}
 
+	// Visit the nodes from front to back.
 	while (stack.IsEmpty() == false) 
 	{
-		u32 nodeIndex = stack.Top();	
-		stack.Pop();
+		b3RayCastNode rayNode = stack.Pop();
 
-		if (nodeIndex == B3_NULL_NODE_S)
+		if (rayNode.fraction > maxFraction)
 		{
+			// The ray was clipped before this node.
 			continue;
 		}
 
-		const b3Node* node = m_nodes + nodeIndex;
+		const b3Node* node = m_nodes + rayNode.node;
 
-		float32 minFraction = 0.0f;
-		if (node->aabb.TestRay(p1, p2, maxFraction, minFraction) == true) 
+		if (node->IsLeaf() == true) 
 		{
-			if (node->IsLeaf() == true) 
+			if (ReportRayCast(callback, input, node->index, node->count, maxFraction) == false)
 			{
-				b3RayCastInput subInput;
-				subInput.p1 = input.p1;
-				subInput.p2 = input.p2;
-				subInput.maxFraction = maxFraction;
+				return;
+			}
+		}
+		else 
+		{
+			float32 fraction1 = 0.0f, fraction2 = 0.0f;
+			bool hit1 = m_nodes[node->child1].aabb.TestRay(p1, p2, maxFraction, fraction1);
+			bool hit2 = m_nodes[node->child2].aabb.TestRay(p1, p2, maxFraction, fraction2);
 
-				float32 newFraction = callback->Report(subInput, nodeIndex);
+			b3PushRayCastChildren(stack, node->child1, hit1, fraction1, node->child2, hit2, fraction2);
+		}
+	}
+}
 
-				if (newFraction == 0.0f) 
+template<class T>
+inline void b3StaticTree::ReportRayPacket(T* callback, b3RayPacket* packet, u32 mask, u32 index, u32 count) const
+{
+	for (u32 i = 0; i < 4; ++i)
+	{
+		if ((mask & (1 << i)) == 0)
+		{
+			continue;
+		}
+
+		for (u32 j = 0; j < count; ++j)
+		{
+			if ((packet->activeMask & (1 << i)) == 0)
+			{
+				// The client has stopped the ray.
+				break;
+			}
+
+			float32 newFraction = callback->Report(packet->GetInput(i), index + j, i);
+			packet->Clip(i, newFraction);
+		}
+	}
+}
+
+template<class T>
+inline void b3StaticTree::RayCastPacket(T* callback, b3RayPacket* packet) const
+{
+	if (m_nodeCount == 0)
+	{
+		return;
+	}
+
+	b3TreeStack<u32, 2> stack;
+	stack.Push(0);
+
+	while (stack.IsEmpty() == false && packet->activeMask != 0)
+	{
+		u32 nodeIndex = stack.Pop();
+
+		if (m_quantizedNodes)
+		{
+			const b3QuantizedNode* node = m_quantizedNodes + nodeIndex;
+
+			u32 mask = packet->TestAABB(GetQuantizedAABB(node));
+			if (mask == 0)
+			{
+				continue;
+			}
+
+			if (node->IsLeaf())
+			{
+				ReportRayPacket(callback, packet, mask, node->GetIndex(), node->GetCount());
+				continue;
+			}
+
+			u32 child1 = nodeIndex + 1;
+			u32 child2 = node->data;
+
+			// Visit the nearest child first.
+			if (packet->IsNearFirst(GetQuantizedAABB(m_quantizedNodes + child1), GetQuantizedAABB(m_quantizedNodes + child2)))
+			{
+				stack.Push(child2);
+				stack.Push(child1);
+			}
+			else
+			{
+				stack.Push(child1);
+				stack.Push(child2);
+			}
+		}
+		else
+		{
+			const b3Node* node = m_nodes + nodeIndex;
+
+			u32 mask = packet->TestAABB(node->aabb);
+			if (mask == 0)
+			{
+				continue;
+			}
+
+			if (node->IsLeaf())
+			{
+				ReportRayPacket(callback, packet, mask, node->index, node->count);
+				continue;
+			}
+
+			// Visit the nearest child first.
+			if (packet->IsNearFirst(m_nodes[node->child1].aabb, m_nodes[node->child2].aabb))
+			{
+				stack.Push(node->child2);
+				stack.Push(node->child1);
+			}
+			else
+			{
+				stack.Push(node->child1);
+				stack.Push(node->child2);
+			}
+		}
+	}
+}
+
+template<class T>
+inline void b3StaticTree::QueryAABBQuantized(T* callback, const b3AABB3& aabb) const
+{
+	// The clamped AABB would overlap the boundary nodes.
+	if (b3TestOverlap(m_quantizedAABB, aabb) == false)
+	{
+		return;
+	}
+
+	u16 lower[3], upper[3];
+	QuantizeLower(lower, aabb.m_lower);
+	QuantizeUpper(upper, aabb.m_upper);
+
+	b3TreeStack<u32, 2> stack;
+	stack.Push(0);
+
+	while (stack.IsEmpty() == false)
+	{
+		u32 nodeIndex = stack.Pop();
+
+		const b3QuantizedNode* node = m_quantizedNodes + nodeIndex;
+
+		if (node->lower[0] > upper[0] || lower[0] > node->upper[0] ||
+			node->lower[1] > upper[1] || lower[1] > node->upper[1] ||
+			node->lower[2] > upper[2] || lower[2] > node->upper[2])
+		{
+			continue;
+		}
+
+		if (node->IsLeaf())
+		{
+			u32 index = node->GetIndex();
+			u32 count = node->GetCount();
+			for (u32 i = 0; i < count; ++i)
+			{
+				if (callback->Report(index + i) == false)
 				{
-					// The client has stopped the query.
 					return;
 				}
 			}
-			else 
+		}
+		else
+		{
+			stack.Push(nodeIndex + 1);
+			stack.Push(node->data);
+		}
+	}
+}
+
+template<class T>
+inline void b3StaticTree::RayCastQuantized(T* callback, const b3RayCastInput& input) const
+{
+	b3Vec3 p1 = input.p1;
+	b3Vec3 p2 = input.p2;
+	b3Vec3 d = p2 - p1;
+	float32 maxFraction = input.maxFraction;
+
+	// Ensure non-degenerate segment.
+	B3_ASSERT(b3Dot(d, d) > B3_EPSILON * B3_EPSILON);
+
+	b3RayCastStack stack;
+
+	float32 rootFraction = 0.0f;
+	if (GetQuantizedAABB(m_quantizedNodes).TestRay(p1, p2, maxFraction, rootFraction) == true)
+	{
+		b3PushRayCastNode(stack, 0, rootFraction);
+	}
+
+	// Visit the nodes from front to back.
+	while (stack.IsEmpty() == false)
+	{
+		b3RayCastNode rayNode = stack.Pop();
+
+		if (rayNode.fraction > maxFraction)
+		{
+			// The ray was clipped before this node.
+			continue;
+		}
+
+		const b3QuantizedNode* node = m_quantizedNodes + rayNode.node;
+
+		if (node->IsLeaf())
+		{
+			if (ReportRayCast(callback, input, node->GetIndex(), node->GetCount(), maxFraction) == false)
 			{
-				stack.Push(node->child1);
-				stack.Push(node->child2);
+				return;
+			}
+		}
+		else
+		{
+			u32 child1 = rayNode.node + 1;
+			u32 child2 = node->data;
+
+			float32 fraction1 = 0.0f, fraction2 = 0.0f;
+			bool hit1 = GetQuantizedAABB(m_quantizedNodes + child1).TestRay(p1, p2, maxFraction, fraction1);
+			bool hit2 = GetQuantizedAABB(m_quantizedNodes + child2).TestRay(p1, p2, maxFraction, fraction2);
+
+			b3PushRayCastChildren(stack, child1, hit1, fraction1, child2, hit2, fraction2);
+		}
+	}
+}
+
+template<class T>
+inline void b3StaticTree::QueryAABBWide(T* callback, const b3AABB3& aabb) const
+{
+	b3Float4 lowerX = b3Splat4(aabb.m_lower.x);
+	b3Float4 lowerY = b3Splat4(aabb.m_lower.y);
+	b3Float4 lowerZ = b3Splat4(aabb.m_lower.z);
+	b3Float4 upperX = b3Splat4(aabb.m_upper.x);
+	b3Float4 upperY = b3Splat4(aabb.m_upper.y);
+	b3Float4 upperZ = b3Splat4(aabb.m_upper.z);
+
+	b3TreeStack<u32, 4> stack;
+	stack.Push(0);
+
+	while (stack.IsEmpty() == false)
+	{
+		u32 nodeIndex = stack.Pop();
+
+		const b3WideNode* node = m_wideNodes + nodeIndex;
+
+		// Test the four child AABBs against the AABB.
+		b3Float4 overlapX = b3And4(b3CmpLE4(b3Load4(node->lowerX), upperX), b3CmpLE4(lowerX, b3Load4(node->upperX)));
+		b3Float4 overlapY = b3And4(b3CmpLE4(b3Load4(node->lowerY), upperY), b3CmpLE4(lowerY, b3Load4(node->upperY)));
+		b3Float4 overlapZ = b3And4(b3CmpLE4(b3Load4(node->lowerZ), upperZ), b3CmpLE4(lowerZ, b3Load4(node->upperZ)));
+		
+		u32 mask = b3MoveMask4(b3And4(b3And4(overlapX, overlapY), overlapZ));
+
+		for (u32 i = 0; i < 4; ++i)
+		{
+			u32 child = node->children[i];
+			if (child == B3_NULL_NODE_S)
+			{
+				break;
+			}
+
+			if ((mask & (1 << i)) == 0)
+			{
+				continue;
+			}
+
+			if (child & B3_WIDE_LEAF_BIT)
+			{
+				const b3Node* leaf = m_nodes + (child & ~B3_WIDE_LEAF_BIT);
+				for (u32 j = 0; j < leaf->count; ++j)
+				{
+					if (callback->Report(leaf->index + j) == false)
+					{
+						return;
+					}
+				}
+			}
+			else
+			{
+				stack.Push(child);
+			}
+		}
+	}
+}
+
+template<class T>
+inline void b3StaticTree::RayCastWide(T* callback, const b3RayCastInput& input) const
+{
+	b3Vec3 p1 = input.p1;
+	b3Vec3 p2 = input.p2;
+	b3Vec3 d = p2 - p1;
+	float32 maxFraction = input.maxFraction;
+
+	// Ensure non-degenerate segment.
+	B3_ASSERT(b3Dot(d, d) > B3_EPSILON * B3_EPSILON);
+
+	// A large inverse makes the slabs parallel to the segment either 
+	// contain the whole segment or none of it.
+	b3Float4 p1X = b3Splat4(p1.x);
+	b3Float4 p1Y = b3Splat4(p1.y);
+	b3Float4 p1Z = b3Splat4(p1.z);
+	b3Float4 invDX = b3Splat4(d.x != 0.0f ? 1.0f / d.x : B3_MAX_FLOAT);
+	b3Float4 invDY = b3Splat4(d.y != 0.0f ? 1.0f / d.y : B3_MAX_FLOAT);
+	b3Float4 invDZ = b3Splat4(d.z != 0.0f ? 1.0f / d.z : B3_MAX_FLOAT);
+	b3Float4 zero = b3Splat4(0.0f);
+
+	// The stack stores wide nodes and binary leaves with B3_WIDE_LEAF_BIT set.
+	b3TreeStack<b3RayCastNode, 4> stack;
+
+	b3RayCastNode root;
+	root.node = 0;
+	root.fraction = 0.0f;
+	stack.Push(root);
+
+	// Visit the nodes from front to back.
+	while (stack.IsEmpty() == false)
+	{
+		b3RayCastNode rayNode = stack.Pop();
+
+		if (rayNode.fraction > maxFraction)
+		{
+			// The ray was clipped before this node.
+			continue;
+		}
+
+		if (rayNode.node & B3_WIDE_LEAF_BIT)
+		{
+			const b3Node* leaf = m_nodes + (rayNode.node & ~B3_WIDE_LEAF_BIT);
+			if (ReportRayCast(callback, input, leaf->index, leaf->count, maxFraction) == false)
+			{
+				return;
 			}
+			continue;
+		}
+
+		const b3WideNode* node = m_wideNodes + rayNode.node;
+
+		// Clip the segment against the slabs of the four child AABBs.
+		b3Float4 tx1 = (b3Load4(node->lowerX) - p1X) * invDX;
+		b3Float4 tx2 = (b3Load4(node->upperX) - p1X) * invDX;
+		b3Float4 ty1 = (b3Load4(node->lowerY) - p1Y) * invDY;
+		b3Float4 ty2 = (b3Load4(node->upperY) - p1Y) * invDY;
+		b3Float4 tz1 = (b3Load4(node->lowerZ) - p1Z) * invDZ;
+		b3Float4 tz2 = (b3Load4(node->upperZ) - p1Z) * invDZ;
+
+		b3Float4 lower = b3Max4(b3Max4(b3Min4(tx1, tx2), b3Min4(ty1, ty2)), b3Max4(b3Min4(tz1, tz2), zero));
+		b3Float4 upper = b3Min4(b3Min4(b3Max4(tx1, tx2), b3Max4(ty1, ty2)), b3Min4(b3Max4(tz1, tz2), b3Splat4(maxFraction)));
+
+		u32 mask = b3MoveMask4(b3CmpLE4(lower, upper));
+		
+		// The entry fractions of the children.
+		const float32* fractions = (const float32*)&lower;
+
+		// Sort the children hit by the ray from the nearest to the farthest.
+		b3RayCastNode hits[4];
+		u32 hitCount = 0;
+		for (u32 i = 0; i < 4; ++i)
+		{
+			u32 child = node->children[i];
+			if (child == B3_NULL_NODE_S)
+			{
+				break;
+			}
+
+			if ((mask & (1 << i)) == 0)
+			{
+				continue;
+			}
+
+			u32 j = hitCount;
+			while (j > 0 && hits[j - 1].fraction > fractions[i])
+			{
+				hits[j] = hits[j - 1];
+				--j;
+			}
+
+			hits[j].node = child;
+			hits[j].fraction = fractions[i];
+			++hitCount;
+		}
+
+		// Push the farthest child first so the nearest one is visited first.
+		for (u32 i = hitCount; i > 0; --i)
+		{
+			stack.Push(hits[i - 1]);
 		}
 	}
 }
@@ -205,7 +928,16 @@ inline u32 b3StaticTree::GetSize() const
 {
 	u32 size = 0;
 	size += sizeof(b3StaticTree);
-	size += m_nodeCount * sizeof(b3Node);
+	if (m_quantizedNodes)
+	{
+		size += m_nodeCount * sizeof(b3QuantizedNode);
+	}
+	else
+	{
+		size += m_nodeCount * sizeof(b3Node);
+	}
+	size += m_proxyCount * sizeof(u32);
+	size += m_wideNodeCount * sizeof(b3WideNode);
 	return size;
 }
 
@@ -0,0 +1,207 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef B3_TREE_BINS_H
+#define B3_TREE_BINS_H
+
+#include <bounce/collision/trees/tree_traversal.h>
+#include <bounce/collision/shapes/aabb3.h>
+
+// The binned surface area heuristic (SAH) shared by the tree builders.
+// The AABBs are given by an accessor with a member function 
+// const b3AABB3& GetAABB(u32 id) const
+// so that each builder can keep its own AABB storage.
+
+// The number of bins used by the SAH builders.
+#define B3_TREE_BIN_COUNT 12
+
+struct b3TreeBin
+{
+	b3AABB3 aabb;
+	u32 count;
+};
+
+// A split plane between two bins along an axis.
+struct b3TreeSplit
+{
+	u32 axis;
+	
+	// The last bin on the left side of the split, 
+	// or B3_TREE_BIN_COUNT if no split was found.
+	u32 bin;
+	
+	// cost = count1 * area1 + count2 * area2
+	float32 cost;
+};
+
+// Get the bin of a centroid coordinate.
+inline u32 b3GetTreeBin(float32 c, float32 lower, float32 binScale)
+{
+	return b3Min(u32(binScale * (c - lower)), u32(B3_TREE_BIN_COUNT - 1));
+}
+
+// Compute the bounds of a set of AABBs and the bounds of their centroids.
+template<class T>
+inline void b3ComputeTreeBounds(b3AABB3& aabb, b3AABB3& centroidAABB, 
+	const T& aabbs, const u32* ids, u32 count)
+{
+	B3_ASSERT(count > 0);
+
+	aabb = aabbs.GetAABB(ids[0]);
+	centroidAABB.m_lower = centroidAABB.m_upper = aabb.Centroid();
+	for (u32 i = 1; i < count; ++i)
+	{
+		const b3AABB3& leafAABB = aabbs.GetAABB(ids[i]);
+		b3Vec3 c = leafAABB.Centroid();
+		aabb = b3Combine(aabb, leafAABB);
+		centroidAABB.m_lower = b3Min(centroidAABB.m_lower, c);
+		centroidAABB.m_upper = b3Max(centroidAABB.m_upper, c);
+	}
+}
+
+// Find the split that minimizes the surface area heuristic.
+// cost(split) = count1 * area1 + count2 * area2
+// The nodes deeper than half of the maximum height aren't binned, so they 
+// are split in the middle and the tree height stays bounded.
+template<class T>
+inline b3TreeSplit b3FindTreeSplit(const T& aabbs, const u32* ids, u32 count, 
+	const b3AABB3& centroidAABB, u32 depth)
+{
+	b3TreeSplit best;
+	best.axis = 0;
+	best.bin = B3_TREE_BIN_COUNT;
+	best.cost = B3_MAX_FLOAT;
+
+	u32 axisCount = depth < B3_MAX_TREE_HEIGHT / 2 ? 3 : 0;
+	for (u32 axis = 0; axis < axisCount; ++axis)
+	{
+		float32 lower = centroidAABB.m_lower[axis];
+		float32 extent = centroidAABB.m_upper[axis] - lower;
+		if (extent <= B3_EPSILON)
+		{
+			// All centroids are coincident along this axis.
+			continue;
+		}
+
+		float32 binScale = float32(B3_TREE_BIN_COUNT) / extent;
+
+		b3TreeBin bins[B3_TREE_BIN_COUNT];
+		for (u32 i = 0; i < B3_TREE_BIN_COUNT; ++i)
+		{
+			bins[i].count = 0;
+		}
+
+		for (u32 i = 0; i < count; ++i)
+		{
+			const b3AABB3& leafAABB = aabbs.GetAABB(ids[i]);
+			
+			b3TreeBin* bin = bins + b3GetTreeBin(leafAABB.Centroid()[axis], lower, binScale);
+			if (bin->count == 0)
+			{
+				bin->aabb = leafAABB;
+			}
+			else
+			{
+				bin->aabb = b3Combine(bin->aabb, leafAABB);
+			}
+			++bin->count;
+		}
+
+		// Sweep the bins from the right to accumulate the right side areas.
+		float32 rightAreas[B3_TREE_BIN_COUNT];
+		u32 rightCounts[B3_TREE_BIN_COUNT];
+
+		b3AABB3 rightAABB;
+		u32 rightCount = 0;
+		for (u32 i = B3_TREE_BIN_COUNT - 1; i > 0; --i)
+		{
+			if (bins[i].count > 0)
+			{
+				rightAABB = rightCount == 0 ? bins[i].aabb : b3Combine(rightAABB, bins[i].aabb);
+				rightCount += bins[i].count;
+			}
+
+			rightCounts[i] = rightCount;
+			rightAreas[i] = rightCount > 0 ? rightAABB.SurfaceArea() : 0.0f;
+		}
+
+		// Sweep the bins from the left and evaluate each split plane.
+		b3AABB3 leftAABB;
+		u32 leftCount = 0;
+		for (u32 i = 0; i < B3_TREE_BIN_COUNT - 1; ++i)
+		{
+			if (bins[i].count > 0)
+			{
+				leftAABB = leftCount == 0 ? bins[i].aabb : b3Combine(leftAABB, bins[i].aabb);
+				leftCount += bins[i].count;
+			}
+
+			if (leftCount == 0 || rightCounts[i + 1] == 0)
+			{
+				continue;
+			}
+
+			float32 cost = float32(leftCount) * leftAABB.SurfaceArea() + float32(rightCounts[i + 1]) * rightAreas[i + 1];
+			if (cost < best.cost)
+			{
+				best.cost = cost;
+				best.axis = axis;
+				best.bin = i;
+			}
+		}
+	}
+
+	return best;
+}
+
+// Partition a set of AABBs by a split and return the number of AABBs on the left side. 
+// The set is split at the median if the split leaves one side empty.
+template<class T>
+inline u32 b3PartitionTreeSplit(const T& aabbs, u32* ids, u32 count, 
+	const b3AABB3& centroidAABB, const b3TreeSplit& split)
+{
+	u32 middle = 0;
+	if (split.bin < B3_TREE_BIN_COUNT)
+	{
+		float32 lower = centroidAABB.m_lower[split.axis];
+		float32 extent = centroidAABB.m_upper[split.axis] - lower;
+		float32 binScale = float32(B3_TREE_BIN_COUNT) / extent;
+
+		for (u32 i = 0; i < count; ++i)
+		{
+			float32 c = aabbs.GetAABB(ids[i]).Centroid()[split.axis];
+			if (b3GetTreeBin(c, lower, binScale) <= split.bin)
+			{
+				b3Swap(ids[i], ids[middle]);
+				++middle;
+			}
+		}
+	}
+
+	// Ensure nonempty subsets.
+	if (middle == 0 || middle == count)
+	{
+		// Choose median.
+		middle = count / 2;
+	}
+
+	return middle;
+}
+
+#endif
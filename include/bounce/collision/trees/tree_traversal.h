@@ -0,0 +1,261 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B3_TREE_TRAVERSAL_H
+#define B3_TREE_TRAVERSAL_H
+
+#include <bounce/common/math/simd.h>
+#include <bounce/collision/collision.h>
+
+// The maximum height of a tree.
+// The tree builders split the nodes deeper than half of this height in the middle, 
+// so a tree never exceeds this height.
+#define B3_MAX_TREE_HEIGHT (64)
+
+// A fixed-capacity LIFO stack used to walk a tree without allocating memory.
+// A depth-first walk that pushes at most N children of a node keeps at most 
+// (N - 1) * height + 1 nodes in the stack, so the capacity is derived from 
+// the maximum tree height.
+// If a tree is deeper than that anyway the stack empties itself and ignores 
+// further pushes, so the walk stops early instead of writing past the stack.
+template <typename T, u32 N>
+class b3TreeStack
+{
+public:
+	b3TreeStack()
+	{
+		m_count = 0;
+		m_capacity = e_capacity;
+	}
+
+	void Push(const T& element)
+	{
+		B3_ASSERT(m_count < e_capacity);
+		if (m_count == m_capacity)
+		{
+			// Empty the stack and drop the remaining pushes.
+			m_count = 0;
+			m_capacity = 0;
+			return;
+		}
+		m_elements[m_count] = element;
+		++m_count;
+	}
+
+	T Pop()
+	{
+		B3_ASSERT(m_count > 0);
+		--m_count;
+		return m_elements[m_count];
+	}
+
+	bool IsEmpty() const
+	{
+		return m_count == 0;
+	}
+private:
+	enum
+	{
+		e_capacity = (N - 1) * B3_MAX_TREE_HEIGHT + 1
+	};
+
+	T m_elements[e_capacity];
+	u32 m_count;
+	u32 m_capacity;
+};
+
+// A node waiting to be visited by a ray cast.
+struct b3RayCastNode
+{
+	u32 node;
+
+	// The fraction where the ray enters the node AABB.
+	// The node is skipped if the ray was clipped before it.
+	float32 fraction;
+};
+
+// The stack used to walk a binary tree with a ray.
+typedef b3TreeStack<b3RayCastNode, 2> b3RayCastStack;
+
+// Push a node hit by a ray.
+inline void b3PushRayCastNode(b3RayCastStack& stack, u32 node, float32 fraction)
+{
+	b3RayCastNode rayNode;
+	rayNode.node = node;
+	rayNode.fraction = fraction;
+	stack.Push(rayNode);
+}
+
+// Push the children of a binary node that are hit by a ray.
+// The nearest child is pushed last so it is visited first. 
+inline void b3PushRayCastChildren(b3RayCastStack& stack, 
+	u32 child1, bool hit1, float32 fraction1, 
+	u32 child2, bool hit2, float32 fraction2)
+{
+	if (hit1 && hit2)
+	{
+		if (fraction1 <= fraction2)
+		{
+			b3PushRayCastNode(stack, child2, fraction2);
+			b3PushRayCastNode(stack, child1, fraction1);
+		}
+		else
+		{
+			b3PushRayCastNode(stack, child1, fraction1);
+			b3PushRayCastNode(stack, child2, fraction2);
+		}
+	}
+	else if (hit1)
+	{
+		b3PushRayCastNode(stack, child1, fraction1);
+	}
+	else if (hit2)
+	{
+		b3PushRayCastNode(stack, child2, fraction2);
+	}
+}
+
+// Clip a ray with the fraction returned by a client callback.
+// Return false if the client has stopped the ray cast.
+inline bool b3ClipRayCast(float32& maxFraction, float32 newFraction)
+{
+	if (newFraction == 0.0f)
+	{
+		return false;
+	}
+
+	if (newFraction > 0.0f && newFraction < maxFraction)
+	{
+		maxFraction = newFraction;
+	}
+
+	return true;
+}
+
+// Four rays walking a tree together.
+// The rays share the node visits, so the nodes are loaded once for 
+// the four rays. A ray is active while it isn't stopped by the client.
+struct b3RayPacket
+{
+	// Set up the packet from up to four rays. 
+	// The lanes without a ray are inactive.
+	void Set(const b3RayCastInput* rays, u32 count)
+	{
+		B3_ASSERT(count > 0 && count <= 4);
+
+		float32 p1x[4], p1y[4], p1z[4];
+		float32 invDx[4], invDy[4], invDz[4];
+		
+		activeMask = 0;
+		for (u32 i = 0; i < 4; ++i)
+		{
+			// Replicate the first ray in the unused lanes.
+			const b3RayCastInput& ray = i < count ? rays[i] : rays[0];
+
+			b3Vec3 d = ray.p2 - ray.p1;
+
+			// Ensure non-degenerate segment.
+			B3_ASSERT(b3Dot(d, d) > B3_EPSILON * B3_EPSILON);
+
+			inputs[i] = ray;
+			maxFractions[i] = ray.maxFraction;
+
+			p1x[i] = ray.p1.x;
+			p1y[i] = ray.p1.y;
+			p1z[i] = ray.p1.z;
+
+			// A large inverse makes the slabs parallel to the segment either 
+			// contain the whole segment or none of it.
+			invDx[i] = d.x != 0.0f ? 1.0f / d.x : B3_MAX_FLOAT;
+			invDy[i] = d.y != 0.0f ? 1.0f / d.y : B3_MAX_FLOAT;
+			invDz[i] = d.z != 0.0f ? 1.0f / d.z : B3_MAX_FLOAT;
+
+			if (i < count)
+			{
+				activeMask |= 1 << i;
+			}
+		}
+
+		p1X = b3Set4(p1x[0], p1x[1], p1x[2], p1x[3]);
+		p1Y = b3Set4(p1y[0], p1y[1], p1y[2], p1y[3]);
+		p1Z = b3Set4(p1z[0], p1z[1], p1z[2], p1z[3]);
+		invDX = b3Set4(invDx[0], invDx[1], invDx[2], invDx[3]);
+		invDY = b3Set4(invDy[0], invDy[1], invDy[2], invDy[3]);
+		invDZ = b3Set4(invDz[0], invDz[1], invDz[2], invDz[3]);
+		maxFractions4 = b3Set4(maxFractions[0], maxFractions[1], maxFractions[2], maxFractions[3]);
+		
+		direction = inputs[0].p2 - inputs[0].p1;
+	}
+
+	// Get the input of the ray in a given lane clipped to its current fraction.
+	b3RayCastInput GetInput(u32 lane) const
+	{
+		b3RayCastInput input = inputs[lane];
+		input.maxFraction = maxFractions[lane];
+		return input;
+	}
+
+	// Clip the ray in a given lane with the fraction returned by a client callback.
+	// The ray becomes inactive if the client has stopped it.
+	void Clip(u32 lane, float32 newFraction)
+	{
+		if (b3ClipRayCast(maxFractions[lane], newFraction) == false)
+		{
+			activeMask &= ~(1 << lane);
+			return;
+		}
+
+		maxFractions4 = b3Set4(maxFractions[0], maxFractions[1], maxFractions[2], maxFractions[3]);
+	}
+
+	// Test an AABB against the active rays. 
+	// Return a mask with bit i set if the ray in lane i hits the AABB.
+	u32 TestAABB(const b3AABB3& aabb) const
+	{
+		b3Float4 tx1 = (b3Splat4(aabb.m_lower.x) - p1X) * invDX;
+		b3Float4 tx2 = (b3Splat4(aabb.m_upper.x) - p1X) * invDX;
+		b3Float4 ty1 = (b3Splat4(aabb.m_lower.y) - p1Y) * invDY;
+		b3Float4 ty2 = (b3Splat4(aabb.m_upper.y) - p1Y) * invDY;
+		b3Float4 tz1 = (b3Splat4(aabb.m_lower.z) - p1Z) * invDZ;
+		b3Float4 tz2 = (b3Splat4(aabb.m_upper.z) - p1Z) * invDZ;
+
+		b3Float4 lower = b3Max4(b3Max4(b3Min4(tx1, tx2), b3Min4(ty1, ty2)), b3Max4(b3Min4(tz1, tz2), b3Splat4(0.0f)));
+		b3Float4 upper = b3Min4(b3Min4(b3Max4(tx1, tx2), b3Max4(ty1, ty2)), b3Min4(b3Max4(tz1, tz2), maxFractions4));
+
+		return b3MoveMask4(b3CmpLE4(lower, upper)) & activeMask;
+	}
+
+	// Return true if the first child of a node should be visited first.
+	// The packet rays are assumed to be coherent, so the children are ordered 
+	// along the direction of the first ray.
+	bool IsNearFirst(const b3AABB3& aabb1, const b3AABB3& aabb2) const
+	{
+		return b3Dot(aabb2.Centroid() - aabb1.Centroid(), direction) >= 0.0f;
+	}
+
+	b3RayCastInput inputs[4];
+	float32 maxFractions[4];
+	u32 activeMask;
+
+	b3Float4 p1X, p1Y, p1Z;
+	b3Float4 invDX, invDY, invDZ;
+	b3Float4 maxFractions4;
+	b3Vec3 direction;
+};
+
+#endif
@@ -0,0 +1,106 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B3_JOB_SYSTEM_H
+#define B3_JOB_SYSTEM_H
+
+#include <bounce/common/settings.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// A task processes the items in the range [begin, end) of a parallel loop.
+// The thread index is in the range [0, thread count) and no two tasks 
+// running at the same time share a thread index. 
+// It can be used to index per-thread scratch memory.
+typedef void (*b3TaskFunction)(void* context, u32 begin, u32 end, u32 threadIndex);
+
+// Implement this interface to run the parallel parts of Bounce 
+// on your own task scheduler.
+// The results computed by Bounce don't depend on how the loop is split 
+// into tasks or on the order the tasks are executed.
+class b3JobSystem
+{
+public:
+	virtual ~b3JobSystem() { }
+
+	// Get the number of threads that can run tasks at the same time, 
+	// including the calling thread.
+	virtual u32 GetThreadCount() const = 0;
+
+	// Split the range [0, count) into tasks of at least minRange items and 
+	// execute the tasks in parallel.
+	// This function must return only after all tasks have been executed.
+	virtual void ParallelFor(b3TaskFunction task, void* context, u32 count, u32 minRange) = 0;
+};
+
+// A job system that runs tasks on a fixed set of worker threads.
+// The thread calling ParallelFor also executes tasks.
+class b3ThreadPool : public b3JobSystem
+{
+public:
+	// Create a thread pool with a given number of threads, including the calling thread.
+	// If the given number is zero then the number of hardware threads is used.
+	b3ThreadPool(u32 threadCount);
+	~b3ThreadPool();
+
+	// Get the number of threads in this pool, including the calling thread.
+	u32 GetThreadCount() const;
+
+	// Execute a parallel loop on this pool.
+	// This function must not be called from inside a task.
+	void ParallelFor(b3TaskFunction task, void* context, u32 count, u32 minRange);
+private:
+	// The main function of a worker thread.
+	void Work(u32 threadIndex);
+
+	// Execute the tasks of the current loop until there are no tasks left.
+	void RunTasks(u32 threadIndex);
+
+	std::thread* m_workers;
+	u32 m_threadCount;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wakeCondition;
+	std::condition_variable m_doneCondition;
+	
+	// Incremented for every loop.
+	u32 m_generation;
+	
+	// Number of workers executing tasks of the current loop.
+	u32 m_busyCount;
+	
+	bool m_quit;
+
+	// The current loop.
+	b3TaskFunction m_task;
+	void* m_context;
+	u32 m_count;
+	u32 m_rangeSize;
+	u32 m_rangeCount;
+	std::atomic<u32> m_nextRange;
+	std::atomic<u32> m_doneRangeCount;
+};
+
+inline u32 b3ThreadPool::GetThreadCount() const
+{
+	return m_threadCount;
+}
+
+#endif
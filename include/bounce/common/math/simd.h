@@ -0,0 +1,285 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B3_SIMD_H
+#define B3_SIMD_H
+
+#include <bounce/common/math/math.h>
+
+// Define B3_NO_SIMD to disable the SSE code paths.
+#if !defined(B3_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define B3_SIMD_SSE
+#include <emmintrin.h>
+#endif
+
+// Four floats processed at once. 
+// Comparisons return a mask with all bits of a lane set if the comparison holds for the lane.
+// This maps to a SSE register if available.
+struct b3Float4
+{
+#ifdef B3_SIMD_SSE
+	__m128 v;
+#else
+	float32 v[4];
+#endif
+};
+
+// Load four floats from a 16-byte aligned address.
+inline b3Float4 b3Load4(const float32* p)
+{
+	b3Float4 r;
+#ifdef B3_SIMD_SSE
+	r.v = _mm_load_ps(p);
+#else
+	for (u32 i = 0; i < 4; ++i)
+	{
+		r.v[i] = p[i];
+	}
+#endif
+	return r;
+}
+
+// Store four floats to a 16-byte aligned address.
+inline void b3Store4(float32* p, const b3Float4& a)
+{
+#ifdef B3_SIMD_SSE
+	_mm_store_ps(p, a.v);
+#else
+	for (u32 i = 0; i < 4; ++i)
+	{
+		p[i] = a.v[i];
+	}
+#endif
+}
+
+// Set the four lanes to the same value.
+inline b3Float4 b3Splat4(float32 s)
+{
+	b3Float4 r;
+#ifdef B3_SIMD_SSE
+	r.v = _mm_set1_ps(s);
+#else
+	for (u32 i = 0; i < 4; ++i)
+	{
+		r.v[i] = s;
+	}
+#endif
+	return r;
+}
+
+// Set the four lanes.
+inline b3Float4 b3Set4(float32 x, float32 y, float32 z, float32 w)
+{
+	b3Float4 r;
+#ifdef B3_SIMD_SSE
+	r.v = _mm_setr_ps(x, y, z, w);
+#else
+	r.v[0] = x;
+	r.v[1] = y;
+	r.v[2] = z;
+	r.v[3] = w;
+#endif
+	return r;
+}
+
+// Get a lane. 
+// This goes through memory, so keep it out of the inner loops.
+inline float32 b3GetLane(const b3Float4& a, u32 lane)
+{
+	B3_ASSERT(lane < 4);
+	return ((const float32*)&a)[lane];
+}
+
+// Set a lane. 
+// This goes through memory, so keep it out of the inner loops.
+inline void b3SetLane(b3Float4& a, u32 lane, float32 s)
+{
+	B3_ASSERT(lane < 4);
+	((float32*)&a)[lane] = s;
+}
+
+inline b3Float4 operator+(const b3Float4& a, const b3Float4& b)
+{
+	b3Float4 r;
+#ifdef B3_SIMD_SSE
+	r.v = _mm_add_ps(a.v, b.v);
+#else
+	for (u32 i = 0; i < 4; ++i)
+	{
+		r.v[i] = a.v[i] + b.v[i];
+	}
+#endif
+	return r;
+}
+
+inline b3Float4 operator-(const b3Float4& a, const b3Float4& b)
+{
+	b3Float4 r;
+#ifdef B3_SIMD_SSE
+	r.v = _mm_sub_ps(a.v, b.v);
+#else
+	for (u32 i = 0; i < 4; ++i)
+	{
+		r.v[i] = a.v[i] - b.v[i];
+	}
+#endif
+	return r;
+}
+
+inline b3Float4 operator*(const b3Float4& a, const b3Float4& b)
+{
+	b3Float4 r;
+#ifdef B3_SIMD_SSE
+	r.v = _mm_mul_ps(a.v, b.v);
+#else
+	for (u32 i = 0; i < 4; ++i)
+	{
+		r.v[i] = a.v[i] * b.v[i];
+	}
+#endif
+	return r;
+}
+
+inline b3Float4 operator/(const b3Float4& a, const b3Float4& b)
+{
+	b3Float4 r;
+#ifdef B3_SIMD_SSE
+	r.v = _mm_div_ps(a.v, b.v);
+#else
+	for (u32 i = 0; i < 4; ++i)
+	{
+		r.v[i] = a.v[i] / b.v[i];
+	}
+#endif
+	return r;
+}
+
+// Lane-wise square root.
+inline b3Float4 b3Sqrt4(const b3Float4& a)
+{
+	b3Float4 r;
+#ifdef B3_SIMD_SSE
+	r.v = _mm_sqrt_ps(a.v);
+#else
+	for (u32 i = 0; i < 4; ++i)
+	{
+		r.v[i] = b3Sqrt(a.v[i]);
+	}
+#endif
+	return r;
+}
+
+// Lane-wise minimum.
+inline b3Float4 b3Min4(const b3Float4& a, const b3Float4& b)
+{
+	b3Float4 r;
+#ifdef B3_SIMD_SSE
+	r.v = _mm_min_ps(a.v, b.v);
+#else
+	for (u32 i = 0; i < 4; ++i)
+	{
+		r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+	}
+#endif
+	return r;
+}
+
+// Lane-wise maximum.
+inline b3Float4 b3Max4(const b3Float4& a, const b3Float4& b)
+{
+	b3Float4 r;
+#ifdef B3_SIMD_SSE
+	r.v = _mm_max_ps(a.v, b.v);
+#else
+	for (u32 i = 0; i < 4; ++i)
+	{
+		r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+	}
+#endif
+	return r;
+}
+
+#ifndef B3_SIMD_SSE
+
+// Convert a boolean to a lane mask.
+inline float32 b3LaneMask(bool flag)
+{
+	u32 bits = flag ? 0xFFFFFFFF : 0;
+	float32 mask;
+	memcpy(&mask, &bits, sizeof(float32));
+	return mask;
+}
+
+// Get the bits of a lane.
+inline u32 b3LaneBits(float32 lane)
+{
+	u32 bits;
+	memcpy(&bits, &lane, sizeof(float32));
+	return bits;
+}
+
+#endif
+
+// Lane-wise a <= b.
+inline b3Float4 b3CmpLE4(const b3Float4& a, const b3Float4& b)
+{
+	b3Float4 r;
+#ifdef B3_SIMD_SSE
+	r.v = _mm_cmple_ps(a.v, b.v);
+#else
+	for (u32 i = 0; i < 4; ++i)
+	{
+		r.v[i] = b3LaneMask(a.v[i] <= b.v[i]);
+	}
+#endif
+	return r;
+}
+
+// Lane-wise logical and of two masks.
+inline b3Float4 b3And4(const b3Float4& a, const b3Float4& b)
+{
+	b3Float4 r;
+#ifdef B3_SIMD_SSE
+	r.v = _mm_and_ps(a.v, b.v);
+#else
+	for (u32 i = 0; i < 4; ++i) 
+	{
+		u32 bits = b3LaneBits(a.v[i]) & b3LaneBits(b.v[i]);
+		memcpy(r.v + i, &bits, sizeof(float32));
+	}
+#endif
+	return r;
+}
+
+// Get a 4-bit integer from the sign bits of a mask. 
+// Bit i is set if lane i is set.
+inline u32 b3MoveMask4(const b3Float4& a)
+{
+#ifdef B3_SIMD_SSE
+	return u32(_mm_movemask_ps(a.v));
+#else
+	u32 mask = 0;
+	for (u32 i = 0; i < 4; ++i)
+	{
+		mask |= (b3LaneBits(a.v[i]) >> 31) << i;
+	}
+	return mask;
+#endif
+}
+
+#endif
@@ -33,12 +33,18 @@ public :
 	~b3StackAllocator();
 
 	void* Allocate(u32 size);
+	
+	// Allocate a block whose address is a multiple of a given power of two alignment.
+	// The block is freed with Free like any other block.
+	void* AllocateAligned(u32 size, u32 alignment);
+	
 	void Free(void* p);
 private :
 	struct b3Block 
 	{
 		u32 size;
-		u8* data;
+		u8* memory; // the allocated memory
+		u8* data; // the returned address
 		bool parent;
 	};
 	
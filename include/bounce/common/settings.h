@@ -100,6 +100,17 @@ typedef float float32;
 // However values very close to 1 may lead to overshoot.
 #define B3_BAUMGARTE (0.1f)
 
+// The position correction factor used when solving time of impact 
+// constraints. This is larger than the discrete factor because the overlap 
+// at the time of impact is small.
+#define B3_TOI_BAUMGARTE (0.75f)
+
+// The maximum number of time of impact sub-steps per contact and step.
+#define B3_MAX_SUB_STEPS (8)
+
+// The maximum number of contacts in a time of impact island.
+#define B3_MAX_TOI_CONTACTS (32)
+
 // If the relative velocity of a contact point is below 
 // the threshold then restitution is not applied.
 #define B3_VELOCITY_THRESHOLD (1.0f)
@@ -133,12 +144,44 @@ typedef float float32;
 
 #define B3_PROFILE(name) b3ProfileScope B3_UNIQUE_NAME(scope)(name)
 
+// The size of a CPU cache line in bytes.
+#define B3_CACHE_LINE_SIZE (64)
+
 // You should implement this function to use your own memory allocator.
 void* b3Alloc(u32 size);
 
 // You must implement this function if you have implemented b3Alloc.
 void b3Free(void* block);
 
+// Allocate a block of memory whose address is a multiple of a given power of two alignment.
+// The block is allocated with b3Alloc and must be freed with b3FreeAligned.
+inline void* b3AllocAligned(u32 size, u32 alignment)
+{
+	B3_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+	
+	// Store the unaligned address right before the aligned block.
+	u8* block = (u8*)b3Alloc(size + alignment - 1 + sizeof(void*));
+	if (block == NULL)
+	{
+		return NULL;
+	}
+
+	size_t address = (size_t)(block + sizeof(void*));
+	u8* alignedBlock = (u8*)((address + alignment - 1) & ~(size_t)(alignment - 1));
+	((void**)alignedBlock)[-1] = block;
+	return alignedBlock;
+}
+
+// Free a block of memory allocated with b3AllocAligned.
+inline void b3FreeAligned(void* block)
+{
+	if (block == NULL)
+	{
+		return;
+	}
+	b3Free(((void**)block)[-1]);
+}
+
 // You should implement this function to visualize log messages coming 
 // from this software.
 void b3Log(const char* string, ...);
@@ -50,6 +50,8 @@ struct b3BodyDef
 	{
 		type = e_staticBody;
 		awake = true;
+		bullet = false;
+		speculative = false;
 		fixedRotationX = false;
 		fixedRotationY = false;
 		fixedRotationZ = false;
@@ -69,6 +71,14 @@ struct b3BodyDef
 	//
 	bool awake;
 	
+	// Is this a fast moving body that should not tunnel through other bodies? 
+	// Only dynamic bodies can be bullets.
+	bool bullet;
+
+	// Should the contacts of this body be created ahead of time so it doesn't 
+	// tunnel through other bodies? This is cheaper than a bullet.
+	bool speculative;
+
 	//
 	bool fixedRotationX;
 	
@@ -127,6 +137,12 @@ public:
 	// Therefore you can create shapes on the stack memory.
 	b3Shape* CreateShape(const b3ShapeDef& def);
 	
+	// Create a list of shapes for the body given a list of shape definitions.
+	// This is faster than calling CreateShape for each definition because the 
+	// broad-phase proxies are created in one pass and the mass is recomputed once.
+	// If the given shape array is not NULL then it receives the created shapes.
+	void CreateShapes(b3Shape** shapes, const b3ShapeDef* defs, u32 count);
+
 	// Destroy a given shape from the body.
 	void DestroyShape(b3Shape* shape);
 
@@ -262,6 +278,22 @@ public:
 	// Set the awake status of the body.
 	void SetAwake(bool flag);
 
+	// See if the body is treated as a bullet for continuous collision detection.
+	bool IsBullet() const;
+
+	// Set if the body should be treated as a bullet for continuous collision detection. 
+	// The contacts of a bullet are checked for time of impact after each step, 
+	// so it won't tunnel through other bodies. 
+	// This is more expensive, so only use it for fast moving bodies.
+	void SetBullet(bool flag);
+
+	// See if the contacts of the body are speculative.
+	bool IsSpeculative() const;
+
+	// Set if the contacts of the body should be speculative. 
+	// See b3World::SetSpeculativeContacts.
+	void SetSpeculative(bool flag);
+
 	// Get the user data associated with the body.
 	// The user data is usually a game entity.
 	void* GetUserData() const;
@@ -304,6 +336,8 @@ private:
 		e_fixedRotationX = 0x0004,
 		e_fixedRotationY = 0x0008,
 		e_fixedRotationZ = 0x0010,
+		e_bulletFlag = 0x0020,
+		e_speculativeFlag = 0x0040,
 	};
 
 	b3Body(const b3BodyDef& def, b3World* world);
@@ -321,6 +355,9 @@ private:
 	void SynchronizeTransform();
 	void SynchronizeShapes();
 
+	// Move the body to a given time of its sweep in the current step.
+	void Advance(float32 t);
+
 	// Check if this body should collide with another.
 	bool ShouldCollide(const b3Body* other) const;
 
@@ -523,6 +560,40 @@ inline void b3Body::SetAwake(bool flag)
 	}
 }
 
+inline bool b3Body::IsBullet() const
+{
+	return (m_flags & e_bulletFlag) != 0;
+}
+
+inline void b3Body::SetBullet(bool flag)
+{
+	if (flag)
+	{
+		m_flags |= e_bulletFlag;
+	}
+	else
+	{
+		m_flags &= ~e_bulletFlag;
+	}
+}
+
+inline bool b3Body::IsSpeculative() const
+{
+	return (m_flags & e_speculativeFlag) != 0;
+}
+
+inline void b3Body::SetSpeculative(bool flag)
+{
+	if (flag)
+	{
+		m_flags |= e_speculativeFlag;
+	}
+	else
+	{
+		m_flags &= ~e_speculativeFlag;
+	}
+}
+
 inline float32 b3Body::GetLinearDamping() const
 {
 	return m_linearDamping;
@@ -54,6 +54,7 @@ public:
 	
 	b3BroadPhase m_broadPhase;	
 	b3List2<b3Contact> m_contactList;
+	b3PairHash m_contactHash;
 	b3List2<b3MeshContactLink> m_meshContactList;
 	b3ContactFilter* m_contactFilter;
 	b3ContactListener* m_contactListener;
@@ -60,40 +60,47 @@ bool b3TestOverlap(const b3Transform& xf1, u32 index1, const b3Shape* shape1,
 	b3ConvexCache* cache);
 
 // Compute a manifold for two generic shapes except when one of them is a mesh.
+// Points are created for features closer than the sum of the shape radii 
+// plus the given margin. Use a zero margin for ordinary contacts.
 void b3CollideShapeAndShape(b3Manifold& manifold, 
 	const b3Transform& xf1, const b3Shape* shape1,
 	const b3Transform& xf2, const b3Shape* shape2,
-	b3ConvexCache* cache);
+	b3ConvexCache* cache, float32 margin);
 
 // Compute a manifold for two spheres.
 void b3CollideSphereAndSphere(b3Manifold& manifold, 
 	const b3Transform& xf1, const b3SphereShape* shape1, 
-	const b3Transform& xf2, const b3SphereShape* shape2);
+	const b3Transform& xf2, const b3SphereShape* shape2,
+	float32 margin);
 
 // Compute a manifold for a sphere and a hull.
 void b3CollideSphereAndHull(b3Manifold& manifold, 
 	const b3Transform& xf1, const b3SphereShape* shape1, 
-	const b3Transform& xf2, const b3HullShape* shape2);
+	const b3Transform& xf2, const b3HullShape* shape2,
+	float32 margin);
 
 // Compute a manifold for a sphere and a capsule.
 void b3CollideSphereAndCapsule(b3Manifold& manifold, 
 	const b3Transform& xf1, const b3SphereShape* shape1, 
-	const b3Transform& xf2, const b3CapsuleShape* shape2);
+	const b3Transform& xf2, const b3CapsuleShape* shape2,
+	float32 margin);
 
 // Compute a manifold for two capsules.
 void b3CollideCapsuleAndCapsule(b3Manifold& manifold, 
 	const b3Transform& xf1, const b3CapsuleShape* shape1, 
-	const b3Transform& xf2, const b3CapsuleShape* shape2);
+	const b3Transform& xf2, const b3CapsuleShape* shape2,
+	float32 margin);
 
 // Compute a manifold for a capsule and a hull.
 void b3CollideCapsuleAndHull(b3Manifold& manifold, 
 	const b3Transform& xf1, const b3CapsuleShape* shape1, 
-	const b3Transform& xf2, const b3HullShape* shape2);
+	const b3Transform& xf2, const b3HullShape* shape2,
+	float32 margin);
 
 // Compute a manifold for two hulls. 
 void b3CollideHullAndHull(b3Manifold& manifold, 
 	const b3Transform& xf1, const b3HullShape* shape1, 
 	const b3Transform& xf2, const b3HullShape* shape2,
-	b3ConvexCache* cache);
+	b3ConvexCache* cache, float32 margin);
 
 #endif
\ No newline at end of file
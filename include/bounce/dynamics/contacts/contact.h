@@ -23,6 +23,7 @@
 #include <bounce/common/template/list.h>
 #include <bounce/common/template/array.h>
 #include <bounce/dynamics/contacts/manifold.h>
+#include <bounce/collision/time_of_impact.h>
 
 class b3Shape;
 class b3Body;
@@ -53,10 +54,12 @@ struct b3OverlappingPair
 	b3ContactEdge edgeB;
 };
 
-// todo
+// A cached time of impact. 
+// This is valid while the contact has the TOI flag set.
 struct b3TOIEvent
 {
-	float32 t;
+	float32 t; // time of impact in [0, 1]
+	u32 count; // number of sub-steps this contact took part in the current step
 };
 
 enum b3ContactType
@@ -111,6 +114,12 @@ protected:
 	{
 		e_overlapFlag = 0x0001,
 		e_islandFlag = 0x0002,
+		e_toiFlag = 0x0004,
+		e_speculativeFlag = 0x0008,
+		// The time of impact solver ignores this contact for the rest of the step.
+		e_toiDisabledFlag = 0x0010,
+		// This contact has speculative points but the shapes are not overlapping yet.
+		e_speculativePointsFlag = 0x0020
 	};
 
 	b3Contact() { }
@@ -125,6 +134,14 @@ protected:
 	// Initialize contact constraits.
 	virtual void Collide() = 0;
 
+	// Compute the distance ahead of the shapes at which contact points 
+	// are created. This is zero unless the contact is speculative.
+	float32 ComputeSpeculativeMargin() const;
+
+	// Compute the time of impact between the shapes in this contact 
+	// using the body sweeps.
+	virtual b3TOIOutput ComputeTOI() const = 0;
+
 	b3ContactType m_type;
 	u32 m_flags;
 	b3OverlappingPair m_pair;
@@ -137,7 +154,11 @@ protected:
 
 	// Time of impact event from continuous collision
 	// to continuous physics.
-	//b3TOIEvent m_toi;
+	b3TOIEvent m_toi;
+
+	// The indices of the bodies on the island solving this contact.
+	u32 m_islandIndexA;
+	u32 m_islandIndexB;
 
 	// Links to the world contact list.
 	b3Contact* m_prev;
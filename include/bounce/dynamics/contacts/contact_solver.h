@@ -26,8 +26,11 @@
 
 class b3StackAllocator;
 class b3Contact;
+struct b3SolverBody;
 struct b3Position;
 struct b3Velocity;
+struct b3Displacement;
+struct b3ContactVelocityBatch;
 
 struct b3PositionConstraintPoint
 {
@@ -67,6 +70,9 @@ struct b3VelocityConstraintPoint
 	float32 normalMass;
 	float32 normalImpulse;
 	float32 velocityBias;
+	float32 restitutionBias;
+	float32 separation;
+	float32 normalVelocity;
 };
 
 struct b3VelocityConstraintManifold
@@ -110,18 +116,22 @@ struct b3ContactVelocityConstraint
 	b3Mat33 invIB;
 	float32 friction;
 	float32 restitution;
+	bool speculative;
 	b3VelocityConstraintManifold* manifolds;
 	u32 manifoldCount;
 };
 
 struct b3ContactSolverDef 
 {
+	b3SolverBody* bodies;
 	b3Position* positions;
 	b3Velocity* velocities;
 	b3Contact** contacts;
 	u32 count;
 	b3StackAllocator* allocator;
 	float32 dt;
+	bool warmStart;
+	bool wide; // solve the velocity constraints in batches of four
 };
 
 class b3ContactSolver 
@@ -131,20 +141,75 @@ public:
 	~b3ContactSolver();
 
 	void InitializeConstraints();
+	void InitializeVelocityConstraints();
 	void WarmStart();
 	
 	void SolveVelocityConstraints();
 	void StoreImpulses();
 
+	// Scale the accumulated impulses. 
+	// The sub-stepping solver stores impulses per sub-step.
+	void ScaleImpulses(float32 scale);
+
+	// Compute the velocity biases of a sub-step. 
+	// The separations are updated with the displacements of the bodies since the 
+	// constraints were initialized, reusing the initial contact anchors. 
+	// If useBias is false then overlaps aren't pushed apart, so the 
+	// constraints are only relaxed.
+	void ComputeSubStepBiases(const b3Displacement* displacements, bool useBias);
+
+	// Apply the restitution of the speculative points that touch during a step of a given length.
+	// A speculative point only lets the shapes close their gap, so the velocity 
+	// solver can't bounce them. This is called after the positions are integrated 
+	// so the shapes touch before they bounce.
+	void ApplySpeculativeRestitution(float32 dt);
+
 	bool SolvePositionConstraints();
+
+	// Solve the contacts in the range [begin, end) using the scalar solver.
+	// The contacts of a range can be solved in parallel with 
+	// other ranges that don't share a body with them.
+	void SolveVelocityConstraints(u32 begin, u32 end);
+	bool SolvePositionConstraints(u32 begin, u32 end);
+	
+	// Solve the position constraints moving only the bodies 
+	// of the time of impact contact.
+	bool SolveTOIPositionConstraints(u32 toiIndexA, u32 toiIndexB);
 protected:
+	// Group the velocity constraint manifolds into batches of up to four 
+	// manifolds that don't share a body and copy them in SoA layout.
+	void InitializeBatches();
+	
+	// Solve the velocity constraints four manifolds at a time.
+	void SolveVelocityBatches();
+	
+	// Copy the accumulated impulses from the batches back to the velocity constraints.
+	void StoreBatchImpulses();
+
+	b3SolverBody* m_bodies;
 	b3Position* m_positions;
 	b3Velocity* m_velocities;
 	b3Contact** m_contacts;
 	b3ContactPositionConstraint* m_positionConstraints;
 	b3ContactVelocityConstraint* m_velocityConstraints;
 	u32 m_count;
+	
+	// The manifolds and points of all constraints are stored 
+	// contiguously in constraint order.
+	b3PositionConstraintManifold* m_positionManifolds;
+	b3VelocityConstraintManifold* m_velocityManifolds;
+	u32 m_manifoldCount;
+	b3PositionConstraintPoint* m_positionPoints;
+	b3VelocityConstraintPoint* m_velocityPoints;
+	u32 m_pointCount;
+	
+	// The batches of the wide solver and the batch of each manifold.
+	b3ContactVelocityBatch* m_batches;
+	u32 m_batchCount;
+	u32* m_manifoldBatches;
 	float32 m_dt, m_invDt;
+	bool m_warmStart;
+	bool m_wide;
 	b3StackAllocator* m_allocator;
 };
 
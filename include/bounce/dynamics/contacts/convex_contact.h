@@ -35,6 +35,8 @@ private:
 	bool TestOverlap();
 
 	void Collide();
+
+	b3TOIOutput ComputeTOI() const;
 	
 	b3Manifold m_stackManifold;
 	b3ConvexCache m_cache;
@@ -57,6 +57,8 @@ private:
 	bool TestOverlap();
 
 	void Collide();
+
+	b3TOIOutput ComputeTOI() const;
 	
 	void CollideSphere();
 
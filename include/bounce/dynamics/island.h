@@ -22,17 +22,30 @@
 #include <bounce/common/math/vec3.h>
 
 class b3StackAllocator;
+class b3JobSystem;
 class b3Contact;
 class b3Joint;
 class b3Body;
+class b3ContactSolver;
+class b3JointSolver;
 struct b3Velocity;
 struct b3Position;
+struct b3SolverBody;
+struct b3SolverMotion;
+struct b3Displacement;
 struct b3Profile;
 
 class b3Island 
 {
 public :
 	b3Island(b3StackAllocator* stack, u32 bodyCapacity, u32 contactCapacity, u32 jointCapacity);
+	
+	// Create an island over bodies and constraints that were already added to another island.
+	// The arrays aren't copied, so they must outlive this island.
+	// If a job system is given then the constraints are colored and each color is 
+	// solved in parallel. The contacts and joints are reordered by color.
+	b3Island(b3StackAllocator* stack, b3JobSystem* jobSystem, b3Body** bodies, u32 bodyCount, b3Contact** contacts, u32 contactCount, b3Joint** joints, u32 jointCount);
+	
 	~b3Island();
 
 	void Clear();
@@ -40,18 +53,71 @@ public :
 	void Add(b3Body* body);
 	void Add(b3Contact* contact);
 	void Add(b3Joint* joint);
+
+	// Store the island indices of the bodies on the constraints of this island.
+	// This must be called after all bodies were added because a static body 
+	// can be on many islands and only keeps its index in the last one.
+	void SetConstraintIndices();
 	
-	void Solve(const b3Vec3& gravity, float32 dt, u32 velocityIterations, u32 positionIterations, u32 flags);
+	// Solve the island. 
+	// If the sub-step count is greater than one then the step is divided into sub-steps, 
+	// each integrating the velocities, solving the velocity constraints and integrating 
+	// the positions. The contacts are computed once per step.
+	void Solve(const b3Vec3& gravity, float32 dt, u32 velocityIterations, u32 positionIterations, u32 subStepCount, u32 flags);
+
+	// Solve a time of impact sub-step. 
+	// Only the bodies of the time of impact contact are moved by the position correction.
+	void SolveTOI(float32 dt, u32 toiIndexA, u32 toiIndexB, u32 velocityIterations);
 private :
 	enum b3IslandFlags
 	{
 		e_warmStartBit = 0x0001,
-		e_sleepBit = 0x0002
+		e_sleepBit = 0x0002,
+		e_wideSolverBit = 0x0004
+	};
+
+	// The maximum number of colors. 
+	// The constraints that don't fit in a color are solved on a single thread 
+	// after the colors.
+	enum
+	{
+		e_maxColors = 24
 	};
 
 	friend class b3World;
 
+	// Copy the states and mass properties of the bodies to the solver arrays.
+	void CopyBodies();
+
+	// Integrate the forces into the velocities of the dynamic bodies.
+	void IntegrateVelocities(const b3Vec3& gravity, float32 h);
+	
+	// Integrate the velocities into the positions. 
+	// The motion is added to the displacements if they're given.
+	void IntegratePositions(float32 h, b3Displacement* displacements);
+
+	// Solve the velocity constraints and integrate the positions in sub-steps of length h.
+	void SolveSubSteps(b3ContactSolver* contactSolver, b3JointSolver* jointSolver, const b3Vec3& gravity, float32 h, u32 subStepCount, u32 velocityIterations, u32 flags);
+
+	// Count the constraints connected to a static body.
+	u32 CountStaticConstraints() const;
+
+	// Give each constraint connected to a static body its own copy of the static body state 
+	// after the body states, so that no two constraints write to the same state when 
+	// solved in parallel. The static bodies are not moved by the constraints.
+	void CopyStaticStates();
+
+	// Color the constraints so that no two constraints of the same color share a 
+	// non-static body, and sort the constraints by color.
+	void ColorConstraints();
+
+	// Solve a velocity or position iteration of the colored constraints.
+	void SolveColoredVelocities(b3ContactSolver* contactSolver, b3JointSolver* jointSolver);
+	bool SolveColoredPositions(b3ContactSolver* contactSolver, b3JointSolver* jointSolver);
+
 	b3StackAllocator* m_allocator;
+	b3JobSystem* m_jobSystem;
+	bool m_ownsArrays;
 	
 	b3Body** m_bodies;
 	u32 m_bodyCapacity;
@@ -67,6 +133,19 @@ private :
 	
 	b3Position* m_positions;
 	b3Velocity* m_velocities;
+	
+	// The body data used while solving, copied from the bodies once per step.
+	b3SolverBody* m_solverBodies;
+	b3SolverMotion* m_motions;
+	
+	// The number of static body copies stored after the body states.
+	u32 m_staticCount;
+
+	// The first contact and joint of each color. 
+	// The last color holds the constraints that didn't fit in the other colors.
+	u32 m_colorCount;
+	u32 m_contactColors[e_maxColors + 2];
+	u32 m_jointColors[e_maxColors + 2];
 };
 
 #endif
\ No newline at end of file
@@ -156,6 +156,10 @@ protected:
 	void* m_userData;
 	bool m_collideLinked;
 
+	// The indices of the bodies on the island solving this joint.
+	u32 m_islandIndexA;
+	u32 m_islandIndexB;
+
 	// Links to the world joint list.
 	b3Joint* m_prev;
 	b3Joint* m_next;
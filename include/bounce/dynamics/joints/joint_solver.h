@@ -37,6 +37,7 @@ struct b3JointSolverDef
 	float32 dt;
 	u32 count;
 	b3Joint** joints;
+	b3SolverBody* bodies;
 	b3Position* positions;
 	b3Velocity* velocities;
 };
@@ -50,6 +51,12 @@ public :
 	void WarmStart();
 	void SolveVelocityConstraints();	
 	bool SolvePositionConstraints();
+
+	// Solve the joints in the range [begin, end).
+	// The joints of a range can be solved in parallel with 
+	// other ranges that don't share a body with them.
+	void SolveVelocityConstraints(u32 begin, u32 end);
+	bool SolvePositionConstraints(u32 begin, u32 end);
 private :
 	b3SolverData m_solverData;
 	b3Joint** m_joints;
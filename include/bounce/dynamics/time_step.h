@@ -35,8 +35,26 @@ struct b3Velocity
 	b3Vec3 w;
 };
 
+// The mass properties of a body needed by the constraint solvers. 
+// These are copied once per step so that the solvers don't need to read the bodies.
+struct b3SolverBody
+{
+	float32 invMass;
+	b3Mat33 invI; // world inverse inertia
+	b3Vec3 localCenter;
+};
+
+// The motion of a body since the beginning of a step. 
+// This is used by the sub-stepping solver.
+struct b3Displacement
+{
+	b3Vec3 linear; // change of the center of mass
+	b3Vec3 angular; // accumulated rotation vector
+};
+
 struct b3SolverData
 {
+	b3SolverBody* bodies;
 	b3Position* positions;
 	b3Velocity* velocities;
 	float32 dt;
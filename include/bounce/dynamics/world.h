@@ -27,11 +27,14 @@
 #include <bounce/dynamics/contact_manager.h>
 
 struct b3BodyDef;
+struct b3Sphere;
+struct b3Capsule;
 class b3Body;
 class b3QueryListener;
 class b3RayCastListener;
 class b3ContactListener;
 class b3ContactFilter;
+class b3JobSystem;
 
 struct b3RayCastSingleOutput
 {
@@ -41,6 +44,14 @@ struct b3RayCastSingleOutput
 	float32 fraction; // time of intersection on segment
 };
 
+struct b3ShapeCastSingleOutput
+{
+	b3Shape* shape; // shape
+	b3Vec3 point; // contact point on surface
+	b3Vec3 normal; // surface normal at the contact point
+	float32 fraction; // time of impact on translation
+};
+
 // Use a physics world to create/destroy rigid bodies, execute ray cast and volume queries.
 class b3World
 {
@@ -61,7 +72,50 @@ public:
 
 	// Enable warm-starting for the constraint solvers. This improves stability significantly.
 	void SetWarmStart(bool flag);
+
+	// Enable speculative contacts for all bodies. 
+	// Contact points are created ahead of time for shapes that can touch during 
+	// the next step, and the solver only lets the shapes close the gap between them. 
+	// This prevents most tunneling at the cost of a few extra contact points. 
+	// It is cheaper than bullets but it may stop bodies slightly before they touch.
+	// The contacts begin only when the shapes touch and a bouncing body 
+	// bounces once it has closed the gap.
+	void SetSpeculativeContacts(bool flag);
+
+	// Enable the wide contact solver. 
+	// The contact velocity constraints are solved four at a time using SIMD. 
+	// The constraints are solved in a different order, so the results 
+	// differ slightly from the scalar solver. 
+	// This is disabled by default.
+	void SetWideContactSolver(bool flag);
+
+	// Set the number of sub-steps of each step. 
+	// The velocity constraints are solved and the positions are integrated once per sub-step 
+	// while the contacts are updated once per step. 
+	// Tall stacks and large mass ratios need far fewer velocity iterations per sub-step 
+	// than they'd need without sub-stepping. 
+	// The default is one, which disables sub-stepping.
+	void SetSubStepCount(u32 count);
 	
+	// Set the number of broad-phase proxies that are reinserted into the broad-phase 
+	// tree at the beginning of each step. 
+	// This keeps the tree optimized in the background without a single long stall. 
+	// Zero is set by default, which disables the incremental optimization.
+	void SetBroadPhaseOptimizeCount(u32 count);
+
+	// Rebuild the broad-phase tree from scratch. 
+	// Call this after creating a large number of shapes, e.g. after loading a level.
+	void RebuildBroadPhase();
+
+	// Set the job system used to run the parallel parts of a step. 
+	// The world doesn't own the job system. 
+	// The constraints of large islands are colored and solved one color at a time, 
+	// which changes their solving order when a job system with more than one thread is used. 
+	// Otherwise the results don't depend on whether a job system is used or not, 
+	// nor on the number of threads. 
+	// Set to NULL to run the step on the calling thread. This is the default.
+	void SetJobSystem(b3JobSystem* jobSystem);
+
 	// Set the acceleration due to the gravity force between this world and each dynamic 
 	// body in the world. 
 	// The acceleration has units of m/s^2.
@@ -89,8 +143,24 @@ public:
 	// The ray cast output is the intercepted shape, the intersection 
 	// point in world space, the face normal on the shape associated with the point, 
 	// and the intersection fraction.
+	// The ray is clipped at each hit, so the shapes behind the closest 
+	// hit found so far are skipped.
 	bool RayCastSingle(b3RayCastSingleOutput* output, const b3Vec3& p1, const b3Vec3& p2) const;
 
+	// Perform a ray cast with the world and stop at the first hit.
+	// The hit is not necessarily the closest one. 
+	// Use this for line of sight tests.
+	// If the ray doesn't intersect with a shape in the world then return false.
+	bool RayCastAny(b3RayCastSingleOutput* output, const b3Vec3& p1, const b3Vec3& p2) const;
+
+	// Perform a closest hit ray cast for each segment in a batch.
+	// The rays are cast in packets of four consecutive segments that walk 
+	// the trees together, so coherent rays should be stored next to each other.
+	// If a job system is set then the packets are cast in parallel.
+	// The output of a ray that doesn't intersect with a shape has a NULL shape.
+	// Return the number of rays that intersect with a shape.
+	u32 RayCastBatch(b3RayCastSingleOutput* outputs, const b3Vec3* p1s, const b3Vec3* p2s, u32 count) const;
+
 	// Perform a ray cast with the world.
 	// The given ray cast listener will be notified when a ray intersects a shape 
 	// in the world. 
@@ -99,12 +169,38 @@ public:
 	// and the intersection fraction.
 	void RayCast(b3RayCastListener* listener, const b3Vec3& p1, const b3Vec3& p2) const;
 
+	// Cast a sphere, capsule, or hull shape along a translation with the world.
+	// The shape is placed at a given transform and doesn't need to belong to a body. 
+	// If it does then the shapes of its body are ignored.
+	// If the shape doesn't hit a shape in the world then return false.
+	// The output is the first shape hit, the contact point on its surface in world space, 
+	// the surface normal pointing towards the cast shape, and the time of impact.
+	// The cast shape stops slightly before touching so it can be moved to the time of impact.
+	bool ShapeCast(b3ShapeCastSingleOutput* output, const b3Shape* shape, const b3Transform& xf, const b3Vec3& translation) const;
+
 	// Perform a AABB query with the world.
 	// The query listener will be notified when two shape AABBs are overlapping.
 	// If the listener returns false then the query is stopped immediately.
 	// Otherwise, it continues searching for new overlapping shape AABBs.
 	void QueryAABB(b3QueryListener* listener, const b3AABB3& aabb) const;
 
+	// Find the shapes in the world that overlap with a sphere, capsule, or hull shape.
+	// Unlike an AABB query the shapes are tested for exact overlap. 
+	// The shape is placed at a given transform and doesn't need to belong to a body. 
+	// If it does then the shapes of its body are ignored.
+	// The overlapping shapes are written to the given buffer and the query stops 
+	// when the buffer is full. 
+	// Return the number of shapes written to the buffer.
+	u32 QueryShape(b3Shape** shapes, u32 capacity, const b3Shape* shape, const b3Transform& xf) const;
+
+	// Find the shapes in the world that overlap with a sphere in world space.
+	// Return the number of shapes written to the buffer.
+	u32 QuerySphere(b3Shape** shapes, u32 capacity, const b3Sphere& sphere) const;
+
+	// Find the shapes in the world that overlap with a capsule in world space.
+	// Return the number of shapes written to the buffer.
+	u32 QueryCapsule(b3Shape** shapes, u32 capacity, const b3Capsule& capsule) const;
+
 	// Get the list of bodies in this world.
 	const b3List2<b3Body>& GetBodyList() const;
 	b3List2<b3Body>& GetBodyList();
@@ -138,9 +234,38 @@ private :
 
 	void Solve(float32 dt, u32 velocityIterations, u32 positionIterations);
 
+	// Solve a range of the islands built in a step.
+	static void SolveIslands(void* context, u32 begin, u32 end, u32 threadIndex);
+
+	// Get the stack allocator of a thread of the job system.
+	b3StackAllocator* GetThreadAllocator(u32 threadIndex);
+
+	// Sub-step the contacts of the bullet bodies at their first time of impact.
+	void SolveTOI(float32 dt, u32 velocityIterations);
+
+	// Perform a ray cast for the closest hit or for any hit.
+	bool RayCastSingle(b3RayCastSingleOutput* output, const b3Vec3& p1, const b3Vec3& p2, bool anyHit) const;
+
+	// Perform a closest hit ray cast for up to four segments at once.
+	void RayCastPacket(b3RayCastSingleOutput* outputs, const b3Vec3* p1s, const b3Vec3* p2s, u32 count) const;
+
+	// Cast a range of ray packets of a batch.
+	static void RayCastPackets(void* context, u32 begin, u32 end, u32 threadIndex);
+
 	bool m_sleeping;
 	bool m_warmStarting;
+	bool m_speculative;
+	bool m_wideSolver;
+	u32 m_subStepCount;
+	float32 m_dt;
+	u32 m_broadPhaseOptimizeCount;
 	u32 m_flags;
+	b3JobSystem* m_jobSystem;
+	
+	// The stack allocators of the job system threads except the first one, 
+	// which uses the world stack allocator.
+	b3StackAllocator* m_threadAllocators;
+	u32 m_threadAllocatorCount;
 	b3Vec3 m_gravity;
 
 	b3StackAllocator m_stackAllocator;
@@ -166,6 +291,22 @@ inline void b3World::SetContactFilter(b3ContactFilter* filter)
 	m_contactMan.m_contactFilter = filter;
 }
 
+inline void b3World::SetBroadPhaseOptimizeCount(u32 count)
+{
+	m_broadPhaseOptimizeCount = count;
+}
+
+inline void b3World::RebuildBroadPhase()
+{
+	m_contactMan.m_broadPhase.RebuildTree();
+}
+
+inline void b3World::SetJobSystem(b3JobSystem* jobSystem)
+{
+	m_jobSystem = jobSystem;
+	m_contactMan.m_broadPhase.SetJobSystem(jobSystem);
+}
+
 inline void b3World::SetGravity(const b3Vec3& gravity)
 {
 	m_gravity = gravity;
@@ -176,6 +317,22 @@ inline void b3World::SetWarmStart(bool flag)
 	m_warmStarting = flag;
 }
 
+inline void b3World::SetSpeculativeContacts(bool flag)
+{
+	m_speculative = flag;
+}
+
+inline void b3World::SetWideContactSolver(bool flag)
+{
+	m_wideSolver = flag;
+}
+
+inline void b3World::SetSubStepCount(u32 count)
+{
+	B3_ASSERT(count > 0);
+	m_subStepCount = count;
+}
+
 inline const b3List2<b3Body>& b3World::GetBodyList() const
 {
 	return m_bodyList;
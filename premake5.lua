@@ -346,6 +346,9 @@ solution (solution_name)
 		}
 
 		links { "bounce" }
+		
+		configuration { "not windows", "not macosx" }
+			links { "pthread" }
 
 -- build
 if os.istarget("windows") then
@@ -17,6 +17,10 @@
 */
 
 #include <bounce/collision/broad_phase.h>
+#include <bounce/common/job_system.h>
+
+// The number of moved proxies queried by a single task when finding pairs in parallel.
+#define B3_PAIR_TASK_PROXY_COUNT 64
 
 b3BroadPhase::b3BroadPhase() 
 {
@@ -29,12 +33,27 @@ b3BroadPhase::b3BroadPhase()
 	m_pairs = (b3Pair*)b3Alloc(m_pairCapacity * sizeof(b3Pair));
 	memset(m_pairs, 0, m_pairCapacity * sizeof(b3Pair));
 	m_pairCount = 0;
+
+	m_jobSystem = NULL;
+	
+	m_threadBuffers = NULL;
+	m_threadBufferCount = 0;
+	
+	m_tasks = NULL;
+	m_taskCapacity = 0;
 }
 
 b3BroadPhase::~b3BroadPhase() 
 {
 	b3Free(m_moveBuffer);
 	b3Free(m_pairs);
+	
+	for (u32 i = 0; i < m_threadBufferCount; ++i)
+	{
+		b3Free(m_threadBuffers[i].pairs);
+	}
+	b3Free(m_threadBuffers);
+	b3Free(m_tasks);
 }
 
 void b3BroadPhase::BufferMove(u32 proxyId) 
@@ -59,11 +78,19 @@ void b3BroadPhase::BufferMove(u32 proxyId)
 
 bool b3BroadPhase::TestOverlap(u32 proxy1, u32 proxy2) const 
 {
-	return m_tree.TestOverlap(proxy1, proxy2);
+	return b3TestOverlap(GetAABB(proxy1), GetAABB(proxy2));
 }
 
-u32 b3BroadPhase::CreateProxy(const b3AABB3& aabb, void* userData) 
+u32 b3BroadPhase::CreateProxy(const b3AABB3& aabb, void* userData, bool isStatic) 
 {
+	if (isStatic)
+	{
+		// Static proxies aren't extended.
+		u32 proxyId = m_staticTree.InsertNode(aabb, userData) | B3_STATIC_PROXY_BIT;
+		BufferMove(proxyId);
+		return proxyId;
+	}
+
 	// Later, if the node aabb has changed then it should be reinserted into the tree.
 	// However, this can be expansive due to the hierarchy reconstruction.
 	// Therefore, the original AABB is extended and inserted into the tree,
@@ -75,13 +102,64 @@ u32 b3BroadPhase::CreateProxy(const b3AABB3& aabb, void* userData)
 	return proxyId;
 }
 
+void b3BroadPhase::CreateProxies(u32* proxyIds, const b3AABB3* aabbs, void* const* userDatas, u32 count, bool isStatic)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	if (isStatic)
+	{
+		// Static proxies aren't extended.
+		m_staticTree.InsertNodes(proxyIds, aabbs, userDatas, count);
+
+		for (u32 i = 0; i < count; ++i)
+		{
+			proxyIds[i] |= B3_STATIC_PROXY_BIT;
+			BufferMove(proxyIds[i]);
+		}
+
+		return;
+	}
+
+	// Extend the original AABBs.
+	b3AABB3* fatAABBs = (b3AABB3*)b3Alloc(count * sizeof(b3AABB3));
+	for (u32 i = 0; i < count; ++i)
+	{
+		fatAABBs[i] = aabbs[i];
+		fatAABBs[i].Extend(B3_AABB_EXTENSION);
+	}
+
+	m_tree.InsertNodes(proxyIds, fatAABBs, userDatas, count);
+	
+	b3Free(fatAABBs);
+
+	for (u32 i = 0; i < count; ++i)
+	{
+		BufferMove(proxyIds[i]);
+	}
+}
+
 void b3BroadPhase::DestroyProxy(u32 proxyId) 
 {
+	if (IsStaticProxy(proxyId))
+	{
+		return m_staticTree.RemoveNode(proxyId & ~B3_STATIC_PROXY_BIT);
+	}
 	return m_tree.RemoveNode(proxyId);
 }
 
 bool b3BroadPhase::MoveProxy(u32 proxyId, const b3AABB3& aabb, const b3Vec3& displacement)
 {
+	if (IsStaticProxy(proxyId))
+	{
+		// Static proxies are moved with their exact AABB. 
+		m_staticTree.UpdateNode(proxyId & ~B3_STATIC_PROXY_BIT, aabb);
+		BufferMove(proxyId);
+		return true;
+	}
+
 	if (m_tree.GetAABB(proxyId).Contains(aabb))
 	{
 		// Do nothing if the new AABB is contained in the old AABB.
@@ -141,6 +219,20 @@ bool b3BroadPhase::Report(u32 proxyId)
 		return true;
 	}
 
+	AddPair(b3Min(proxyId, m_queryProxyId), b3Max(proxyId, m_queryProxyId));
+
+	// Keep looking for overlapping pairs.
+	return true;
+}
+
+void b3BroadPhase::AddPair(u32 proxy1, u32 proxy2)
+{
+	if (m_pairSet.Insert(proxy1, proxy2, NULL) == false)
+	{
+		// The pair was already found.
+		return;
+	}
+
 	// Check capacity.
 	if (m_pairCount == m_pairCapacity) 
 	{
@@ -154,10 +246,155 @@ bool b3BroadPhase::Report(u32 proxyId)
 	}
 
 	// Add overlapping pair to the pair buffer.
-	m_pairs[m_pairCount].proxy1 = b3Min(proxyId, m_queryProxyId);
-	m_pairs[m_pairCount].proxy2 = b3Max(proxyId, m_queryProxyId);
+	m_pairs[m_pairCount].proxy1 = proxy1;
+	m_pairs[m_pairCount].proxy2 = proxy2;
 	++m_pairCount;
+}
 
-	// Keep looking for overlapping pairs.
-	return true;
-}
\ No newline at end of file
+void b3BroadPhase::UpdatePairs()
+{
+	// Reset the overlapping pairs buffer for the current step.
+	m_pairCount = 0;
+	m_pairSet.Clear();
+
+	if (m_jobSystem && m_jobSystem->GetThreadCount() > 1 && m_moveBufferCount > B3_PAIR_TASK_PROXY_COUNT)
+	{
+		UpdatePairsParallel();
+		return;
+	}
+
+	// Notifying this class with QueryCallback(), gets the unique overlapping pair buffer.
+	for (u32 i = 0; i < m_moveBufferCount; ++i) 
+	{
+		// Keep the current queried proxy ID to avoid self overlapping.
+		m_queryProxyId = m_moveBuffer[i];
+		if (m_queryProxyId == B3_NULL_NODE_D) 
+		{
+			continue;
+		}
+
+		QueryMovedProxy(this, m_queryProxyId);
+	}
+}
+
+// The tree query callback used by a pair task. 
+// It appends the overlapping pairs to the buffer of the thread running the task.
+struct b3PairQueryCallback
+{
+	bool Report(u32 proxyId)
+	{
+		if (proxyId == queryProxyId)
+		{
+			// The proxy can't overlap with itself.
+			return true;
+		}
+
+		// Check capacity.
+		if (buffer->count == buffer->capacity)
+		{
+			// Duplicate capacity.
+			buffer->capacity *= 2;
+
+			b3Pair* oldPairs = buffer->pairs;
+			buffer->pairs = (b3Pair*)b3Alloc(buffer->capacity * sizeof(b3Pair));
+			memcpy(buffer->pairs, oldPairs, buffer->count * sizeof(b3Pair));
+			b3Free(oldPairs);
+		}
+
+		buffer->pairs[buffer->count].proxy1 = b3Min(proxyId, queryProxyId);
+		buffer->pairs[buffer->count].proxy2 = b3Max(proxyId, queryProxyId);
+		++buffer->count;
+
+		return true;
+	}
+
+	b3BroadPhase::b3PairBuffer* buffer;
+	u32 queryProxyId;
+};
+
+void b3BroadPhase::QueryTasks(void* context, u32 begin, u32 end, u32 threadIndex)
+{
+	b3BroadPhase* broadPhase = (b3BroadPhase*)context;
+	
+	B3_ASSERT(threadIndex < broadPhase->m_threadBufferCount);
+	b3PairBuffer* buffer = broadPhase->m_threadBuffers + threadIndex;
+
+	b3PairQueryCallback callback;
+	callback.buffer = buffer;
+
+	for (u32 i = begin; i < end; ++i)
+	{
+		b3PairTask* task = broadPhase->m_tasks + i;
+		task->threadIndex = threadIndex;
+		task->pairIndex = buffer->count;
+
+		u32 proxyBegin = i * B3_PAIR_TASK_PROXY_COUNT;
+		u32 proxyEnd = b3Min(proxyBegin + B3_PAIR_TASK_PROXY_COUNT, broadPhase->m_moveBufferCount);
+		
+		for (u32 j = proxyBegin; j < proxyEnd; ++j)
+		{
+			callback.queryProxyId = broadPhase->m_moveBuffer[j];
+			if (callback.queryProxyId == B3_NULL_NODE_D)
+			{
+				continue;
+			}
+
+			broadPhase->QueryMovedProxy(&callback, callback.queryProxyId);
+		}
+
+		task->pairCount = buffer->count - task->pairIndex;
+	}
+}
+
+void b3BroadPhase::UpdatePairsParallel()
+{
+	// Ensure there is a pair buffer for each thread.
+	u32 threadCount = m_jobSystem->GetThreadCount();
+	if (m_threadBufferCount < threadCount)
+	{
+		b3PairBuffer* oldBuffers = m_threadBuffers;
+		m_threadBuffers = (b3PairBuffer*)b3Alloc(threadCount * sizeof(b3PairBuffer));
+		memcpy(m_threadBuffers, oldBuffers, m_threadBufferCount * sizeof(b3PairBuffer));
+		b3Free(oldBuffers);
+
+		for (u32 i = m_threadBufferCount; i < threadCount; ++i)
+		{
+			m_threadBuffers[i].capacity = 256;
+			m_threadBuffers[i].pairs = (b3Pair*)b3Alloc(m_threadBuffers[i].capacity * sizeof(b3Pair));
+			m_threadBuffers[i].count = 0;
+		}
+
+		m_threadBufferCount = threadCount;
+	}
+
+	for (u32 i = 0; i < m_threadBufferCount; ++i)
+	{
+		m_threadBuffers[i].count = 0;
+	}
+
+	// Split the move buffer into tasks.
+	u32 taskCount = (m_moveBufferCount + B3_PAIR_TASK_PROXY_COUNT - 1) / B3_PAIR_TASK_PROXY_COUNT;
+	if (m_taskCapacity < taskCount)
+	{
+		b3Free(m_tasks);
+		m_taskCapacity = taskCount;
+		m_tasks = (b3PairTask*)b3Alloc(m_taskCapacity * sizeof(b3PairTask));
+	}
+
+	// The tree is only read while the tasks run.
+	m_jobSystem->ParallelFor(QueryTasks, this, taskCount, 1);
+
+	// Merge the task pairs in the move buffer order.
+	// This gives the same unique pairs in the same order as querying 
+	// the moved proxies one after the other.
+	for (u32 i = 0; i < taskCount; ++i)
+	{
+		const b3PairTask* task = m_tasks + i;
+		const b3Pair* pairs = m_threadBuffers[task->threadIndex].pairs + task->pairIndex;
+		
+		for (u32 j = 0; j < task->pairCount; ++j)
+		{
+			AddPair(pairs[j].proxy1, pairs[j].proxy2);
+		}
+	}
+}
@@ -0,0 +1,93 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include <bounce/collision/gjk/gjk.h>
+#include <bounce/collision/gjk/gjk_proxy.h>
+
+bool b3GJKShapeCast(b3GJKShapeCastOutput* output, 
+	const b3Transform& xf1, const b3GJKProxy& proxy1,
+	const b3Transform& xf2, const b3GJKProxy& proxy2, 
+	const b3Vec3& translation2, float32 maxFraction)
+{
+	// The proxies are advanced until their distance is close to the target distance.
+	// Keeping a small gap gives a valid normal at the time of impact.
+	const float32 kTarget = B3_LINEAR_SLOP;
+	const float32 kTol = 0.25f * B3_LINEAR_SLOP;
+
+	// Limit number of iterations to prevent cycling.
+	const u32 kMaxIters = 20;
+
+	// Reuse the simplex between the iterations.
+	b3SimplexCache cache;
+	cache.count = 0;
+
+	b3Transform xf = xf2;
+	
+	float32 t = 0.0f;
+	b3Vec3 point = xf1.position;
+	b3Vec3 normal(0.0f, 0.0f, 0.0f);
+
+	u32 iter = 0;
+	while (iter < kMaxIters)
+	{
+		++iter;
+
+		// Compute the distance at the current time.
+		xf.position = xf2.position + t * translation2;
+		
+		b3GJKOutput gjk = b3GJK(xf1, proxy1, xf, proxy2, true, &cache);
+		
+		point = gjk.point1;
+		
+		if (gjk.distance > B3_EPSILON)
+		{
+			normal = (1.0f / gjk.distance) * (gjk.point2 - gjk.point1);
+		}
+
+		if (gjk.distance < kTarget + kTol)
+		{
+			// The proxies are touching.
+			break;
+		}
+
+		// The distance can't decrease faster than the translation 
+		// projected onto the normal.
+		float32 approach = -b3Dot(normal, translation2);
+		if (approach <= B3_EPSILON)
+		{
+			// The proxies are moving apart.
+			return false;
+		}
+
+		// Advance to the time at which the proxies could be at the target distance.
+		t += (gjk.distance - kTarget) / approach;
+		
+		if (t > maxFraction)
+		{
+			// The proxies don't hit each other before the maximum fraction.
+			return false;
+		}
+	}
+
+	output->t = t;
+	output->point = point;
+	output->normal = normal;
+	output->iterations = iter;
+	return true;
+}
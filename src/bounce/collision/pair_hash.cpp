@@ -0,0 +1,203 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <bounce/collision/pair_hash.h>
+#include <bounce/common/math/math.h>
+
+// Marks an empty slot.
+#define B3_NULL_PAIR (0xFFFFFFFF)
+
+// Hash a pair of proxies. 
+// This is the 64-bit finalizer of MurmurHash3 applied to the packed pair.
+static B3_FORCE_INLINE u32 b3Hash(u32 proxy1, u32 proxy2)
+{
+	u64 key = (u64(proxy1) << 32) | u64(proxy2);
+	key ^= key >> 33;
+	key *= 0xFF51AFD7ED558CCDULL;
+	key ^= key >> 33;
+	key *= 0xC4CEB9FE1A85EC53ULL;
+	key ^= key >> 33;
+	return u32(key);
+}
+
+b3PairHash::b3PairHash()
+{
+	// The capacity must be a power of two.
+	m_capacity = 64;
+	m_entries = (b3Entry*)b3Alloc(m_capacity * sizeof(b3Entry));
+	m_count = 0;
+	Clear();
+}
+
+b3PairHash::~b3PairHash()
+{
+	b3Free(m_entries);
+}
+
+void b3PairHash::Clear()
+{
+	for (u32 i = 0; i < m_capacity; ++i)
+	{
+		m_entries[i].pair.proxy1 = B3_NULL_PAIR;
+	}
+	m_count = 0;
+}
+
+u32 b3PairHash::FindSlot(u32 proxy1, u32 proxy2) const
+{
+	u32 mask = m_capacity - 1;
+	u32 slot = b3Hash(proxy1, proxy2) & mask;
+	
+	// Linear probing.
+	for (;;)
+	{
+		const b3Entry* entry = m_entries + slot;
+		
+		if (entry->pair.proxy1 == B3_NULL_PAIR)
+		{
+			return slot;
+		}
+		
+		if (entry->pair.proxy1 == proxy1 && entry->pair.proxy2 == proxy2)
+		{
+			return slot;
+		}
+
+		slot = (slot + 1) & mask;
+	}
+}
+
+void b3PairHash::Grow()
+{
+	b3Entry* oldEntries = m_entries;
+	u32 oldCapacity = m_capacity;
+
+	m_capacity *= 2;
+	m_entries = (b3Entry*)b3Alloc(m_capacity * sizeof(b3Entry));
+	Clear();
+
+	for (u32 i = 0; i < oldCapacity; ++i)
+	{
+		const b3Entry* entry = oldEntries + i;
+		if (entry->pair.proxy1 == B3_NULL_PAIR)
+		{
+			continue;
+		}
+
+		u32 slot = FindSlot(entry->pair.proxy1, entry->pair.proxy2);
+		m_entries[slot] = *entry;
+		++m_count;
+	}
+
+	b3Free(oldEntries);
+}
+
+bool b3PairHash::Insert(u32 proxy1, u32 proxy2, void* userData)
+{
+	B3_ASSERT(proxy1 != B3_NULL_PAIR && proxy2 != B3_NULL_PAIR);
+
+	if (proxy1 > proxy2)
+	{
+		b3Swap(proxy1, proxy2);
+	}
+
+	u32 slot = FindSlot(proxy1, proxy2);
+	if (m_entries[slot].pair.proxy1 != B3_NULL_PAIR)
+	{
+		// The pair is already in the table.
+		return false;
+	}
+
+	// Keep the load factor below 1/2 so probe sequences stay short.
+	if (2 * (m_count + 1) > m_capacity)
+	{
+		Grow();
+		slot = FindSlot(proxy1, proxy2);
+	}
+
+	b3Entry* entry = m_entries + slot;
+	entry->pair.proxy1 = proxy1;
+	entry->pair.proxy2 = proxy2;
+	entry->userData = userData;
+	++m_count;
+
+	return true;
+}
+
+bool b3PairHash::Remove(u32 proxy1, u32 proxy2)
+{
+	if (proxy1 > proxy2)
+	{
+		b3Swap(proxy1, proxy2);
+	}
+
+	u32 slot = FindSlot(proxy1, proxy2);
+	if (m_entries[slot].pair.proxy1 == B3_NULL_PAIR)
+	{
+		// The pair is not in the table.
+		return false;
+	}
+
+	// Shift the following entries of the probe sequence backwards 
+	// so no tombstones are needed.
+	u32 mask = m_capacity - 1;
+	u32 hole = slot;
+	u32 next = (hole + 1) & mask;
+	for (;;)
+	{
+		b3Entry* entry = m_entries + next;
+		if (entry->pair.proxy1 == B3_NULL_PAIR)
+		{
+			break;
+		}
+
+		// Move the entry into the hole if the hole is cyclically 
+		// between the home slot of the entry and the entry.
+		u32 home = b3Hash(entry->pair.proxy1, entry->pair.proxy2) & mask;
+		u32 distanceToEntry = (next - home) & mask;
+		u32 distanceToHole = (hole - home) & mask;
+		if (distanceToHole < distanceToEntry)
+		{
+			m_entries[hole] = *entry;
+			hole = next;
+		}
+
+		next = (next + 1) & mask;
+	}
+
+	m_entries[hole].pair.proxy1 = B3_NULL_PAIR;
+	--m_count;
+
+	return true;
+}
+
+void* b3PairHash::Find(u32 proxy1, u32 proxy2) const
+{
+	if (proxy1 > proxy2)
+	{
+		b3Swap(proxy1, proxy2);
+	}
+
+	u32 slot = FindSlot(proxy1, proxy2);
+	if (m_entries[slot].pair.proxy1 == B3_NULL_PAIR)
+	{
+		return NULL;
+	}
+
+	return m_entries[slot].userData;
+}
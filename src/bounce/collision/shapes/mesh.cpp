@@ -0,0 +1,143 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <bounce/collision/shapes/mesh.h>
+
+// The header of a cooked mesh.
+// The offsets are relative to the beginning of the header.
+struct b3CookedMeshHeader
+{
+	u32 magic;
+	u32 version;
+	u32 size;
+	u32 vertexCount;
+	u32 vertexOffset;
+	u32 triangleCount;
+	u32 triangleOffset;
+	u32 treeOffset;
+	u32 treeSize;
+};
+
+// "B3MS"
+#define B3_COOKED_MESH_MAGIC (0x534D3342)
+
+// The version of the cooked mesh format.
+#define B3_COOKED_MESH_VERSION (1)
+
+u32 b3Mesh::GetCookedSize() const
+{
+	u32 size = b3AlignCooked(sizeof(b3CookedMeshHeader));
+	size += b3AlignCooked(vertexCount * sizeof(b3Vec3));
+	size += b3AlignCooked(triangleCount * sizeof(b3Triangle));
+	size += tree.GetCookedSize();
+	return size;
+}
+
+void b3Mesh::Cook(void* buffer) const
+{
+	B3_ASSERT(((size_t)buffer & (B3_COOKED_TREE_ALIGNMENT - 1)) == 0);
+
+	u8* bytes = (u8*)buffer;
+
+	b3CookedMeshHeader header;
+	header.magic = B3_COOKED_MESH_MAGIC;
+	header.version = B3_COOKED_MESH_VERSION;
+	header.size = GetCookedSize();
+	header.vertexCount = vertexCount;
+	header.vertexOffset = b3AlignCooked(sizeof(b3CookedMeshHeader));
+	header.triangleCount = triangleCount;
+	header.triangleOffset = header.vertexOffset + b3AlignCooked(vertexCount * sizeof(b3Vec3));
+	header.treeOffset = header.triangleOffset + b3AlignCooked(triangleCount * sizeof(b3Triangle));
+	header.treeSize = tree.GetCookedSize();
+
+	// Zero the padding so the same mesh always gives the same bytes.
+	memset(bytes, 0, header.treeOffset);
+	memcpy(bytes, &header, sizeof(b3CookedMeshHeader));
+	memcpy(bytes + header.vertexOffset, vertices, vertexCount * sizeof(b3Vec3));
+	memcpy(bytes + header.triangleOffset, triangles, triangleCount * sizeof(b3Triangle));
+	tree.Cook(bytes + header.treeOffset);
+}
+
+bool b3Mesh::Load(const void* buffer, u32 size)
+{
+	if (((size_t)buffer & (B3_COOKED_TREE_ALIGNMENT - 1)) != 0)
+	{
+		return false;
+	}
+
+	if (size < sizeof(b3CookedMeshHeader))
+	{
+		return false;
+	}
+
+	const u8* bytes = (const u8*)buffer;
+	const b3CookedMeshHeader* header = (const b3CookedMeshHeader*)bytes;
+
+	if (header->magic != B3_COOKED_MESH_MAGIC || header->version != B3_COOKED_MESH_VERSION)
+	{
+		return false;
+	}
+
+	if (header->size > size)
+	{
+		return false;
+	}
+
+	// Check the arrays are inside the buffer.
+	if (u64(header->vertexOffset) + u64(header->vertexCount) * sizeof(b3Vec3) > header->size ||
+		u64(header->triangleOffset) + u64(header->triangleCount) * sizeof(b3Triangle) > header->size ||
+		u64(header->treeOffset) + u64(header->treeSize) > header->size)
+	{
+		return false;
+	}
+
+	// Check the arrays are aligned.
+	if ((header->vertexOffset & 3) != 0 || (header->triangleOffset & 3) != 0)
+	{
+		return false;
+	}
+
+	// Check the triangles index the vertices.
+	const b3Triangle* cookedTriangles = (const b3Triangle*)(bytes + header->triangleOffset);
+	for (u32 i = 0; i < header->triangleCount; ++i)
+	{
+		const b3Triangle* t = cookedTriangles + i;
+		if (t->v1 >= header->vertexCount || t->v2 >= header->vertexCount || t->v3 >= header->vertexCount)
+		{
+			return false;
+		}
+	}
+
+	// Check the tree proxies index the triangles.
+	if (b3StaticTree::IsCookedValid(bytes + header->treeOffset, header->treeSize, header->triangleCount) == false)
+	{
+		return false;
+	}
+
+	// The buffer is valid. Commit the state.
+	bool loaded = tree.Load(bytes + header->treeOffset, header->treeSize);
+	B3_ASSERT(loaded);
+	B3_NOT_USED(loaded);
+
+	vertexCount = header->vertexCount;
+	vertices = (b3Vec3*)(bytes + header->vertexOffset);
+	triangleCount = header->triangleCount;
+	triangles = (b3Triangle*)(bytes + header->triangleOffset);
+
+	return true;
+}
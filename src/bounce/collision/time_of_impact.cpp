@@ -0,0 +1,157 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <bounce/collision/time_of_impact.h>
+#include <bounce/collision/gjk/gjk.h>
+#include <bounce/collision/gjk/gjk_proxy.h>
+
+u32 b3_toiCalls = 0, b3_toiIters = 0, b3_toiMaxIters = 0;
+
+// Compute the maximum speed of a proxy point due to the rotation of a sweep 
+// in the interval [0, 1].
+static float32 b3ComputeAngularBound(const b3Sweep& sweep, const b3GJKProxy& proxy)
+{
+	// Maximum distance of the proxy to the center of mass.
+	float32 maxRadiusSq = 0.0f;
+	for (u32 i = 0; i < proxy.vertexCount; ++i)
+	{
+		float32 radiusSq = b3DistanceSquared(proxy.vertices[i], sweep.localCenter);
+		maxRadiusSq = b3Max(maxRadiusSq, radiusSq);
+	}
+	float32 maxRadius = b3Sqrt(maxRadiusSq) + proxy.radius;
+
+	// The sweep interpolates the orientations linearly and normalizes the result.
+	// Its angular speed is largest in the middle of the interval, where 
+	// it is 4 * tan(angle / 2), for the angle between the two orientations.
+	float32 cosine = b3Clamp(b3Dot(sweep.orientation0, sweep.orientation), -1.0f, 1.0f);
+	float32 angle = acosf(cosine);
+	float32 angularSpeed = 4.0f * tanf(0.5f * angle);
+
+	return angularSpeed * maxRadius;
+}
+
+b3TOIOutput b3TimeOfImpact(const b3Sweep& sweep1, const b3GJKProxy& proxy1,
+	const b3Sweep& sweep2, const b3GJKProxy& proxy2, float32 tMax)
+{
+	++b3_toiCalls;
+
+	b3TOIOutput output;
+	output.state = e_toiSeparated;
+	output.t = tMax;
+	output.iterations = 0;
+
+	// The proxies are advanced until the distance between their cores is close to 
+	// the target distance. Keeping a small gap between the cores gives a valid 
+	// normal at the time of impact.
+	float32 totalRadius = proxy1.radius + proxy2.radius;
+	float32 target = b3Max(B3_LINEAR_SLOP, totalRadius - 3.0f * B3_LINEAR_SLOP);
+	float32 tolerance = 0.25f * B3_LINEAR_SLOP;
+
+	// Limit number of iterations to prevent cycling.
+	const u32 kMaxIters = 20;
+
+	// Linear motion of the centers of mass.
+	b3Vec3 d1 = sweep1.worldCenter - sweep1.worldCenter0;
+	b3Vec3 d2 = sweep2.worldCenter - sweep2.worldCenter0;
+	
+	// Angular motion bound of the proxies.
+	float32 angularBound = b3ComputeAngularBound(sweep1, proxy1) + b3ComputeAngularBound(sweep2, proxy2);
+
+	// Reuse the simplex between the iterations.
+	b3SimplexCache cache;
+	cache.count = 0;
+
+	float32 t = 0.0f;
+
+	u32 iter = 0;
+	for (;;)
+	{
+		b3Transform xf1 = sweep1.GetTransform(t);
+		b3Transform xf2 = sweep2.GetTransform(t);
+
+		b3GJKOutput gjk = b3GJK(xf1, proxy1, xf2, proxy2, false, &cache);
+		
+		++iter;
+		++b3_toiIters;
+
+		if (iter == 1 && gjk.distance <= 10.0f * B3_EPSILON)
+		{
+			// The cores are initially overlapping.
+			// This is handled by the discrete collision.
+			output.state = e_toiOverlapped;
+			output.t = 0.0f;
+			break;
+		}
+
+		b3Vec3 normal = (1.0f / gjk.distance) * (gjk.point2 - gjk.point1);
+
+		// Relative linear speed along the normal.
+		float32 linearApproach = -b3Dot(normal, d2 - d1);
+
+		if (gjk.distance < target + tolerance)
+		{
+			// The proxies are touching. 
+			// Rounded proxies overlap at the target distance. Hulls have no radius, 
+			// so push the time past the gap to make them overlap by about the linear slop.
+			float32 gap = gjk.distance - totalRadius;
+			if (gap > -B3_LINEAR_SLOP && linearApproach > B3_EPSILON)
+			{
+				t += (gap + B3_LINEAR_SLOP) / linearApproach;
+			}
+
+			output.state = e_toiTouching;
+			output.t = b3Min(t, tMax);
+			break;
+		}
+
+		// The distance can't decrease faster than the approach bound.
+		float32 approach = linearApproach + angularBound;
+		if (approach <= B3_EPSILON)
+		{
+			// The proxies are moving apart.
+			output.state = e_toiSeparated;
+			output.t = tMax;
+			break;
+		}
+
+		// Advance to the time at which the proxies could be at the target distance.
+		t += (gjk.distance - target) / approach;
+
+		if (t >= tMax)
+		{
+			// The proxies don't touch in the interval.
+			output.state = e_toiSeparated;
+			output.t = tMax;
+			break;
+		}
+
+		if (iter == kMaxIters)
+		{
+			// Root finder got stuck. 
+			// Return the last time, which is still safe.
+			output.state = e_toiFailed;
+			output.t = t;
+			break;
+		}
+	}
+
+	b3_toiMaxIters = b3Max(b3_toiMaxIters, iter);
+
+	output.iterations = iter;
+	return output;
+}
@@ -17,6 +17,7 @@
 */
 
 #include <bounce/collision/trees/dynamic_tree.h>
+#include <bounce/collision/trees/tree_bins.h>
 #include <bounce/common/draw.h>
 
 b3DynamicTree::b3DynamicTree() 
@@ -25,9 +26,14 @@ b3DynamicTree::b3DynamicTree()
 
 	// Preallocate 32 nodes.
 	m_nodeCapacity = 32;
-	m_nodes = (b3Node*) b3Alloc(m_nodeCapacity * sizeof(b3Node));
+	m_nodes = (b3Node*) b3AllocAligned(m_nodeCapacity * sizeof(b3Node), B3_CACHE_LINE_SIZE);
 	memset(m_nodes, 0, m_nodeCapacity * sizeof(b3Node));
+	m_nodeInfos = (b3NodeInfo*) b3Alloc(m_nodeCapacity * sizeof(b3NodeInfo));
+	memset(m_nodeInfos, 0, m_nodeCapacity * sizeof(b3NodeInfo));
+	m_userDatas = (void**) b3Alloc(m_nodeCapacity * sizeof(void*));
+	memset(m_userDatas, 0, m_nodeCapacity * sizeof(void*));
 	m_nodeCount = 0;
+	m_path = 0;
 
 	// Link the allocated nodes and make the first node 
 	// available the the next allocation.
@@ -36,7 +42,9 @@ b3DynamicTree::b3DynamicTree()
 
 b3DynamicTree::~b3DynamicTree() 
 {
-	b3Free(m_nodes);
+	b3FreeAligned(m_nodes);
+	b3Free(m_nodeInfos);
+	b3Free(m_userDatas);
 }
 
 // Return a node from the pool.
@@ -52,9 +60,19 @@ u32 b3DynamicTree::AllocateNode()
 		m_nodeCapacity *= 2;
 
 		b3Node* oldNodes = m_nodes;
-		m_nodes = (b3Node*) b3Alloc(m_nodeCapacity * sizeof(b3Node));;
+		m_nodes = (b3Node*) b3AllocAligned(m_nodeCapacity * sizeof(b3Node), B3_CACHE_LINE_SIZE);
 		memcpy(m_nodes, oldNodes, m_nodeCount * sizeof(b3Node));
-		b3Free(oldNodes);
+		b3FreeAligned(oldNodes);
+
+		b3NodeInfo* oldInfos = m_nodeInfos;
+		m_nodeInfos = (b3NodeInfo*) b3Alloc(m_nodeCapacity * sizeof(b3NodeInfo));
+		memcpy(m_nodeInfos, oldInfos, m_nodeCount * sizeof(b3NodeInfo));
+		b3Free(oldInfos);
+
+		void** oldUserDatas = m_userDatas;
+		m_userDatas = (void**) b3Alloc(m_nodeCapacity * sizeof(void*));
+		memcpy(m_userDatas, oldUserDatas, m_nodeCount * sizeof(void*));
+		b3Free(oldUserDatas);
 
 		// Link the (allocated) nodes starting from the new 
 		// node and make the new nodes available the the next allocation.
@@ -64,13 +82,13 @@ u32 b3DynamicTree::AllocateNode()
 	// Grab the free node.
 	u32 node = m_freeList;
 
-	m_freeList = m_nodes[node].next;
+	m_freeList = m_nodeInfos[node].next;
 
-	m_nodes[node].parent = B3_NULL_NODE_D;
+	m_nodeInfos[node].parent = B3_NULL_NODE_D;
 	m_nodes[node].child1 = B3_NULL_NODE_D;
 	m_nodes[node].child2 = B3_NULL_NODE_D;
-	m_nodes[node].height = 0;
-	m_nodes[node].userData = NULL;
+	m_nodeInfos[node].height = 0;
+	m_userDatas[node] = NULL;
 
 	++m_nodeCount;
 
@@ -80,8 +98,8 @@ u32 b3DynamicTree::AllocateNode()
 void b3DynamicTree::FreeNode(u32 node) 
 {
 	B3_ASSERT(node != B3_NULL_NODE_D && node < m_nodeCapacity);
-	m_nodes[node].next = m_freeList;
-	m_nodes[node].height = -1;
+	m_nodeInfos[node].next = m_freeList;
+	m_nodeInfos[node].height = -1;
 	m_freeList = node;
 	--m_nodeCount;
 }
@@ -93,12 +111,12 @@ void b3DynamicTree::AddToFreeList(u32 node)
 	// Starting from the given node, relink the linked list of nodes.
 	for (u32 i = node; i < m_nodeCapacity - 1; ++i) 
 	{
-		m_nodes[i].next = i + 1;
-		m_nodes[i].height = -1;
+		m_nodeInfos[i].next = i + 1;
+		m_nodeInfos[i].height = -1;
 	}
 
-	m_nodes[m_nodeCapacity - 1].next = B3_NULL_NODE_D;
-	m_nodes[m_nodeCapacity - 1].height = -1;
+	m_nodeInfos[m_nodeCapacity - 1].next = B3_NULL_NODE_D;
+	m_nodeInfos[m_nodeCapacity - 1].height = -1;
 
 	// Make the node available for the next allocation.
 	m_freeList = node;
@@ -109,8 +127,8 @@ u32 b3DynamicTree::InsertNode(const b3AABB3& aabb, void* userData)
 	// Insert into the array.
 	u32 node = AllocateNode();
 	m_nodes[node].aabb = aabb;
-	m_nodes[node].userData = userData;
-	m_nodes[node].height = 0;
+	m_userDatas[node] = userData;
+	m_nodeInfos[node].height = 0;
 
 	// Insert into the tree.
 	InsertLeaf(node);
@@ -119,6 +137,35 @@ u32 b3DynamicTree::InsertNode(const b3AABB3& aabb, void* userData)
 	return node;
 }
 
+void b3DynamicTree::InsertNodes(u32* proxyIds, const b3AABB3* aabbs, void* const* userDatas, u32 count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// Insert into the array.
+	u32* leaves = (u32*)b3Alloc(count * sizeof(u32));
+	for (u32 i = 0; i < count; ++i)
+	{
+		u32 node = AllocateNode();
+		m_nodes[node].aabb = aabbs[i];
+		m_userDatas[node] = userDatas[i];
+		m_nodeInfos[node].height = 0;
+
+		proxyIds[i] = node;
+		leaves[i] = node;
+	}
+
+	// Build a subtree containing the new leaves.
+	u32 subtree = BuildTopDown(leaves, count, 0);
+	
+	b3Free(leaves);
+
+	// Insert the subtree into the tree.
+	InsertLeaf(subtree);
+}
+
 void b3DynamicTree::RemoveNode(u32 proxyId) 
 {
 	// Remove from the tree.
@@ -138,6 +185,115 @@ void b3DynamicTree::UpdateNode(u32 proxyId, const b3AABB3& aabb)
 	InsertLeaf(proxyId);
 }
 
+void b3DynamicTree::Rebuild()
+{
+	if (m_root == B3_NULL_NODE_D)
+	{
+		return;
+	}
+
+	// Collect the leaves and free the internal nodes.
+	u32* leaves = (u32*)b3Alloc(m_nodeCount * sizeof(u32));
+	u32 leafCount = 0;
+	for (u32 i = 0; i < m_nodeCapacity; ++i)
+	{
+		if (m_nodeInfos[i].height < 0)
+		{
+			// Free node.
+			continue;
+		}
+
+		if (m_nodes[i].IsLeaf())
+		{
+			m_nodeInfos[i].parent = B3_NULL_NODE_D;
+			leaves[leafCount++] = i;
+		}
+		else
+		{
+			FreeNode(i);
+		}
+	}
+
+	m_root = BuildTopDown(leaves, leafCount, 0);
+	m_nodeInfos[m_root].parent = B3_NULL_NODE_D;
+
+	b3Free(leaves);
+}
+
+// Get the AABBs of the leaves being rebuilt.
+template<class T>
+struct b3NodeAABBs
+{
+	const b3AABB3& GetAABB(u32 id) const
+	{
+		return nodes[id].aabb;
+	}
+
+	const T* nodes;
+};
+
+u32 b3DynamicTree::BuildTopDown(u32* leaves, u32 count, u32 depth)
+{
+	B3_ASSERT(count > 0);
+
+	if (count == 1)
+	{
+		return leaves[0];
+	}
+
+	b3NodeAABBs<b3Node> aabbs;
+	aabbs.nodes = m_nodes;
+
+	// Compute the bounds of the leaves and their centroids.
+	b3AABB3 aabb, centroidAABB;
+	b3ComputeTreeBounds(aabb, centroidAABB, aabbs, leaves, count);
+
+	// Partition the leaves.
+	b3TreeSplit split = b3FindTreeSplit(aabbs, leaves, count, centroidAABB, depth);
+	u32 middle = b3PartitionTreeSplit(aabbs, leaves, count, centroidAABB, split);
+
+	// Build the subtrees.
+	u32 child1 = BuildTopDown(leaves, middle, depth + 1);
+	u32 child2 = BuildTopDown(leaves + middle, count - middle, depth + 1);
+
+	u32 parent = AllocateNode();
+	m_nodes[parent].child1 = child1;
+	m_nodes[parent].child2 = child2;
+	m_nodes[parent].aabb = aabb;
+	m_nodeInfos[parent].height = 1 + b3Max(m_nodeInfos[child1].height, m_nodeInfos[child2].height);
+	m_nodeInfos[child1].parent = parent;
+	m_nodeInfos[child2].parent = parent;
+
+	return parent;
+}
+
+void b3DynamicTree::Optimize(u32 leafCount)
+{
+	if (m_root == B3_NULL_NODE_D)
+	{
+		return;
+	}
+
+	for (u32 i = 0; i < leafCount; ++i)
+	{
+		// Walk down the tree using the bits of the current path
+		// as the branch selectors. 
+		u32 node = m_root;
+		u32 bit = 0;
+		while (m_nodes[node].IsLeaf() == false)
+		{
+			node = (m_path >> bit) & 1 ? m_nodes[node].child2 : m_nodes[node].child1;
+			bit = (bit + 1) & 31;
+		}
+
+		// Reinsert the leaf.
+		RemoveLeaf(node);
+		InsertLeaf(node);
+
+		++m_path;
+	}
+}
+
 u32 b3DynamicTree::FindBest(const b3AABB3& leafAABB) const 
 {
 	u32 index = m_root;
@@ -208,28 +364,28 @@ void b3DynamicTree::InsertLeaf(u32 leaf)
 		// If this tree root node is empty then just set the leaf
 		// node to it.
 		m_root = leaf;
-		m_nodes[m_root].parent = B3_NULL_NODE_D;
+		m_nodeInfos[m_root].parent = B3_NULL_NODE_D;
 		return;
 	}
 
-	// Get the inserted leaf AABB.
+	// Get the inserted leaf or subtree AABB.
 	b3AABB3 leafAabb = m_nodes[leaf].aabb;
 	
 	// Search for the best branch node of this tree starting from the tree root node.
 	u32 sibling = FindBest(leafAabb);
 
-	u32 oldParent = m_nodes[sibling].parent;
+	u32 oldParent = m_nodeInfos[sibling].parent;
 	
 	// Create and setup new parent. 
 	u32 newParent = AllocateNode();
-	m_nodes[newParent].parent = oldParent;
+	m_nodeInfos[newParent].parent = oldParent;
 	m_nodes[newParent].child1 = sibling;
-	m_nodes[sibling].parent = newParent;	
+	m_nodeInfos[sibling].parent = newParent;	
 	m_nodes[newParent].child2 = leaf;
-	m_nodes[leaf].parent = newParent;	
-	m_nodes[newParent].userData = NULL;
+	m_nodeInfos[leaf].parent = newParent;	
+	m_userDatas[newParent] = NULL;
 	m_nodes[newParent].aabb = b3Combine(leafAabb, m_nodes[sibling].aabb);
-	m_nodes[newParent].height = m_nodes[sibling].height + 1;
+	m_nodeInfos[newParent].height = 1 + b3Max(m_nodeInfos[sibling].height, m_nodeInfos[leaf].height);
 
 	if (oldParent != B3_NULL_NODE_D) 
 	{
@@ -254,6 +410,9 @@ void b3DynamicTree::InsertLeaf(u32 leaf)
 
 	// If we have ancestor nodes then adjust its AABBs.
 	WalkBackNodeAndCombineVolumes(newParent);
+
+	// The queries walk the tree using a stack of fixed capacity.
+	B3_ASSERT(m_nodeInfos[m_root].height <= B3_MAX_TREE_HEIGHT);
 }
 
 void b3DynamicTree::RemoveLeaf(u32 leaf) 
@@ -264,8 +423,8 @@ void b3DynamicTree::RemoveLeaf(u32 leaf)
 		return;
 	}
 
-	u32 parent = m_nodes[leaf].parent;
-	u32 grandParent = m_nodes[parent].parent;
+	u32 parent = m_nodeInfos[leaf].parent;
+	u32 grandParent = m_nodeInfos[parent].parent;
 	u32 sibling;
 	if (m_nodes[parent].child1 == leaf) 
 	{
@@ -286,7 +445,7 @@ void b3DynamicTree::RemoveLeaf(u32 leaf)
 		{
 			m_nodes[grandParent].child2 = sibling;
 		}
-		m_nodes[sibling].parent = grandParent;
+		m_nodeInfos[sibling].parent = grandParent;
 		
 		// Remove parent node.
 		FreeNode(parent);
@@ -297,7 +456,7 @@ void b3DynamicTree::RemoveLeaf(u32 leaf)
 	else 
 	{
 		m_root = sibling;
-		m_nodes[sibling].parent = B3_NULL_NODE_D;		
+		m_nodeInfos[sibling].parent = B3_NULL_NODE_D;		
 		// Remove parent node.
 		FreeNode(parent);
 	}
@@ -307,7 +466,8 @@ void b3DynamicTree::WalkBackNodeAndCombineVolumes(u32 node)
 {
 	while (node != B3_NULL_NODE_D) 
 	{
-		//@todo node = Balance(node);
+		// Keep the tree height logarithmic.
+		node = Balance(node);
 
 		u32 child1 = m_nodes[node].child1;
 		u32 child2 = m_nodes[node].child2;
@@ -315,11 +475,233 @@ void b3DynamicTree::WalkBackNodeAndCombineVolumes(u32 node)
 		B3_ASSERT(child1 != B3_NULL_NODE_D);
 		B3_ASSERT(child2 != B3_NULL_NODE_D);
 
-		m_nodes[node].height = 1 + b3Max(m_nodes[child1].height, m_nodes[child2].height);
+		m_nodeInfos[node].height = 1 + b3Max(m_nodeInfos[child1].height, m_nodeInfos[child2].height);
 		m_nodes[node].aabb = b3Combine(m_nodes[child1].aabb, m_nodes[child2].aabb);
 
-		node = m_nodes[node].parent;
+		node = m_nodeInfos[node].parent;
+	}
+}
+
+// Perform a left or right rotation if node A is imbalanced.
+// Let B and C be the children of A, D and E be the children of B, 
+// and F and G be the children of C.
+// If C is higher than B then C is promoted to the position of A.
+// The higher child of C (F or G) stays with C and the other child 
+// of C replaces C as a child of A. The symmetric case promotes B.
+u32 b3DynamicTree::Balance(u32 iA)
+{
+	B3_ASSERT(iA != B3_NULL_NODE_D);
+
+	b3Node* A = m_nodes + iA;
+	b3NodeInfo* infoA = m_nodeInfos + iA;
+	if (A->IsLeaf() || infoA->height < 2)
+	{
+		return iA;
+	}
+
+	u32 iB = A->child1;
+	u32 iC = A->child2;
+	B3_ASSERT(iB < m_nodeCapacity);
+	B3_ASSERT(iC < m_nodeCapacity);
+
+	b3Node* B = m_nodes + iB;
+	b3NodeInfo* infoB = m_nodeInfos + iB;
+	b3Node* C = m_nodes + iC;
+	b3NodeInfo* infoC = m_nodeInfos + iC;
+
+	i32 balance = infoC->height - infoB->height;
+
+	// Rotate C up.
+	if (balance > 1)
+	{
+		u32 iF = C->child1;
+		u32 iG = C->child2;
+		B3_ASSERT(iF < m_nodeCapacity);
+		B3_ASSERT(iG < m_nodeCapacity);
+
+		b3Node* F = m_nodes + iF;
+		b3NodeInfo* infoF = m_nodeInfos + iF;
+		b3Node* G = m_nodes + iG;
+		b3NodeInfo* infoG = m_nodeInfos + iG;
+
+		// Swap A and C.
+		C->child1 = iA;
+		infoC->parent = infoA->parent;
+		infoA->parent = iC;
+
+		// A's old parent should point to C.
+		if (infoC->parent != B3_NULL_NODE_D)
+		{
+			if (m_nodes[infoC->parent].child1 == iA)
+			{
+				m_nodes[infoC->parent].child1 = iC;
+			}
+			else
+			{
+				B3_ASSERT(m_nodes[infoC->parent].child2 == iA);
+				m_nodes[infoC->parent].child2 = iC;
+			}
+		}
+		else
+		{
+			m_root = iC;
+		}
+
+		// Rotate.
+		if (infoF->height > infoG->height)
+		{
+			C->child2 = iF;
+			A->child2 = iG;
+			infoG->parent = iA;
+			A->aabb = b3Combine(B->aabb, G->aabb);
+			C->aabb = b3Combine(A->aabb, F->aabb);
+
+			infoA->height = 1 + b3Max(infoB->height, infoG->height);
+			infoC->height = 1 + b3Max(infoA->height, infoF->height);
+		}
+		else
+		{
+			C->child2 = iG;
+			A->child2 = iF;
+			infoF->parent = iA;
+			A->aabb = b3Combine(B->aabb, F->aabb);
+			C->aabb = b3Combine(A->aabb, G->aabb);
+
+			infoA->height = 1 + b3Max(infoB->height, infoF->height);
+			infoC->height = 1 + b3Max(infoA->height, infoG->height);
+		}
+
+		return iC;
+	}
+
+	// Rotate B up.
+	if (balance < -1)
+	{
+		u32 iD = B->child1;
+		u32 iE = B->child2;
+		B3_ASSERT(iD < m_nodeCapacity);
+		B3_ASSERT(iE < m_nodeCapacity);
+
+		b3Node* D = m_nodes + iD;
+		b3NodeInfo* infoD = m_nodeInfos + iD;
+		b3Node* E = m_nodes + iE;
+		b3NodeInfo* infoE = m_nodeInfos + iE;
+
+		// Swap A and B.
+		B->child1 = iA;
+		infoB->parent = infoA->parent;
+		infoA->parent = iB;
+
+		// A's old parent should point to B.
+		if (infoB->parent != B3_NULL_NODE_D)
+		{
+			if (m_nodes[infoB->parent].child1 == iA)
+			{
+				m_nodes[infoB->parent].child1 = iB;
+			}
+			else
+			{
+				B3_ASSERT(m_nodes[infoB->parent].child2 == iA);
+				m_nodes[infoB->parent].child2 = iB;
+			}
+		}
+		else
+		{
+			m_root = iB;
+		}
+
+		// Rotate.
+		if (infoD->height > infoE->height)
+		{
+			B->child2 = iD;
+			A->child1 = iE;
+			infoE->parent = iA;
+			A->aabb = b3Combine(C->aabb, E->aabb);
+			B->aabb = b3Combine(A->aabb, D->aabb);
+
+			infoA->height = 1 + b3Max(infoC->height, infoE->height);
+			infoB->height = 1 + b3Max(infoA->height, infoD->height);
+		}
+		else
+		{
+			B->child2 = iE;
+			A->child1 = iD;
+			infoD->parent = iA;
+			A->aabb = b3Combine(C->aabb, D->aabb);
+			B->aabb = b3Combine(A->aabb, E->aabb);
+
+			infoA->height = 1 + b3Max(infoC->height, infoD->height);
+			infoB->height = 1 + b3Max(infoA->height, infoE->height);
+		}
+
+		return iB;
+	}
+
+	return iA;
+}
+
+u32 b3DynamicTree::GetHeight() const
+{
+	if (m_root == B3_NULL_NODE_D)
+	{
+		return 0;
+	}
+
+	return m_nodeInfos[m_root].height;
+}
+
+u32 b3DynamicTree::GetMaxBalance() const
+{
+	i32 maxBalance = 0;
+	for (u32 i = 0; i < m_nodeCapacity; ++i)
+	{
+		// Skip free and leaf nodes.
+		if (m_nodeInfos[i].height <= 0)
+		{
+			continue;
+		}
+
+		const b3Node* node = m_nodes + i;
+		B3_ASSERT(node->IsLeaf() == false);
+
+		i32 balance = b3Abs(m_nodeInfos[node->child2].height - m_nodeInfos[node->child1].height);
+		maxBalance = b3Max(maxBalance, balance);
+	}
+
+	return maxBalance;
+}
+
+float32 b3DynamicTree::GetInternalArea() const
+{
+	float32 area = 0.0f;
+	for (u32 i = 0; i < m_nodeCapacity; ++i)
+	{
+		// Skip free and leaf nodes.
+		if (m_nodeInfos[i].height <= 0)
+		{
+			continue;
+		}
+
+		area += m_nodes[i].aabb.SurfaceArea();
+	}
+
+	return area;
+}
+
+float32 b3DynamicTree::GetAreaRatio() const
+{
+	if (m_root == B3_NULL_NODE_D)
+	{
+		return 0.0f;
 	}
+
+	float32 rootArea = m_nodes[m_root].aabb.SurfaceArea();
+	if (rootArea == 0.0f)
+	{
+		return 0.0f;
+	}
+
+	return GetInternalArea() / rootArea;
 }
 
 void b3DynamicTree::Validate(u32 nodeID) const 
@@ -332,7 +714,7 @@ void b3DynamicTree::Validate(u32 nodeID) const
 	// The root node has no parent.
 	if (nodeID == m_root) 
 	{
-		B3_ASSERT(m_nodes[nodeID].parent == B3_NULL_NODE_D);
+		B3_ASSERT(m_nodeInfos[nodeID].parent == B3_NULL_NODE_D);
 	}
 
 	const b3Node* node = m_nodes + nodeID;
@@ -345,7 +727,7 @@ void b3DynamicTree::Validate(u32 nodeID) const
 		// Leaf nodes has no children and its height is zero.
 		B3_ASSERT(child1 == B3_NULL_NODE_D);
 		B3_ASSERT(child2 == B3_NULL_NODE_D);
-		B3_ASSERT(node->height == 0);
+		B3_ASSERT(m_nodeInfos[nodeID].height == 0);
 	}
 	else 
 	{
@@ -354,8 +736,11 @@ void b3DynamicTree::Validate(u32 nodeID) const
 
 		// The parent of its children is its parent (really?!).
 
-		B3_ASSERT(m_nodes[child1].parent == nodeID);
-		B3_ASSERT(m_nodes[child2].parent == nodeID);
+		B3_ASSERT(m_nodeInfos[child1].parent == nodeID);
+		B3_ASSERT(m_nodeInfos[child2].parent == nodeID);
+
+		// The height of an internal node is one plus the height of its higher child.
+		B3_ASSERT(m_nodeInfos[nodeID].height == 1 + b3Max(m_nodeInfos[child1].height, m_nodeInfos[child2].height));
 
 		// Walk down the tree.
 		Validate(child1);
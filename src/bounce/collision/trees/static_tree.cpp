@@ -17,18 +17,73 @@
 */
 
 #include <bounce/collision/trees/static_tree.h>
+#include <bounce/collision/trees/tree_bins.h>
 #include <bounce/common/template/stack.h>
 #include <bounce/common/draw.h>
+#include <bounce/common/time.h>
+#include <bounce/common/job_system.h>
+
+// The relative costs of visiting a node and testing an AABB in a leaf 
+// used by the surface area heuristic.
+#define B3_SAH_TRAVERSAL_COST (1.0f)
+#define B3_SAH_INTERSECTION_COST (1.0f)
+
+// Get the AABBs of a set.
+struct b3SetAABBs
+{
+	const b3AABB3& GetAABB(u32 id) const
+	{
+		return set[id];
+	}
+
+	const b3AABB3* set;
+};
+
+// The minimum number of AABBs in a subtree built by a task.
+#define B3_TREE_MIN_TASK_SIZE 4096
 
 b3StaticTree::b3StaticTree()
 {
 	m_nodes = NULL;
 	m_nodeCount = 0;
+	m_proxies = NULL;
+	m_proxyCount = 0;
+	m_wideNodes = NULL;
+	m_wideNodeCount = 0;
+	m_quantizedNodes = NULL;
+	m_quantizedAABB.m_lower.SetZero();
+	m_quantizedAABB.m_upper.SetZero();
+	m_quantizationScale.SetZero();
+	m_buildTime = 0.0;
+	m_ownsMemory = true;
 }
 
 b3StaticTree::~b3StaticTree()
 {
-	b3Free(m_nodes);
+	Free();
+}
+
+void b3StaticTree::Free()
+{
+	if (m_ownsMemory)
+	{
+		b3Free(m_nodes);
+		b3Free(m_proxies);
+		b3FreeAligned(m_wideNodes);
+		b3Free(m_quantizedNodes);
+	}
+
+	m_nodes = NULL;
+	m_nodeCount = 0;
+	m_proxies = NULL;
+	m_proxyCount = 0;
+	m_wideNodes = NULL;
+	m_wideNodeCount = 0;
+	m_quantizedNodes = NULL;
+	m_quantizedAABB.m_lower.SetZero();
+	m_quantizedAABB.m_upper.SetZero();
+	m_quantizationScale.SetZero();
+	m_ownsMemory = true;
 }
 
 static B3_FORCE_INLINE bool b3SortPredicate(const b3AABB3* set, u32 axis, u32 a, u32 b)
@@ -104,7 +159,7 @@ static u32 b3Partition(const b3AABB3& setAABB, const b3AABB3* set, u32* ids, u32
 	return middle;
 }
 
-void b3StaticTree::Build(const b3AABB3* set, b3Node* node, u32* ids, u32 count, u32 minObjectsPerLeaf, u32 nodeCapacity, u32& leafCount, u32& internalCount)
+void b3StaticTree::BuildMedian(const b3AABB3* set, b3Node* node, u32* ids, u32 count, u32 maxLeafSize, u32 nodeCapacity, u32 depth)
 {
 	B3_ASSERT(count > 0);
 	
@@ -117,18 +172,18 @@ void b3StaticTree::Build(const b3AABB3* set, b3Node* node, u32* ids, u32 count,
 
 	node->aabb = setAABB;
 
-	if (count <= minObjectsPerLeaf)
+	if (count <= maxLeafSize)
 	{
-		++leafCount;
 		node->child1 = B3_NULL_NODE_S;
-		node->index = ids[0];
+		node->index = u32(ids - m_proxies);
+		node->count = count;
 	}
 	else
 	{
-		++internalCount;
-
-		// Partition current set
-		u32 middle = b3Partition(setAABB, set, ids, count);
+		// Partition current set.
+		// Split the nodes deeper than half of the maximum height in the middle 
+		// so that the tree height stays bounded.
+		u32 middle = depth < B3_MAX_TREE_HEIGHT / 2 ? b3Partition(setAABB, set, ids, count) : count / 2;
 
 		// Allocate left subtree
 		B3_ASSERT(m_nodeCount < nodeCapacity);
@@ -140,43 +195,733 @@ void b3StaticTree::Build(const b3AABB3* set, b3Node* node, u32* ids, u32 count,
 		node->child2 = m_nodeCount;
 		++m_nodeCount;
 
+		node->count = 0;
+
 		// Build left and right subtrees
-		Build(set, m_nodes + node->child1, ids, middle, minObjectsPerLeaf, nodeCapacity, leafCount, internalCount);
-		Build(set, m_nodes + node->child2, ids + middle, count - middle, minObjectsPerLeaf, nodeCapacity, leafCount, internalCount);
+		BuildMedian(set, m_nodes + node->child1, ids, middle, maxLeafSize, nodeCapacity, depth + 1);
+		BuildMedian(set, m_nodes + node->child2, ids + middle, count - middle, maxLeafSize, nodeCapacity, depth + 1);
+	}
+}
+
+void b3StaticTree::BuildSAH(const b3AABB3* set, u32 nodeIndex, u32* ids, u32 count, u32 maxLeafSize, 
+	u32& nodeCount, u32 nodeCapacity, u32 depth, u32 taskSize, b3Array<b3SubtreeTask>* tasks)
+{
+	B3_ASSERT(count > 0);
+
+	if (tasks && count <= taskSize)
+	{
+		// Defer the subtree to a task.
+		b3SubtreeTask task;
+		task.node = nodeIndex;
+		task.proxyIndex = u32(ids - m_proxies);
+		task.proxyCount = count;
+		task.nodeBase = 0;
+		task.nodeCount = 0;
+		task.depth = depth;
+		tasks->PushBack(task);
+		return;
+	}
+
+	b3SetAABBs aabbs;
+	aabbs.set = set;
+
+	// Compute the bounds of the AABBs and their centroids.
+	b3AABB3 aabb, centroidAABB;
+	b3ComputeTreeBounds(aabb, centroidAABB, aabbs, ids, count);
+
+	m_nodes[nodeIndex].aabb = aabb;
+
+	if (count == 1)
+	{
+		m_nodes[nodeIndex].child1 = B3_NULL_NODE_S;
+		m_nodes[nodeIndex].index = u32(ids - m_proxies);
+		m_nodes[nodeIndex].count = 1;
+		return;
+	}
+
+	b3TreeSplit split = b3FindTreeSplit(aabbs, ids, count, centroidAABB, depth);
+
+	if (count <= maxLeafSize)
+	{
+		// Make a leaf if testing all AABBs is cheaper than visiting two children.
+		// cost(leaf) = Ci * count * area
+		// cost(split) = Ct * area + Ci * (count1 * area1 + count2 * area2)
+		float32 area = aabb.SurfaceArea();
+		float32 leafCost = B3_SAH_INTERSECTION_COST * float32(count) * area;
+		float32 splitCost = B3_SAH_TRAVERSAL_COST * area + B3_SAH_INTERSECTION_COST * split.cost;
+		if (split.bin == B3_TREE_BIN_COUNT || leafCost <= splitCost)
+		{
+			m_nodes[nodeIndex].child1 = B3_NULL_NODE_S;
+			m_nodes[nodeIndex].index = u32(ids - m_proxies);
+			m_nodes[nodeIndex].count = count;
+			return;
+		}
+	}
+
+	// Partition the AABBs.
+	u32 middle = b3PartitionTreeSplit(aabbs, ids, count, centroidAABB, split);
+
+	// Allocate the children next to each other.
+	B3_ASSERT(nodeCount + 2 <= nodeCapacity);
+	u32 child1 = nodeCount;
+	u32 child2 = nodeCount + 1;
+	nodeCount += 2;
+
+	m_nodes[nodeIndex].child1 = child1;
+	m_nodes[nodeIndex].child2 = child2;
+	m_nodes[nodeIndex].count = 0;
+
+	// Build the subtrees.
+	BuildSAH(set, child1, ids, middle, maxLeafSize, nodeCount, nodeCapacity, depth + 1, taskSize, tasks);
+	BuildSAH(set, child2, ids + middle, count - middle, maxLeafSize, nodeCount, nodeCapacity, depth + 1, taskSize, tasks);
+}
+
+struct b3SubtreeContext
+{
+	b3StaticTree* tree;
+	const b3AABB3* set;
+	u32 maxLeafSize;
+	void* tasks;
+};
+
+void b3StaticTree::BuildSubtrees(void* context, u32 begin, u32 end, u32 threadIndex)
+{
+	B3_NOT_USED(threadIndex);
+
+	b3SubtreeContext* subtreeContext = (b3SubtreeContext*)context;
+	b3StaticTree* tree = subtreeContext->tree;
+	b3SubtreeTask* tasks = (b3SubtreeTask*)subtreeContext->tasks;
+
+	for (u32 i = begin; i < end; ++i)
+	{
+		b3SubtreeTask* task = tasks + i;
+		
+		// A subtree of n AABBs has at most 2 * n - 2 nodes below its root.
+		u32 nodeCount = task->nodeBase;
+		u32 nodeCapacity = task->nodeBase + 2 * task->proxyCount - 2;
+
+		tree->BuildSAH(subtreeContext->set, task->node, tree->m_proxies + task->proxyIndex, task->proxyCount, 
+			subtreeContext->maxLeafSize, nodeCount, nodeCapacity, task->depth, 0, NULL);
+
+		task->nodeCount = nodeCount - task->nodeBase;
 	}
 }
 
 void b3StaticTree::Build(const b3AABB3* set, u32 count)
+{
+	b3StaticTreeDef def;
+	Build(set, count, def);
+}
+
+void b3StaticTree::Build(const b3AABB3* set, u32 count, const b3StaticTreeDef& def)
 {
 	B3_ASSERT(count > 0);
+	B3_ASSERT(def.maxLeafSize > 0);
+
+	b3Time time;
+
+	// Free the old trees.
+	Free();
 
-	u32* ids = (u32*)b3Alloc(count * sizeof(u32));
+	// The proxies are sorted in place by the builders.
+	m_proxyCount = count;
+	m_proxies = (u32*)b3Alloc(m_proxyCount * sizeof(u32));
 	for (u32 i = 0; i < count; ++i)
 	{
-		ids[i] = i;
+		m_proxies[i] = i;
 	}
 
 	// Leafs = n, Internals = n - 1, Total = 2n - 1, if we assume
 	// each leaf node contains exactly 1 object.
-	const u32 kMinObjectsPerLeaf = 1;
-
-	u32 internalCapacity = count - 1;
-	u32 leafCapacity = count;
 	u32 nodeCapacity = 2 * count - 1;
 
-	u32 internalCount = 0;
-	u32 leafCount = 0;
-
 	m_nodes = (b3Node*)b3Alloc(nodeCapacity * sizeof(b3Node));
 	m_nodeCount = 1;
 
-	Build(set, m_nodes, ids, count, kMinObjectsPerLeaf, nodeCapacity, leafCount, internalCount);
+	u32 threadCount = def.jobSystem ? def.jobSystem->GetThreadCount() : 1;
 
-	b3Free(ids);
+	if (def.builder == e_sahBuilder && threadCount > 1 && count >= 2 * B3_TREE_MIN_TASK_SIZE)
+	{
+		// Build the top levels until the subtrees are small enough 
+		// to give a few tasks to each thread.
+		u32 taskSize = b3Max(count / (4 * threadCount), u32(B3_TREE_MIN_TASK_SIZE));
 
-	B3_ASSERT(leafCount == leafCapacity);
-	B3_ASSERT(internalCount == internalCapacity);
-	B3_ASSERT(m_nodeCount == nodeCapacity);
+		b3StackArray<b3SubtreeTask, 256> tasks;
+		BuildSAH(set, 0, m_proxies, count, def.maxLeafSize, m_nodeCount, nodeCapacity, 0, taskSize, &tasks);
+
+		// Reserve the largest possible range of nodes for each subtree.
+		u32 nodeBase = m_nodeCount;
+		for (u32 i = 0; i < tasks.Count(); ++i)
+		{
+			tasks[i].nodeBase = nodeBase;
+			nodeBase += 2 * tasks[i].proxyCount - 2;
+		}
+		B3_ASSERT(nodeBase <= nodeCapacity);
+
+		b3SubtreeContext context;
+		context.tree = this;
+		context.set = set;
+		context.maxLeafSize = def.maxLeafSize;
+		context.tasks = tasks.Begin();
+
+		def.jobSystem->ParallelFor(BuildSubtrees, &context, tasks.Count(), 1);
+
+		// Stitch the subtrees by removing the unused nodes between them.
+		for (u32 i = 0; i < tasks.Count(); ++i)
+		{
+			const b3SubtreeTask* task = tasks.Get(i);
+			
+			u32 shift = task->nodeBase - m_nodeCount;
+			if (shift > 0)
+			{
+				memmove(m_nodes + m_nodeCount, m_nodes + task->nodeBase, task->nodeCount * sizeof(b3Node));
+
+				for (u32 j = 0; j < task->nodeCount; ++j)
+				{
+					b3Node* node = m_nodes + m_nodeCount + j;
+					if (node->IsLeaf() == false)
+					{
+						node->child1 -= shift;
+						node->child2 -= shift;
+					}
+				}
+
+				b3Node* root = m_nodes + task->node;
+				if (root->IsLeaf() == false)
+				{
+					root->child1 -= shift;
+					root->child2 -= shift;
+				}
+			}
+
+			m_nodeCount += task->nodeCount;
+		}
+	}
+	else if (def.builder == e_sahBuilder)
+	{
+		BuildSAH(set, 0, m_proxies, count, def.maxLeafSize, m_nodeCount, nodeCapacity, 0, 0, NULL);
+	}
+	else
+	{
+		BuildMedian(set, m_nodes, m_proxies, count, def.maxLeafSize, nodeCapacity, 0);
+	}
+
+	B3_ASSERT(m_nodeCount <= nodeCapacity);
+
+	time.Update();
+	m_buildTime = time.GetCurrentMilis();
+}
+
+float32 b3StaticTree::GetTraversalCost() const
+{
+	if (m_nodeCount == 0)
+	{
+		return 0.0f;
+	}
+
+	if (m_quantizedNodes)
+	{
+		float32 rootArea = GetQuantizedAABB(m_quantizedNodes).SurfaceArea();
+		if (rootArea == 0.0f)
+		{
+			return 0.0f;
+		}
+
+		float32 cost = 0.0f;
+		for (u32 i = 0; i < m_nodeCount; ++i)
+		{
+			const b3QuantizedNode* node = m_quantizedNodes + i;
+			float32 area = GetQuantizedAABB(node).SurfaceArea();
+
+			if (node->IsLeaf())
+			{
+				cost += B3_SAH_INTERSECTION_COST * float32(node->GetCount()) * area;
+			}
+			else
+			{
+				cost += B3_SAH_TRAVERSAL_COST * area;
+			}
+		}
+
+		return cost / rootArea;
+	}
+
+	float32 rootArea = m_nodes[0].aabb.SurfaceArea();
+	if (rootArea == 0.0f)
+	{
+		return 0.0f;
+	}
+
+	// A node is visited with a probability equal to the ratio of 
+	// its surface area to the root surface area.
+	float32 cost = 0.0f;
+	for (u32 i = 0; i < m_nodeCount; ++i)
+	{
+		const b3Node* node = m_nodes + i;
+		float32 area = node->aabb.SurfaceArea();
+
+		if (node->IsLeaf())
+		{
+			cost += B3_SAH_INTERSECTION_COST * float32(node->count) * area;
+		}
+		else
+		{
+			cost += B3_SAH_TRAVERSAL_COST * area;
+		}
+	}
+
+	return cost / rootArea;
+}
+
+void b3StaticTree::BuildWide()
+{
+	B3_ASSERT(m_nodeCount > 0);
+	
+	// A loaded tree can't be modified.
+	B3_ASSERT(m_ownsMemory);
+
+	// The 4-ary tree references the binary leaves.
+	B3_ASSERT(m_quantizedNodes == NULL);
+
+	b3FreeAligned(m_wideNodes);
+
+	// Each wide node collapses at least one internal binary node.
+	u32 internalCount = 0;
+	for (u32 i = 0; i < m_nodeCount; ++i)
+	{
+		if (m_nodes[i].IsLeaf() == false)
+		{
+			++internalCount;
+		}
+	}
+
+	u32 wideCapacity = b3Max(internalCount, 1u);
+	m_wideNodes = (b3WideNode*)b3AllocAligned(wideCapacity * sizeof(b3WideNode), B3_CACHE_LINE_SIZE);
+	m_wideNodeCount = 0;
+
+	u32 root = BuildWide(0);
+	B3_ASSERT(root == 0);
+	B3_ASSERT(m_wideNodeCount <= wideCapacity);
+	B3_NOT_USED(root);
+}
+
+u32 b3StaticTree::BuildWide(u32 node)
+{
+	u32 wideIndex = m_wideNodeCount;
+	++m_wideNodeCount;
+
+	// Gather up to four children by repeatedly opening 
+	// the internal child with the largest surface area.
+	u32 children[4];
+	u32 childCount = 0;
+
+	if (m_nodes[node].IsLeaf())
+	{
+		children[childCount++] = node;
+	}
+	else
+	{
+		children[childCount++] = m_nodes[node].child1;
+		children[childCount++] = m_nodes[node].child2;
+	}
+
+	while (childCount < 4)
+	{
+		u32 bestIndex = B3_NULL_NODE_S;
+		float32 bestArea = -1.0f;
+		for (u32 i = 0; i < childCount; ++i)
+		{
+			const b3Node* child = m_nodes + children[i];
+			if (child->IsLeaf())
+			{
+				continue;
+			}
+
+			float32 area = child->aabb.SurfaceArea();
+			if (area > bestArea)
+			{
+				bestIndex = i;
+				bestArea = area;
+			}
+		}
+
+		if (bestIndex == B3_NULL_NODE_S)
+		{
+			// All children are leaves.
+			break;
+		}
+
+		const b3Node* best = m_nodes + children[bestIndex];
+		children[bestIndex] = best->child1;
+		children[childCount++] = best->child2;
+	}
+
+	for (u32 i = 0; i < 4; ++i)
+	{
+		b3WideNode* wideNode = m_wideNodes + wideIndex;
+		
+		if (i >= childCount)
+		{
+			// Empty slots have an empty AABB.
+			wideNode->lowerX[i] = B3_MAX_FLOAT;
+			wideNode->lowerY[i] = B3_MAX_FLOAT;
+			wideNode->lowerZ[i] = B3_MAX_FLOAT;
+			wideNode->upperX[i] = -B3_MAX_FLOAT;
+			wideNode->upperY[i] = -B3_MAX_FLOAT;
+			wideNode->upperZ[i] = -B3_MAX_FLOAT;
+			wideNode->children[i] = B3_NULL_NODE_S;
+			continue;
+		}
+
+		const b3Node* child = m_nodes + children[i];
+		
+		wideNode->lowerX[i] = child->aabb.m_lower.x;
+		wideNode->lowerY[i] = child->aabb.m_lower.y;
+		wideNode->lowerZ[i] = child->aabb.m_lower.z;
+		wideNode->upperX[i] = child->aabb.m_upper.x;
+		wideNode->upperY[i] = child->aabb.m_upper.y;
+		wideNode->upperZ[i] = child->aabb.m_upper.z;
+
+		if (child->IsLeaf())
+		{
+			wideNode->children[i] = children[i] | B3_WIDE_LEAF_BIT;
+		}
+		else
+		{
+			wideNode->children[i] = BuildWide(children[i]);
+		}
+	}
+
+	return wideIndex;
+}
+
+bool b3StaticTree::Quantize()
+{
+	B3_ASSERT(m_nodeCount > 0);
+	B3_ASSERT(m_ownsMemory);
+	B3_ASSERT(m_wideNodes == NULL);
+	B3_ASSERT(m_quantizedNodes == NULL);
+
+	// The leaf data must fit the first proxy in 25 bits.
+	if (m_proxyCount > (1 << 25))
+	{
+		return false;
+	}
+
+	// The leaf data must fit the number of proxies in 6 bits.
+	for (u32 i = 0; i < m_nodeCount; ++i)
+	{
+		const b3Node* node = m_nodes + i;
+		if (node->IsLeaf() && (node->count == 0 || node->count > B3_QUANTIZED_MAX_LEAF_SIZE))
+		{
+			return false;
+		}
+	}
+
+	m_quantizedAABB = m_nodes[0].aabb;
+	
+	b3Vec3 extents = m_quantizedAABB.m_upper - m_quantizedAABB.m_lower;
+	for (u32 i = 0; i < 3; ++i)
+	{
+		m_quantizationScale[i] = extents[i] > 0.0f ? 65535.0f / extents[i] : 0.0f;
+	}
+
+	m_quantizedNodes = (b3QuantizedNode*)b3Alloc(m_nodeCount * sizeof(b3QuantizedNode));
+	
+	u32 quantizedCount = 0;
+	Quantize(0, quantizedCount);
+	B3_ASSERT(quantizedCount == m_nodeCount);
+
+	// The regular nodes aren't needed anymore.
+	b3Free(m_nodes);
+	m_nodes = NULL;
+
+	return true;
+}
+
+void b3StaticTree::Quantize(u32 nodeIndex, u32& quantizedCount)
+{
+	const b3Node* node = m_nodes + nodeIndex;
+	
+	u32 quantizedIndex = quantizedCount;
+	++quantizedCount;
+
+	b3QuantizedNode* quantizedNode = m_quantizedNodes + quantizedIndex;
+	QuantizeLower(quantizedNode->lower, node->aabb.m_lower);
+	QuantizeUpper(quantizedNode->upper, node->aabb.m_upper);
+
+	// Grow the AABB by one step to absorb the rounding errors of 
+	// quantizing the query AABBs and of decoding the node AABBs.
+	for (u32 i = 0; i < 3; ++i)
+	{
+		if (quantizedNode->lower[i] > 0)
+		{
+			--quantizedNode->lower[i];
+		}
+
+		if (quantizedNode->upper[i] < 65535)
+		{
+			++quantizedNode->upper[i];
+		}
+	}
+
+	if (node->IsLeaf())
+	{
+		quantizedNode->data = B3_QUANTIZED_LEAF_BIT | (node->index << 6) | (node->count - 1);
+	}
+	else
+	{
+		Quantize(node->child1, quantizedCount);
+		
+		// The second child follows the first subtree.
+		quantizedNode->data = quantizedCount;
+		
+		Quantize(node->child2, quantizedCount);
+	}
+}
+
+u32 b3StaticTree::GetCookedSize() const
+{
+	u32 nodeSize = m_quantizedNodes ? sizeof(b3QuantizedNode) : sizeof(b3Node);
+
+	u32 size = b3AlignCooked(sizeof(b3CookedTreeHeader));
+	size += b3AlignCooked(m_nodeCount * nodeSize);
+	size += b3AlignCooked(m_proxyCount * sizeof(u32));
+	size += m_wideNodeCount * sizeof(b3WideNode);
+	return size;
+}
+
+void b3StaticTree::Cook(void* buffer) const
+{
+	B3_ASSERT(((size_t)buffer & (B3_COOKED_TREE_ALIGNMENT - 1)) == 0);
+
+	u8* bytes = (u8*)buffer;
+
+	u32 nodeSize = m_quantizedNodes ? sizeof(b3QuantizedNode) : sizeof(b3Node);
+	const void* nodes = m_quantizedNodes ? (const void*)m_quantizedNodes : (const void*)m_nodes;
+
+	b3CookedTreeHeader header;
+	header.magic = B3_COOKED_TREE_MAGIC;
+	header.version = B3_COOKED_TREE_VERSION;
+	header.size = GetCookedSize();
+	header.nodeCount = m_nodeCount;
+	header.nodeOffset = b3AlignCooked(sizeof(b3CookedTreeHeader));
+	header.proxyCount = m_proxyCount;
+	header.proxyOffset = header.nodeOffset + b3AlignCooked(m_nodeCount * nodeSize);
+	header.wideNodeCount = m_wideNodeCount;
+	header.wideNodeOffset = header.proxyOffset + b3AlignCooked(m_proxyCount * sizeof(u32));
+	header.quantized = m_quantizedNodes ? 1 : 0;
+	header.quantizedAABB = m_quantizedAABB;
+	header.quantizationScale = m_quantizationScale;
+
+	// Zero the padding so the same tree always gives the same bytes.
+	memset(bytes, 0, header.size);
+	memcpy(bytes, &header, sizeof(b3CookedTreeHeader));
+	memcpy(bytes + header.nodeOffset, nodes, m_nodeCount * nodeSize);
+	memcpy(bytes + header.proxyOffset, m_proxies, m_proxyCount * sizeof(u32));
+	memcpy(bytes + header.wideNodeOffset, m_wideNodes, m_wideNodeCount * sizeof(b3WideNode));
+}
+
+// Reach a child of a reached node in a forward pass over the nodes of a cooked tree.
+// The depths are stored plus one so that zero marks a node that isn't reached.
+// Return false if the child is reached twice or is deeper than B3_MAX_TREE_HEIGHT.
+static bool b3ReachCookedNode(u8* depths, u32 parent, u32 child)
+{
+	B3_ASSERT(depths[parent] != 0);
+	if (depths[child] != 0 || depths[parent] > B3_MAX_TREE_HEIGHT)
+	{
+		return false;
+	}
+
+	depths[child] = u8(depths[parent] + 1);
+	return true;
+}
+
+bool b3StaticTree::IsCookedValid(const void* buffer, u32 size, u32 proxyBound)
+{
+	if (((size_t)buffer & (B3_COOKED_TREE_ALIGNMENT - 1)) != 0)
+	{
+		return false;
+	}
+
+	if (size < sizeof(b3CookedTreeHeader))
+	{
+		return false;
+	}
+
+	const u8* bytes = (const u8*)buffer;
+	const b3CookedTreeHeader* header = (const b3CookedTreeHeader*)bytes;
+
+	if (header->magic != B3_COOKED_TREE_MAGIC || header->version != B3_COOKED_TREE_VERSION)
+	{
+		return false;
+	}
+
+	if (header->size > size || header->nodeCount == 0 || header->proxyCount == 0)
+	{
+		return false;
+	}
+
+	// A quantized tree has no 4-ary tree.
+	if (header->quantized > 1 || (header->quantized && header->wideNodeCount > 0))
+	{
+		return false;
+	}
+
+	u32 nodeSize = header->quantized ? sizeof(b3QuantizedNode) : sizeof(b3Node);
+
+	// Check the arrays are inside the buffer.
+	if (u64(header->nodeOffset) + u64(header->nodeCount) * nodeSize > header->size ||
+		u64(header->proxyOffset) + u64(header->proxyCount) * sizeof(u32) > header->size ||
+		u64(header->wideNodeOffset) + u64(header->wideNodeCount) * sizeof(b3WideNode) > header->size)
+	{
+		return false;
+	}
+
+	// Check the arrays are aligned.
+	if ((header->nodeOffset & 3) != 0 || (header->proxyOffset & 3) != 0 || 
+		(header->wideNodeOffset & (B3_COOKED_TREE_ALIGNMENT - 1)) != 0)
+	{
+		return false;
+	}
+
+	u32 nodeCount = header->nodeCount;
+	u32 proxyCount = header->proxyCount;
+
+	const u32* proxies = (const u32*)(bytes + header->proxyOffset);
+	for (u32 i = 0; i < proxyCount; ++i)
+	{
+		if (proxies[i] >= proxyBound)
+		{
+			return false;
+		}
+	}
+
+	// The children of a node always come after the node, 
+	// so the nodes can't form a cycle and a forward pass reaches every child 
+	// after its parent. 
+	// A walk of the tree must fit in a b3TreeStack, so the tree can't be deeper 
+	// than B3_MAX_TREE_HEIGHT and a node can't have two parents.
+	u32 depthCount = b3Max(nodeCount, header->wideNodeCount);
+	u8* depths = (u8*)b3Alloc(depthCount * sizeof(u8));
+	memset(depths, 0, nodeCount * sizeof(u8));
+	depths[0] = 1;
+
+	bool valid = true;
+
+	if (header->quantized)
+	{
+		const b3QuantizedNode* nodes = (const b3QuantizedNode*)(bytes + header->nodeOffset);
+		for (u32 i = 0; valid && i < nodeCount; ++i)
+		{
+			const b3QuantizedNode* node = nodes + i;
+			if (node->IsLeaf())
+			{
+				valid = u64(node->GetIndex()) + node->GetCount() <= proxyCount;
+			}
+			else
+			{
+				valid = i + 1 < nodeCount && node->data > i + 1 && node->data < nodeCount;
+				if (valid && depths[i] != 0)
+				{
+					valid = b3ReachCookedNode(depths, i, i + 1) && b3ReachCookedNode(depths, i, node->data);
+				}
+			}
+		}
+	}
+	else
+	{
+		const b3Node* nodes = (const b3Node*)(bytes + header->nodeOffset);
+		for (u32 i = 0; valid && i < nodeCount; ++i)
+		{
+			const b3Node* node = nodes + i;
+			if (node->IsLeaf())
+			{
+				valid = u64(node->index) + node->count <= proxyCount;
+			}
+			else
+			{
+				valid = node->child1 > i && node->child1 < nodeCount && node->child2 > i && node->child2 < nodeCount;
+				if (valid && depths[i] != 0)
+				{
+					valid = b3ReachCookedNode(depths, i, node->child1) && b3ReachCookedNode(depths, i, node->child2);
+				}
+			}
+		}
+
+		if (valid && header->wideNodeCount > 0)
+		{
+			memset(depths, 0, header->wideNodeCount * sizeof(u8));
+			depths[0] = 1;
+		}
+
+		const b3WideNode* wideNodes = (const b3WideNode*)(bytes + header->wideNodeOffset);
+		for (u32 i = 0; valid && i < header->wideNodeCount; ++i)
+		{
+			const b3WideNode* node = wideNodes + i;
+			for (u32 j = 0; valid && j < 4; ++j)
+			{
+				u32 child = node->children[j];
+				if (child == B3_NULL_NODE_S)
+				{
+					continue;
+				}
+
+				if (child & B3_WIDE_LEAF_BIT)
+				{
+					// The child must be a leaf of the binary tree.
+					u32 leaf = child & ~B3_WIDE_LEAF_BIT;
+					valid = leaf < nodeCount && nodes[leaf].IsLeaf();
+				}
+				else
+				{
+					valid = child > i && child < header->wideNodeCount;
+					if (valid && depths[i] != 0)
+					{
+						valid = b3ReachCookedNode(depths, i, child);
+					}
+				}
+			}
+		}
+	}
+
+	b3Free(depths);
+
+	return valid;
+}
+
+bool b3StaticTree::Load(const void* buffer, u32 size)
+{
+	// Validate the buffer before changing this tree.
+	if (IsCookedValid(buffer, size, B3_MAX_U32) == false)
+	{
+		return false;
+	}
+
+	Free();
+
+	const u8* bytes = (const u8*)buffer;
+	const b3CookedTreeHeader* header = (const b3CookedTreeHeader*)bytes;
+
+	m_ownsMemory = false;
+	m_nodeCount = header->nodeCount;
+	if (header->quantized)
+	{
+		m_quantizedNodes = (b3QuantizedNode*)(bytes + header->nodeOffset);
+		m_quantizedAABB = header->quantizedAABB;
+		m_quantizationScale = header->quantizationScale;
+	}
+	else
+	{
+		m_nodes = (b3Node*)(bytes + header->nodeOffset);
+	}
+	m_proxyCount = header->proxyCount;
+	m_proxies = (u32*)(bytes + header->proxyOffset);
+	m_wideNodeCount = header->wideNodeCount;
+	m_wideNodes = header->wideNodeCount > 0 ? (b3WideNode*)(bytes + header->wideNodeOffset) : NULL;
+	m_buildTime = 0.0;
+
+	return true;
 }
 
 void b3StaticTree::Draw() const
@@ -186,6 +931,18 @@ void b3StaticTree::Draw() const
 		return;
 	}
 
+	if (m_quantizedNodes)
+	{
+		for (u32 i = 0; i < m_nodeCount; ++i)
+		{
+			const b3QuantizedNode* node = m_quantizedNodes + i;
+			
+			b3Color color = node->IsLeaf() ? b3Color_pink : b3Color_red;
+			b3Draw_draw->DrawAABB(GetQuantizedAABB(node), color);
+		}
+		return;
+	}
+
 	u32 root = 0;
 
 	b3Stack<u32, 256> stack;
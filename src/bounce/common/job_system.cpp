@@ -0,0 +1,157 @@
+/*
+* Copyright (c) 2016-2016 Irlan Robson http://www.irlan.net
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <bounce/common/job_system.h>
+#include <bounce/common/math/math.h>
+
+b3ThreadPool::b3ThreadPool(u32 threadCount)
+{
+	if (threadCount == 0)
+	{
+		threadCount = b3Max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	m_threadCount = threadCount;
+	m_generation = 0;
+	m_busyCount = 0;
+	m_quit = false;
+	
+	m_task = NULL;
+	m_context = NULL;
+	m_count = 0;
+	m_rangeSize = 0;
+	m_rangeCount = 0;
+	m_nextRange = 0;
+	m_doneRangeCount = 0;
+
+	// The calling thread is thread 0.
+	u32 workerCount = m_threadCount - 1;
+	m_workers = (std::thread*)b3Alloc(b3Max(workerCount, 1u) * sizeof(std::thread));
+	for (u32 i = 0; i < workerCount; ++i)
+	{
+		new (m_workers + i) std::thread(&b3ThreadPool::Work, this, i + 1);
+	}
+}
+
+b3ThreadPool::~b3ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_wakeCondition.notify_all();
+
+	u32 workerCount = m_threadCount - 1;
+	for (u32 i = 0; i < workerCount; ++i)
+	{
+		m_workers[i].join();
+		m_workers[i].~thread();
+	}
+	b3Free(m_workers);
+}
+
+void b3ThreadPool::Work(u32 threadIndex)
+{
+	u32 generation = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeCondition.wait(lock, [&] { return m_quit || m_generation != generation; });
+			
+			if (m_quit)
+			{
+				return;
+			}
+
+			// Join the current loop.
+			generation = m_generation;
+			++m_busyCount;
+		}
+
+		RunTasks(threadIndex);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			--m_busyCount;
+		}
+		m_doneCondition.notify_all();
+	}
+}
+
+void b3ThreadPool::RunTasks(u32 threadIndex)
+{
+	for (;;)
+	{
+		u32 range = m_nextRange.fetch_add(1);
+		if (range >= m_rangeCount)
+		{
+			return;
+		}
+
+		u32 begin = range * m_rangeSize;
+		u32 end = b3Min(begin + m_rangeSize, m_count);
+		
+		m_task(m_context, begin, end, threadIndex);
+		
+		m_doneRangeCount.fetch_add(1);
+	}
+}
+
+void b3ThreadPool::ParallelFor(b3TaskFunction task, void* context, u32 count, u32 minRange)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	minRange = b3Max(minRange, 1u);
+
+	if (m_threadCount == 1 || count <= minRange)
+	{
+		// Not worth waking up the workers.
+		task(context, 0, count, 0);
+		return;
+	}
+
+	// Split the loop into a few ranges per thread for load balancing.
+	u32 rangeSize = b3Max(minRange, (count + 4 * m_threadCount - 1) / (4 * m_threadCount));
+	
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		
+		// Wait for the workers that are still leaving the last loop.
+		m_doneCondition.wait(lock, [&] { return m_busyCount == 0; });
+
+		m_task = task;
+		m_context = context;
+		m_count = count;
+		m_rangeSize = rangeSize;
+		m_rangeCount = (count + rangeSize - 1) / rangeSize;
+		m_nextRange = 0;
+		m_doneRangeCount = 0;
+		++m_generation;
+	}
+	m_wakeCondition.notify_all();
+
+	RunTasks(0);
+
+	// Wait for the tasks executed by the workers.
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [&] { return m_doneRangeCount == m_rangeCount; });
+}
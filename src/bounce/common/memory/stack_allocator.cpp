@@ -50,22 +50,38 @@ void* b3StackAllocator::Allocate(u32 size)
 	if (m_allocatedSize + size > b3_maxStackSize) 
 	{
 		// Allocate with parent allocator.
-		block->data = (u8*) b3Alloc(size);
+		block->memory = (u8*) b3Alloc(size);
 		block->parent = true;
 	}
 	else 
 	{
 		// Use this stack memory.
-		block->data = m_memory + m_allocatedSize;
+		block->memory = m_memory + m_allocatedSize;
 		block->parent = false;
 		m_allocatedSize += size;
 	}
 	
+	block->data = block->memory;
+
 	++m_blockCount;
 
 	return block->data;
 }
 
+void* b3StackAllocator::AllocateAligned(u32 size, u32 alignment)
+{
+	B3_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+	// Allocate enough memory to round the address up.
+	u8* memory = (u8*)Allocate(size + alignment - 1);
+	
+	b3Block* block = m_blocks + m_blockCount - 1;
+	size_t address = (size_t)memory;
+	block->data = (u8*)((address + alignment - 1) & ~(size_t)(alignment - 1));
+	
+	return block->data;
+}
+
 void b3StackAllocator::Free(void* p) 
 {
 	B3_ASSERT(m_blockCount > 0);
@@ -73,7 +89,7 @@ void b3StackAllocator::Free(void* p)
 	B3_ASSERT(block->data == p);
 	if (block->parent) 
 	{
-		b3Free(p);
+		b3Free(block->memory);
 	}
 	else 
 	{
@@ -21,16 +21,23 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <atomic>
 
-u32 b3_allocCalls = 0;
-u32 b3_maxAllocCalls = 0;
+// The allocation counters are atomic because memory can be allocated 
+// from the threads of a job system.
+std::atomic<u32> b3_allocCalls(0);
+std::atomic<u32> b3_maxAllocCalls(0);
 
 b3Version b3_version = { 1, 0, 0 };
 
 void* b3Alloc(u32 size) 
 {
-	++b3_allocCalls;
-	b3_maxAllocCalls = b3Max(b3_maxAllocCalls, b3_allocCalls);
+	u32 allocCalls = ++b3_allocCalls;
+	
+	u32 maxAllocCalls = b3_maxAllocCalls.load();
+	while (allocCalls > maxAllocCalls && b3_maxAllocCalls.compare_exchange_weak(maxAllocCalls, allocCalls) == false)
+	{
+	}
 	return malloc(size);
 }
 
@@ -32,6 +32,16 @@ b3Body::b3Body(const b3BodyDef& def, b3World* world)
 	{
 		m_flags |= e_awakeFlag;
 	}
+
+	if (def.bullet)
+	{
+		m_flags |= e_bulletFlag;
+	}
+
+	if (def.speculative)
+	{
+		m_flags |= e_speculativeFlag;
+	}
 	
 	if (m_type == e_dynamicBody) 
 	{
@@ -112,7 +122,7 @@ b3Shape* b3Body::CreateShape(const b3ShapeDef& def)
 	
 	b3AABB3 aabb;
 	shape->ComputeAABB(&aabb, xf);
-	shape->m_broadPhaseID = m_world->m_contactMan.m_broadPhase.CreateProxy(aabb, shape);
+	shape->m_broadPhaseID = m_world->m_contactMan.m_broadPhase.CreateProxy(aabb, shape, m_type == e_staticBody);
 
 	// Tell the world that a new shape was added so new contacts can be created.
 	m_world->m_flags |= b3World::e_shapeAddedFlag;
@@ -120,6 +130,72 @@ b3Shape* b3Body::CreateShape(const b3ShapeDef& def)
 	return shape;
 }
 
+void b3Body::CreateShapes(b3Shape** shapes, const b3ShapeDef* defs, u32 count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	b3Shape** newShapes = (b3Shape**)b3Alloc(count * sizeof(b3Shape*));
+	b3AABB3* aabbs = (b3AABB3*)b3Alloc(count * sizeof(b3AABB3));
+	u32* proxyIds = (u32*)b3Alloc(count * sizeof(u32));
+
+	bool resetMass = false;
+	for (u32 i = 0; i < count; ++i)
+	{
+		const b3ShapeDef& def = defs[i];
+
+		// Create the shape with the definition.
+		b3Shape* shape = b3Shape::Create(def);
+		shape->m_body = this;
+		shape->m_isSensor = def.isSensor;
+		shape->m_userData = def.userData;
+		shape->m_density = def.density;
+		shape->m_friction = def.friction;
+		shape->m_restitution = def.restitution;
+
+		// Add the shape to this body shape list.
+		m_shapeList.PushFront(shape);
+
+		if (shape->m_density > 0.0f)
+		{
+			resetMass = true;
+		}
+
+		// Compute the world AABB of the new shape.
+		shape->ComputeAABB(aabbs + i, m_xf);
+
+		newShapes[i] = shape;
+	}
+
+	// Recompute the mass properties of this body once.
+	if (resetMass)
+	{
+		ResetMass();
+	}
+
+	// Assign the broad-phase proxies.
+	m_world->m_contactMan.m_broadPhase.CreateProxies(proxyIds, aabbs, (void**)newShapes, count, m_type == e_staticBody);
+	
+	for (u32 i = 0; i < count; ++i)
+	{
+		newShapes[i]->m_broadPhaseID = proxyIds[i];
+	}
+
+	if (shapes)
+	{
+		memcpy(shapes, newShapes, count * sizeof(b3Shape*));
+	}
+
+	b3Free(proxyIds);
+	b3Free(aabbs);
+	b3Free(newShapes);
+
+	// Tell the world that new shapes were added so new contacts can be created.
+	m_world->m_flags |= b3World::e_shapeAddedFlag;
+}
+
 void b3Body::DestroyContacts() 
 {
 	for (b3Shape* s = m_shapeList.m_head; s; s = s->m_next)
@@ -178,6 +254,15 @@ void b3Body::SynchronizeTransform()
 	m_xf = m_sweep.GetTransform(1.0f);
 }
 
+void b3Body::Advance(float32 t)
+{
+	// Advance to the new safe time. This doesn't sync the broad-phase.
+	m_sweep.Advance(t);
+	m_sweep.worldCenter = m_sweep.worldCenter0;
+	m_sweep.orientation = m_sweep.orientation0;
+	SynchronizeTransform();
+}
+
 void b3Body::SynchronizeShapes() 
 {
 	b3Transform xf1 = m_sweep.GetTransform(0.0f);
@@ -186,6 +271,13 @@ void b3Body::SynchronizeShapes()
 	
 	b3Vec3 displacement = xf2.position - xf1.position;
 
+	// The speculative contacts must exist before the shapes touch. 
+	// Therefore include the position predicted for the next step.
+	bool speculative = m_world->m_speculative || IsSpeculative();
+	
+	b3Transform xf3 = xf2;
+	xf3.position += m_world->m_dt * m_linearVelocity;
+
 	// Update all shape AABBs.
 	b3BroadPhase* broadPhase = &m_world->m_contactMan.m_broadPhase;
 	for (b3Shape* s = m_shapeList.m_head; s; s = s->m_next)
@@ -197,6 +289,13 @@ void b3Body::SynchronizeShapes()
 		
 		b3AABB3 aabb = b3Combine(aabb1, aabb2);
 
+		if (speculative)
+		{
+			b3AABB3 aabb3;
+			s->ComputeAABB(&aabb3, xf3);
+			aabb = b3Combine(aabb, aabb3);
+		}
+
 		broadPhase->MoveProxy(s->m_broadPhaseID, aabb, displacement);
 	}
 }
@@ -454,10 +553,23 @@ void b3Body::SetType(b3BodyType type)
 	DestroyContacts();
 
 	// Move the shape proxies so new contacts can be created.
+	// Static and non-static proxies are stored in different trees, 
+	// so the proxies must be recreated if the body became or stopped being static.
 	b3BroadPhase* phase = &m_world->m_contactMan.m_broadPhase;
+	bool isStatic = m_type == e_staticBody;
 	for (b3Shape* s = m_shapeList.m_head; s; s = s->m_next)
 	{
-		phase->BufferMove(s->m_broadPhaseID);
+		if (phase->IsStaticProxy(s->m_broadPhaseID) == isStatic)
+		{
+			phase->BufferMove(s->m_broadPhaseID);
+			continue;
+		}
+
+		b3AABB3 aabb;
+		s->ComputeAABB(&aabb, m_xf);
+
+		phase->DestroyProxy(s->m_broadPhaseID);
+		s->m_broadPhaseID = phase->CreateProxy(aabb, s, isStatic);
 	}
 }
 
@@ -474,6 +586,8 @@ void b3Body::Dump() const
 	b3Log("		bd.angularVelocity.Set(%f, %f, %f);\n", m_angularVelocity.x, m_angularVelocity.y, m_angularVelocity.z);
 	b3Log("		bd.gravityScale = %f;\n", m_gravityScale);
 	b3Log("		bd.awake = %d;\n", m_flags & e_awakeFlag);
+	b3Log("		bd.bullet = %d;\n", IsBullet());
+	b3Log("		bd.speculative = %d;\n", IsSpeculative());
 	b3Log("		\n");
 	b3Log("		bodies[%d] = world.CreateBody(bd);\n");
 	b3Log("		\n");
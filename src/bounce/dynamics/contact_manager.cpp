@@ -46,28 +46,10 @@ void b3ContactManager::AddPair(void* dataA, void* dataB)
 	}
 
 	// Check if there is a contact between the two shapes.
-	// Search the list A or B. The shorter if possible.
-	for (b3ContactEdge* ce = shapeB->m_contactEdges.m_head; ce; ce = ce->m_next)
+	if (m_contactHash.Find(shapeA->m_broadPhaseID, shapeB->m_broadPhaseID) != NULL)
 	{
-		if (ce->other == shapeA)
-		{
-			b3Contact* c = ce->contact;
-			
-			b3Shape* sA = c->GetShapeA();
-			b3Shape* sB = c->GetShapeB();
-
-			if (sA == shapeA && sB == shapeB)
-			{
-				// A contact already exists.
-				return;
-			}
-
-			if (sB == shapeA && sA == shapeB)
-			{
-				// A contact already exists.
-				return;
-			}
-		}
+		// A contact already exists.
+		return;
 	}
 
 	// Check if a joint prevents collision between the bodies.
@@ -101,6 +83,8 @@ void b3ContactManager::AddPair(void* dataA, void* dataB)
 	bodyB = shapeB->GetBody();
 
 	c->m_flags = 0;
+	c->m_toi.t = 1.0f;
+	c->m_toi.count = 0;
 	b3OverlappingPair* pair = &c->m_pair;
 
 	// Initialize edge A
@@ -126,6 +110,9 @@ void b3ContactManager::AddPair(void* dataA, void* dataB)
 
 	// Add the contact to the world contact list.
 	m_contactList.PushFront(c);
+
+	// Add the contact to the contact hash table.
+	m_contactHash.Insert(shapeA->m_broadPhaseID, shapeB->m_broadPhaseID, c);
 	
 	if (c->m_type == e_meshContact)
 	{
@@ -293,6 +280,9 @@ void b3ContactManager::Destroy(b3Contact* c)
 	// Remove the contact from the world contact list.
 	m_contactList.Remove(c);
 
+	// Remove the contact from the contact hash table.
+	m_contactHash.Remove(shapeA->m_broadPhaseID, shapeB->m_broadPhaseID);
+
 	if (c->m_type == e_convexContact)
 	{
 		b3ConvexContact* cc = (b3ConvexContact*)c;
@@ -97,77 +97,77 @@ bool b3TestOverlap(const b3Transform& xfA, u32 indexA, const b3Shape* shapeA,
 void b3CollideSphereAndSphereShapes(b3Manifold& manifold, 
 	const b3Transform& xfA, const b3Shape* shapeA,
 	const b3Transform& xfB, const b3Shape* shapeB,
-	b3ConvexCache* cache)
+	b3ConvexCache* cache, float32 margin)
 {
 	B3_NOT_USED(cache);
 	b3SphereShape* hullA = (b3SphereShape*)shapeA;
 	b3SphereShape* hullB = (b3SphereShape*)shapeB;
-	b3CollideSphereAndSphere(manifold, xfA, hullA, xfB, hullB);
+	b3CollideSphereAndSphere(manifold, xfA, hullA, xfB, hullB, margin);
 }
 
 void b3CollideSphereAndHullShapes(b3Manifold& manifold, 
 	const b3Transform& xfA, const b3Shape* shapeA,
 	const b3Transform& xfB, const b3Shape* shapeB,
-	b3ConvexCache* cache)
+	b3ConvexCache* cache, float32 margin)
 {
 	B3_NOT_USED(cache);
 	b3SphereShape* hullA = (b3SphereShape*)shapeA;
 	b3HullShape* hullB = (b3HullShape*)shapeB;
-	b3CollideSphereAndHull(manifold, xfA, hullA, xfB, hullB);
+	b3CollideSphereAndHull(manifold, xfA, hullA, xfB, hullB, margin);
 }
 
 void b3CollideSphereAndCapsuleShapes(b3Manifold& manifold, 
 	const b3Transform& xfA, const b3Shape* shapeA,
 	const b3Transform& xfB, const b3Shape* shapeB,
-	b3ConvexCache* cache)
+	b3ConvexCache* cache, float32 margin)
 {
 	B3_NOT_USED(cache);
 	b3SphereShape* hullA = (b3SphereShape*)shapeA;
 	b3CapsuleShape* hullB = (b3CapsuleShape*)shapeB;
-	b3CollideSphereAndCapsule(manifold, xfA, hullA, xfB, hullB);
+	b3CollideSphereAndCapsule(manifold, xfA, hullA, xfB, hullB, margin);
 }
 
 void b3CollideCapsuleAndCapsuleShapes(b3Manifold& manifold, 
 	const b3Transform& xfA, const b3Shape* shapeA,
 	const b3Transform& xfB, const b3Shape* shapeB,
-	b3ConvexCache* cache)
+	b3ConvexCache* cache, float32 margin)
 {
 	B3_NOT_USED(cache);
 	b3CapsuleShape* hullA = (b3CapsuleShape*)shapeA;
 	b3CapsuleShape* hullB = (b3CapsuleShape*)shapeB;
-	b3CollideCapsuleAndCapsule(manifold, xfA, hullA, xfB, hullB);
+	b3CollideCapsuleAndCapsule(manifold, xfA, hullA, xfB, hullB, margin);
 }
 
 void b3CollideCapsuleAndHullShapes(b3Manifold& manifold, 
 	const b3Transform& xfA, const b3Shape* shapeA,
 	const b3Transform& xfB, const b3Shape* shapeB,
-	b3ConvexCache* cache)
+	b3ConvexCache* cache, float32 margin)
 {
     B3_NOT_USED(cache);
 	b3CapsuleShape* hullA = (b3CapsuleShape*)shapeA;
 	b3HullShape* hullB = (b3HullShape*)shapeB;
-	b3CollideCapsuleAndHull(manifold, xfA, hullA, xfB, hullB);
+	b3CollideCapsuleAndHull(manifold, xfA, hullA, xfB, hullB, margin);
 }
 
 void b3CollideHullAndHullShapes(b3Manifold& manifold, 
 	const b3Transform& xfA, const b3Shape* shapeA,
 	const b3Transform& xfB, const b3Shape* shapeB,
-	b3ConvexCache* cache)
+	b3ConvexCache* cache, float32 margin)
 {
 	b3HullShape* hullA = (b3HullShape*)shapeA;
 	b3HullShape* hullB = (b3HullShape*)shapeB;
-	b3CollideHullAndHull(manifold, xfA, hullA, xfB, hullB, cache);
+	b3CollideHullAndHull(manifold, xfA, hullA, xfB, hullB, cache, margin);
 }
 
 void b3CollideShapeAndShape(b3Manifold& manifold, 
 	const b3Transform& xfA, const b3Shape* shapeA,
 	const b3Transform& xfB, const b3Shape* shapeB, 
-	b3ConvexCache* cache)
+	b3ConvexCache* cache, float32 margin)
 {
 	typedef void(*b3CollideFunction)(b3Manifold&, 
 		const b3Transform&, const b3Shape*,
 		const b3Transform&, const b3Shape*,
-		b3ConvexCache*);
+		b3ConvexCache*, float32);
 
 	static const b3CollideFunction s_CollideMatrix[e_maxShapes][e_maxShapes] =
 	{
@@ -184,5 +184,5 @@ void b3CollideShapeAndShape(b3Manifold& manifold,
 	b3CollideFunction CollideFunc = s_CollideMatrix[typeA][typeB];
 	
 	B3_ASSERT(CollideFunc);
-	CollideFunc(manifold, xfA, shapeA, xfB, shapeB, cache);
+	CollideFunc(manifold, xfA, shapeA, xfB, shapeB, cache, margin);
 }
\ No newline at end of file
@@ -91,7 +91,8 @@ static void b3BuildEdgeContact(b3Manifold& manifold,
 
 static void b3BuildFaceContact(b3Manifold& manifold,
 	const b3Transform& xf1, const b3CapsuleShape* s1,
-	const b3Transform& xf2, u32 index2, const b3HullShape* s2)
+	const b3Transform& xf2, u32 index2, const b3HullShape* s2,
+	float32 margin)
 {
 	// Clip edge 1 against the side planes of the face 2.
 	const b3Capsule hull1(xf1 * s1->m_centers[0], xf1 * s1->m_centers[1], 0.0f);
@@ -116,7 +117,7 @@ static void b3BuildFaceContact(b3Manifold& manifold,
 	// Ensure normal orientation to hull 2.
 	b3Vec3 n1 = -plane2.normal;
 
-	float32 totalRadius = r1 + r2;
+	float32 totalRadius = r1 + r2 + margin;
 
 	u32 pointCount = 0;
 	for (u32 i = 0; i < clipCount; ++i)
@@ -143,7 +144,8 @@ static void b3BuildFaceContact(b3Manifold& manifold,
 
 void b3CollideCapsuleAndHull(b3Manifold& manifold, 
 	const b3Transform& xf1, const b3CapsuleShape* s1,
-	const b3Transform& xf2, const b3HullShape* s2)
+	const b3Transform& xf2, const b3HullShape* s2,
+	float32 margin)
 {
 	b3ShapeGJKProxy proxy1(s1, 0);
 	b3ShapeGJKProxy proxy2(s2, 0);
@@ -153,7 +155,7 @@ void b3CollideCapsuleAndHull(b3Manifold& manifold,
 	float32 r1 = s1->m_radius;
 	float32 r2 = s2->m_radius;
 
-	float32 totalRadius = r1 + r2;
+	float32 totalRadius = r1 + r2 + margin;
 
 	if (gjk.distance > totalRadius)
 	{
@@ -182,7 +184,7 @@ void b3CollideCapsuleAndHull(b3Manifold& manifold,
 		{
 			// Reference face found.
 			// Try to build a face contact.
-			b3BuildFaceContact(manifold, xf1, s1, xf2, index2, s2);
+			b3BuildFaceContact(manifold, xf1, s1, xf2, index2, s2, margin);
 			if (manifold.pointCount == 2)
 			{
 				return;
@@ -218,6 +220,6 @@ void b3CollideCapsuleAndHull(b3Manifold& manifold,
 	}
 	else
 	{
-		b3BuildFaceContact(manifold, xf1, s1, xf2, faceQuery2.index, s2);
+		b3BuildFaceContact(manifold, xf1, s1, xf2, faceQuery2.index, s2, margin);
 	}
 }
\ No newline at end of file
@@ -175,7 +175,8 @@ static bool b3AreParalell(const b3Capsule& hull1, const b3Capsule& hull2)
 
 void b3CollideCapsuleAndCapsule(b3Manifold& manifold, 
 	const b3Transform& xf1, const b3CapsuleShape* s1,
-	const b3Transform& xf2, const b3CapsuleShape* s2)
+	const b3Transform& xf2, const b3CapsuleShape* s2,
+	float32 margin)
 {
 	b3Capsule hull1;
 	hull1.vertices[0] = xf1 * s1->m_centers[0];
@@ -192,7 +193,7 @@ void b3CollideCapsuleAndCapsule(b3Manifold& manifold,
 
 	float32 r1 = s1->m_radius;
 	float32 r2 = s2->m_radius;
-	float32 totalRadius = r1 + r2;
+	float32 totalRadius = r1 + r2 + margin;
 	if (distance > totalRadius)
 	{
 		return;
@@ -94,7 +94,7 @@ void b3BuildEdgeContact(b3Manifold& manifold,
 void b3BuildFaceContact(b3Manifold& manifold,
 	const b3Transform& xf1, u32 index1, const b3HullShape* s1,
 	const b3Transform& xf2, const b3HullShape* s2,
-	bool flipNormal)
+	bool flipNormal, float32 margin)
 {
 	const b3Hull* hull1 = s1->m_hull;
 	float32 r1 = s1->m_radius;
@@ -102,7 +102,7 @@ void b3BuildFaceContact(b3Manifold& manifold,
 	const b3Hull* hull2 = s2->m_hull;
 	float32 r2 = s2->m_radius;
 
-	float32 totalRadius = r1 + r2;
+	float32 totalRadius = r1 + r2 + margin;
 
 	// 1. Define the reference face plane (1).
 	const b3Face* face1 = hull1->GetFace(index1);
@@ -208,7 +208,8 @@ void b3BuildFaceContact(b3Manifold& manifold,
 
 void b3CollideHulls(b3Manifold& manifold,
 	const b3Transform& xf1, const b3HullShape* s1,
-	const b3Transform& xf2, const b3HullShape* s2)
+	const b3Transform& xf2, const b3HullShape* s2,
+	float32 margin)
 {
 	B3_ASSERT(manifold.pointCount == 0);
 
@@ -218,7 +219,7 @@ void b3CollideHulls(b3Manifold& manifold,
 	const b3Hull* hull2 = s2->m_hull;
 	float32 r2 = s2->m_radius;
 
-	float32 totalRadius = r1 + r2;
+	float32 totalRadius = r1 + r2 + margin;
 
 	b3FaceQuery faceQuery1 = b3QueryFaceSeparation(xf1, hull1, xf2, hull2);
 	if (faceQuery1.separation > totalRadius)
@@ -247,11 +248,11 @@ void b3CollideHulls(b3Manifold& manifold,
 	{
 		if (faceQuery1.separation + kTol > faceQuery2.separation)
 		{
-			b3BuildFaceContact(manifold, xf1, faceQuery1.index, s1, xf2, s2, false);
+			b3BuildFaceContact(manifold, xf1, faceQuery1.index, s1, xf2, s2, false, margin);
 		}
 		else
 		{
-			b3BuildFaceContact(manifold, xf2, faceQuery2.index, s2, xf1, s1, true);
+			b3BuildFaceContact(manifold, xf2, faceQuery2.index, s2, xf1, s1, true, margin);
 		}
 	}
 
@@ -270,11 +271,11 @@ void b3CollideHulls(b3Manifold& manifold,
 	{
 		if (faceQuery1.separation > faceQuery2.separation)
 		{
-			b3BuildFaceContact(manifold, xf1, faceQuery1.index, s1, xf2, s2, false);
+			b3BuildFaceContact(manifold, xf1, faceQuery1.index, s1, xf2, s2, false, margin);
 		}
 		else
 		{
-			b3BuildFaceContact(manifold, xf2, faceQuery2.index, s2, xf1, s1, true);
+			b3BuildFaceContact(manifold, xf2, faceQuery2.index, s2, xf1, s1, true, margin);
 		}
 	}
 
@@ -297,21 +298,21 @@ u32 b3_convexCalls = 0, b3_convexCacheHits = 0;
 void b3CollideHulls(b3Manifold& manifold,
 	const b3Transform& xf1, const b3HullShape* s1,
 	const b3Transform& xf2, const b3HullShape* s2,
-	b3FeatureCache* cache);
+	b3FeatureCache* cache, float32 margin);
 
 void b3CollideHullAndHull(b3Manifold& manifold,
 	const b3Transform& xf1, const b3HullShape* s1,
 	const b3Transform& xf2, const b3HullShape* s2,
-	b3ConvexCache* cache)
+	b3ConvexCache* cache, float32 margin)
 {
 	++b3_convexCalls;
 
 	if (b3_convexCache)
 	{
-		b3CollideHulls(manifold, xf1, s1, xf2, s2, &cache->featureCache);
+		b3CollideHulls(manifold, xf1, s1, xf2, s2, &cache->featureCache, margin);
 	}
 	else
 	{
-		b3CollideHulls(manifold, xf1, s1, xf2, s2);
+		b3CollideHulls(manifold, xf1, s1, xf2, s2, margin);
 	}
 }
\ No newline at end of file
@@ -30,7 +30,7 @@ void b3BuildEdgeContact(b3Manifold& manifold,
 void b3BuildFaceContact(b3Manifold& manifold,
 	const b3Transform& xf1, u32 index1, const b3HullShape* s1,
 	const b3Transform& xf2, const b3HullShape* s2,
-	bool flipNormal);
+	bool flipNormal, float32 margin);
 
 static void b3RebuildEdgeContact(b3Manifold& manifold,
 	const b3Transform& xf1, u32 index1, const b3HullShape* s1,
@@ -113,7 +113,7 @@ static void b3RebuildEdgeContact(b3Manifold& manifold,
 
 static void b3RebuildFaceContact(b3Manifold& manifold,
 	const b3Transform& xf1, u32 index1, const b3HullShape* s1,
-	const b3Transform& xf2, const b3HullShape* s2, bool flipNormal)
+	const b3Transform& xf2, const b3HullShape* s2, bool flipNormal, float32 margin)
 {
 	const b3Body* body1 = s1->GetBody();
 	const b3Body* body2 = s2->GetBody();
@@ -149,14 +149,14 @@ static void b3RebuildFaceContact(b3Manifold& manifold,
 	const float32 kTol = 0.995f;
 	if (b3Abs(q.w) > kTol)
 	{
-		b3BuildFaceContact(manifold, xf1, index1, s1, xf2, s2, flipNormal);
+		b3BuildFaceContact(manifold, xf1, index1, s1, xf2, s2, flipNormal, margin);
 	}
 }
 
 void b3CollideCache(b3Manifold& manifold,
 	const b3Transform& xf1, const b3HullShape* s1,
 	const b3Transform& xf2, const b3HullShape* s2,
-	b3FeatureCache* cache)
+	b3FeatureCache* cache, float32 margin)
 {
 	B3_ASSERT(cache->m_featurePair.state == b3SATCacheType::e_empty);
 
@@ -166,7 +166,7 @@ void b3CollideCache(b3Manifold& manifold,
 	const b3Hull* hull2 = s2->m_hull;
 	float32 r2 = s2->m_radius;
 
-	float32 totalRadius = r1 + r2;
+	float32 totalRadius = r1 + r2 + margin;
 
 	b3FaceQuery faceQuery1 = b3QueryFaceSeparation(xf1, hull1, xf2, hull2);
 	if (faceQuery1.separation > totalRadius)
@@ -207,7 +207,7 @@ void b3CollideCache(b3Manifold& manifold,
 	{
 		if (faceQuery1.separation + kTol > faceQuery2.separation)
 		{
-			b3BuildFaceContact(manifold, xf1, faceQuery1.index, s1, xf2, s2, false);
+			b3BuildFaceContact(manifold, xf1, faceQuery1.index, s1, xf2, s2, false, margin);
 			if (manifold.pointCount > 0)
 			{
 				// Write an overlap cache.
@@ -217,7 +217,7 @@ void b3CollideCache(b3Manifold& manifold,
 		}
 		else
 		{
-			b3BuildFaceContact(manifold, xf2, faceQuery2.index, s2, xf1, s1, true);
+			b3BuildFaceContact(manifold, xf2, faceQuery2.index, s2, xf1, s1, true, margin);
 			if (manifold.pointCount > 0)
 			{
 				// Write an overlap cache.
@@ -242,7 +242,7 @@ void b3CollideCache(b3Manifold& manifold,
 	{
 		if (faceQuery1.separation > faceQuery2.separation)
 		{
-			b3BuildFaceContact(manifold, xf1, faceQuery1.index, s1, xf2, s2, false);
+			b3BuildFaceContact(manifold, xf1, faceQuery1.index, s1, xf2, s2, false, margin);
 			if (manifold.pointCount > 0)
 			{
 				// Write an overlap cache.
@@ -252,7 +252,7 @@ void b3CollideCache(b3Manifold& manifold,
 		}
 		else
 		{
-			b3BuildFaceContact(manifold, xf2, faceQuery2.index, s2, xf1, s1, true);
+			b3BuildFaceContact(manifold, xf2, faceQuery2.index, s2, xf1, s1, true, margin);
 			if (manifold.pointCount > 0)
 			{
 				// Write an overlap cache.
@@ -280,7 +280,7 @@ extern u32 b3_convexCacheHits;
 void b3CollideHulls(b3Manifold& manifold,
 	const b3Transform& xf1, const b3HullShape* s1,
 	const b3Transform& xf2, const b3HullShape* s2,
-	b3FeatureCache* cache)
+	b3FeatureCache* cache, float32 margin)
 {
 	const b3Hull* hull1 = s1->m_hull;
 	float32 r1 = s1->m_radius;
@@ -288,7 +288,7 @@ void b3CollideHulls(b3Manifold& manifold,
 	const b3Hull* hull2 = s2->m_hull;
 	float32 r2 = s2->m_radius;
 
-	float32 totalRadius = r1 + r2;
+	float32 totalRadius = r1 + r2 + margin;
 
 	// Read cache
 	b3SATCacheType state0 = cache->m_featurePair.state;
@@ -315,12 +315,12 @@ void b3CollideHulls(b3Manifold& manifold,
 		}
 		case b3SATFeatureType::e_face1:
 		{
-			b3RebuildFaceContact(manifold, xf1, cache->m_featurePair.index1, s1, xf2, s2, false);
+			b3RebuildFaceContact(manifold, xf1, cache->m_featurePair.index1, s1, xf2, s2, false, margin);
 			break;
 		}
 		case b3SATFeatureType::e_face2:
 		{
-			b3RebuildFaceContact(manifold, xf2, cache->m_featurePair.index1, s2, xf1, s1, true);
+			b3RebuildFaceContact(manifold, xf2, cache->m_featurePair.index1, s2, xf1, s1, true, margin);
 			break;
 		}
 		default:
@@ -341,5 +341,5 @@ void b3CollideHulls(b3Manifold& manifold,
 	// Overlap cache miss.
 	// Flush the cache.
 	cache->m_featurePair.state = b3SATCacheType::e_empty;
-	b3CollideCache(manifold, xf1, s1, xf2, s2, cache);
+	b3CollideCache(manifold, xf1, s1, xf2, s2, cache, margin);
 }
\ No newline at end of file
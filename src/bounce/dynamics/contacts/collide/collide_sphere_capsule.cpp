@@ -23,7 +23,8 @@
 
 void b3CollideSphereAndCapsule(b3Manifold& manifold, 
 	const b3Transform& xf1, const b3SphereShape* s1,
-	const b3Transform& xf2, const b3CapsuleShape* s2)
+	const b3Transform& xf2, const b3CapsuleShape* s2,
+	float32 margin)
 {
 	b3Vec3 Q = b3Mul(xf1, s1->m_center);
 
@@ -35,7 +36,7 @@ void b3CollideSphereAndCapsule(b3Manifold& manifold,
 	float32 u = b3Dot(B - Q, AB);
 	float32 v = b3Dot(Q - A, AB);
 	
-	float32 radius = s1->m_radius + s2->m_radius;
+	float32 radius = s1->m_radius + s2->m_radius + margin;
 
 	if (v <= 0.0f)
 	{
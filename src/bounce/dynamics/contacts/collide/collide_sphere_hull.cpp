@@ -25,7 +25,8 @@
 
 void b3CollideSphereAndHull(b3Manifold& manifold, 
 	const b3Transform& xf1, const b3SphereShape* s1, 
-	const b3Transform& xf2, const b3HullShape* s2) 
+	const b3Transform& xf2, const b3HullShape* s2,
+	float32 margin)
 {
 	b3ShapeGJKProxy proxy1(s1, 0);	
 	b3ShapeGJKProxy proxy2(s2, 0);	
@@ -35,7 +36,7 @@ void b3CollideSphereAndHull(b3Manifold& manifold,
 	float32 r1 = s1->m_radius;
 	float32 r2 = s2->m_radius;
 
-	float32 totalRadius = r1 + r2;
+	float32 totalRadius = r1 + r2 + margin;
 	
 	if (gjk.distance > totalRadius)
 	{
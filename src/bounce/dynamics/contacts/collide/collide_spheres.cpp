@@ -23,7 +23,8 @@
 
 void b3CollideSphereAndSphere(b3Manifold& manifold, 
 	const b3Transform& xf1, const b3SphereShape* s1,
-	const b3Transform& xf2, const b3SphereShape* s2)
+	const b3Transform& xf2, const b3SphereShape* s2,
+	float32 margin)
 {
 	b3Vec3 c1 = xf1 * s1->m_center;
 	float32 r1 = s1->m_radius;
@@ -33,7 +34,7 @@ void b3CollideSphereAndSphere(b3Manifold& manifold,
 	
 	b3Vec3 d = c2 - c1;
 	float32 dd = b3Dot(d, d);
-	float32 totalRadius = r1 + r2;
+	float32 totalRadius = r1 + r2 + margin;
 	if (dd > totalRadius * totalRadius)
 	{
 		return;
@@ -38,6 +38,23 @@ void b3Contact::GetWorldManifold(b3WorldManifold* out, u32 index) const
 	out->Initialize(m, shapeA->m_radius, xfA, shapeB->m_radius, xfB);
 }
 
+float32 b3Contact::ComputeSpeculativeMargin() const
+{
+	if ((m_flags & e_speculativeFlag) == 0)
+	{
+		return 0.0f;
+	}
+
+	const b3Body* bodyA = GetShapeA()->GetBody();
+	const b3Body* bodyB = GetShapeB()->GetBody();
+
+	const b3World* world = bodyA->GetWorld();
+
+	// The distance the shapes can approach each other in the next step.
+	b3Vec3 dv = bodyB->m_linearVelocity - bodyA->m_linearVelocity;
+	return world->m_dt * b3Length(dv);
+}
+
 void b3Contact::Update(b3ContactListener* listener)
 {
 	b3Shape* shapeA = GetShapeA();
@@ -52,6 +69,7 @@ void b3Contact::Update(b3ContactListener* listener)
 
 	bool wasOverlapping = IsOverlapping();
 	bool isOverlapping = false;
+	bool hasSpeculativePoints = false;
 	bool isSensorContact = shapeA->IsSensor() || shapeB->IsSensor();
 
 	if (isSensorContact == true)
@@ -61,6 +79,16 @@ void b3Contact::Update(b3ContactListener* listener)
 	}
 	else
 	{
+		// Speculative contacts can be enabled for the world or per body.
+		if (world->m_speculative || bodyA->IsSpeculative() || bodyB->IsSpeculative())
+		{
+			m_flags |= e_speculativeFlag;
+		}
+		else
+		{
+			m_flags &= ~e_speculativeFlag;
+		}
+
 		// Copy the old contact points.
 		b3Manifold oldManifolds[B3_MAX_MANIFOLDS];
 		u32 oldManifoldCount = m_manifoldCount;
@@ -100,6 +128,39 @@ void b3Contact::Update(b3ContactListener* listener)
 				break;
 			}
 		}
+
+		if (isOverlapping == true && (m_flags & e_speculativeFlag) != 0)
+		{
+			// Speculative points are also built for shapes that are still apart.
+			// The shapes are overlapping only if a point has no separation. 
+			// Otherwise the points are only kept for the solver.
+			isOverlapping = false;
+			for (u32 i = 0; i < m_manifoldCount && isOverlapping == false; ++i)
+			{
+				b3WorldManifold wm;
+				GetWorldManifold(&wm, i);
+
+				for (u32 j = 0; j < wm.pointCount; ++j)
+				{
+					if (wm.points[j].separation <= 0.0f)
+					{
+						isOverlapping = true;
+						break;
+					}
+				}
+			}
+
+			hasSpeculativePoints = isOverlapping == false;
+		}
+	}
+
+	if (hasSpeculativePoints == true)
+	{
+		m_flags |= e_speculativePointsFlag;
+	}
+	else
+	{
+		m_flags &= ~e_speculativePointsFlag;
 	}
 
 	// Wake the bodies associated with the shapes if the contact has began.
@@ -22,6 +22,7 @@
 #include <bounce/dynamics/body.h>
 #include <bounce/common/memory/stack_allocator.h>
 #include <bounce/common/math/mat.h>
+#include <bounce/common/math/simd.h>
 
 // This solver implements PGS for solving velocity constraints and 
 // NGS for solving position constraints.
@@ -30,44 +31,64 @@ b3ContactSolver::b3ContactSolver(const b3ContactSolverDef* def)
 {
 	m_allocator = def->allocator;
 	m_count = def->count;
+	m_bodies = def->bodies;
 	m_positions = def->positions;
 	m_velocities = def->velocities;
 	m_contacts = def->contacts;
 	m_positionConstraints = (b3ContactPositionConstraint*)m_allocator->Allocate(m_count * sizeof(b3ContactPositionConstraint));
 	m_velocityConstraints = (b3ContactVelocityConstraint*)m_allocator->Allocate(m_count * sizeof(b3ContactVelocityConstraint));
+	
+	// Count the manifolds and points so that they can be 
+	// allocated in a single block each.
+	m_manifoldCount = 0;
+	m_pointCount = 0;
+	for (u32 i = 0; i < m_count; ++i)
+	{
+		b3Contact* c = m_contacts[i];
+		m_manifoldCount += c->m_manifoldCount;
+		for (u32 j = 0; j < c->m_manifoldCount; ++j)
+		{
+			m_pointCount += c->m_manifolds[j].pointCount;
+		}
+	}
+
+	m_positionManifolds = (b3PositionConstraintManifold*)m_allocator->Allocate(m_manifoldCount * sizeof(b3PositionConstraintManifold));
+	m_velocityManifolds = (b3VelocityConstraintManifold*)m_allocator->Allocate(m_manifoldCount * sizeof(b3VelocityConstraintManifold));
+	m_positionPoints = (b3PositionConstraintPoint*)m_allocator->Allocate(m_pointCount * sizeof(b3PositionConstraintPoint));
+	m_velocityPoints = (b3VelocityConstraintPoint*)m_allocator->Allocate(m_pointCount * sizeof(b3VelocityConstraintPoint));
+	
+	m_batches = NULL;
+	m_batchCount = 0;
+	m_manifoldBatches = NULL;
+	
 	m_dt = def->dt;
 	m_invDt = m_dt != 0.0f ? 1.0f / m_dt : 0.0f;
+	m_warmStart = def->warmStart;
+	m_wide = def->wide;
 }
 
 b3ContactSolver::~b3ContactSolver()
 {
-	// Reverse free.
-	for (u32 index1 = m_count; index1 > 0; --index1)
+	if (m_batches)
 	{
-		u32 i1 = index1 - 1;
-		b3ContactPositionConstraint* pc = m_positionConstraints + i1;
-		b3ContactVelocityConstraint* vc = m_velocityConstraints + i1;
-		
-		for (u32 index2 = pc->manifoldCount; index2 > 0; --index2)
-		{
-			u32 i2 = index2 - 1;
-			b3PositionConstraintManifold* pcm = pc->manifolds + i2;
-			b3VelocityConstraintManifold* vcm = vc->manifolds + i2;
-			
-			m_allocator->Free(vcm->points);
-			m_allocator->Free(pcm->points);
-		}
-
-		m_allocator->Free(vc->manifolds);
-		m_allocator->Free(pc->manifolds);
+		m_allocator->Free(m_batches);
+		m_allocator->Free(m_manifoldBatches);
 	}
 
+	// Reverse free.
+	m_allocator->Free(m_velocityPoints);
+	m_allocator->Free(m_positionPoints);
+	m_allocator->Free(m_velocityManifolds);
+	m_allocator->Free(m_positionManifolds);
 	m_allocator->Free(m_velocityConstraints);
 	m_allocator->Free(m_positionConstraints);
 }
 
 void b3ContactSolver::InitializeConstraints()
 {
+	u32 manifoldIndex = 0;
+	u32 pointIndex = 0;
+
 	for (u32 i = 0; i < m_count; ++i)
 	{
 		b3Contact* c = m_contacts[i];
@@ -75,8 +96,11 @@ void b3ContactSolver::InitializeConstraints()
 		b3Shape* shapeA = c->GetShapeA();
 		b3Shape* shapeB = c->GetShapeB();
 
-		b3Body* bodyA = shapeA->GetBody();
-		b3Body* bodyB = shapeB->GetBody();
+		u32 indexA = c->m_islandIndexA;
+		u32 indexB = c->m_islandIndexB;
+
+		const b3SolverBody* bodyA = m_bodies + indexA;
+		const b3SolverBody* bodyB = m_bodies + indexB;
 
 		u32 manifoldCount = c->m_manifoldCount;
 		b3Manifold* manifolds = c->m_manifolds;
@@ -84,34 +108,36 @@ void b3ContactSolver::InitializeConstraints()
 		b3ContactPositionConstraint* pc = m_positionConstraints + i;
 		b3ContactVelocityConstraint* vc = m_velocityConstraints + i;
 
-		pc->indexA = bodyA->m_islandID;
-		pc->invMassA = bodyA->m_invMass;
-		pc->invIA = bodyA->m_worldInvI;
-		pc->localCenterA = bodyA->m_sweep.localCenter;
+		pc->indexA = indexA;
+		pc->invMassA = bodyA->invMass;
+		pc->invIA = bodyA->invI;
+		pc->localCenterA = bodyA->localCenter;
 		pc->radiusA = shapeA->m_radius;
 
-		pc->indexB = bodyB->m_islandID;
-		pc->invMassB = bodyB->m_invMass;
-		pc->invIB = bodyB->m_worldInvI;
-		pc->localCenterB = bodyB->m_sweep.localCenter;
+		pc->indexB = indexB;
+		pc->invMassB = bodyB->invMass;
+		pc->invIB = bodyB->invI;
+		pc->localCenterB = bodyB->localCenter;
 		pc->radiusB = shapeB->m_radius;
 
 		pc->manifoldCount = manifoldCount;
-		pc->manifolds = (b3PositionConstraintManifold*)m_allocator->Allocate(manifoldCount * sizeof(b3PositionConstraintManifold));
+		pc->manifolds = m_positionManifolds + manifoldIndex;
 
-		vc->indexA = bodyA->m_islandID;
-		vc->invMassA = bodyA->m_invMass;
-		vc->invIA = bodyA->m_worldInvI;
+		vc->indexA = indexA;
+		vc->invMassA = bodyA->invMass;
+		vc->invIA = bodyA->invI;
 
-		vc->indexB = bodyB->m_islandID;
-		vc->invMassB = bodyB->m_invMass;
-		vc->invIB = bodyB->m_worldInvI;
+		vc->indexB = indexB;
+		vc->invMassB = bodyB->invMass;
+		vc->invIB = bodyB->invI;
 
 		vc->friction = b3MixFriction(shapeA->m_friction, shapeB->m_friction);
 		vc->restitution = b3MixRestitution(shapeA->m_restitution, shapeB->m_restitution);
+		vc->speculative = (c->m_flags & b3Contact::e_speculativeFlag) != 0;
 
 		vc->manifoldCount = manifoldCount;
-		vc->manifolds = (b3VelocityConstraintManifold*)m_allocator->Allocate(manifoldCount * sizeof(b3VelocityConstraintManifold));
+		vc->manifolds = m_velocityManifolds + manifoldIndex;
+		manifoldIndex += manifoldCount;
 
 		for (u32 j = 0; j < manifoldCount; ++j)
 		{
@@ -120,13 +146,23 @@ void b3ContactSolver::InitializeConstraints()
 			b3VelocityConstraintManifold* vcm = vc->manifolds + j;
 
 			pcm->pointCount = m->pointCount;
-			pcm->points = (b3PositionConstraintPoint*)m_allocator->Allocate(pcm->pointCount * sizeof(b3PositionConstraintPoint));
+			pcm->points = m_positionPoints + pointIndex;
 			
 			vcm->pointCount = m->pointCount;
-			vcm->points = (b3VelocityConstraintPoint*)m_allocator->Allocate(vcm->pointCount * sizeof(b3VelocityConstraintPoint));
+			vcm->points = m_velocityPoints + pointIndex;
+
+			pointIndex += m->pointCount;
 			
-			vcm->tangentImpulse = m->tangentImpulse;
-			vcm->motorImpulse = m->motorImpulse;
+			if (m_warmStart)
+			{
+				vcm->tangentImpulse = m->tangentImpulse;
+				vcm->motorImpulse = m->motorImpulse;
+			}
+			else
+			{
+				vcm->tangentImpulse.SetZero();
+				vcm->motorImpulse = 0.0f;
+			}
 			
 			for (u32 k = 0; k < m->pointCount; ++k)
 			{
@@ -138,11 +174,24 @@ void b3ContactSolver::InitializeConstraints()
 				pcp->localPointA = cp->localPoint1;
 				pcp->localPointB = cp->localPoint2;
 
-				vcp->normalImpulse = cp->normalImpulse;
+				vcp->normalImpulse = m_warmStart ? cp->normalImpulse : 0.0f;
 			}
 		}
 	}
 
+	B3_ASSERT(manifoldIndex == m_manifoldCount);
+	B3_ASSERT(pointIndex == m_pointCount);
+
+	InitializeVelocityConstraints();
+
+	if (m_wide)
+	{
+		InitializeBatches();
+	}
+}
+
+void b3ContactSolver::InitializeVelocityConstraints()
+{
 	for (u32 i = 0; i < m_count; ++i)
 	{
 		b3Contact* c = m_contacts[i];
@@ -225,10 +274,20 @@ void b3ContactSolver::InitializeConstraints()
 					// Add restitution to the velocity constraint.
 					b3Vec3 dv = vB + b3Cross(wB, rB) - vA - b3Cross(wA, rA);
 					float32 vn = b3Dot(normal, dv);
-					vcp->velocityBias = 0.0f;
+					vcp->restitutionBias = 0.0f;
 					if (vn < -B3_VELOCITY_THRESHOLD)
 					{
-						vcp->velocityBias = -vc->restitution * vn;
+						vcp->restitutionBias = -vc->restitution * vn;
+					}
+
+					vcp->separation = mp->separation;
+					vcp->normalVelocity = vn;
+					vcp->velocityBias = vcp->restitutionBias;
+					if (vc->speculative && mp->separation > 0.0f)
+					{
+						// Speculative contact.
+						// Let the shapes close the gap in this step but not further.
+						vcp->velocityBias = -mp->separation * m_invDt;
 					}
 				}
 			}
@@ -276,6 +335,64 @@ void b3ContactSolver::InitializeConstraints()
 	}
 }
 
+void b3ContactSolver::ScaleImpulses(float32 scale)
+{
+	for (u32 i = 0; i < m_manifoldCount; ++i)
+	{
+		b3VelocityConstraintManifold* vcm = m_velocityManifolds + i;
+		vcm->tangentImpulse *= scale;
+		vcm->motorImpulse *= scale;
+	}
+
+	for (u32 i = 0; i < m_pointCount; ++i)
+	{
+		m_velocityPoints[i].normalImpulse *= scale;
+	}
+}
+
+void b3ContactSolver::ComputeSubStepBiases(const b3Displacement* displacements, bool useBias)
+{
+	for (u32 i = 0; i < m_count; ++i)
+	{
+		b3ContactVelocityConstraint* vc = m_velocityConstraints + i;
+
+		b3Displacement dA = displacements[vc->indexA];
+		b3Displacement dB = displacements[vc->indexB];
+
+		for (u32 j = 0; j < vc->manifoldCount; ++j)
+		{
+			b3VelocityConstraintManifold* vcm = vc->manifolds + j;
+
+			for (u32 k = 0; k < vcm->pointCount; ++k)
+			{
+				b3VelocityConstraintPoint* vcp = vcm->points + k;
+
+				// Linearize the motion of the anchors.
+				b3Vec3 dpA = dA.linear + b3Cross(dA.angular, vcp->rA);
+				b3Vec3 dpB = dB.linear + b3Cross(dB.angular, vcp->rB);
+				float32 separation = vcp->separation + b3Dot(vcp->normal, dpB - dpA);
+
+				if (separation > 0.0f)
+				{
+					// Let the shapes close the gap in this sub-step but not further.
+					vcp->velocityBias = -separation * m_invDt;
+				}
+				else if (useBias)
+				{
+					// Allow some slop and prevent large corrections.
+					float32 C = b3Min(separation + B3_LINEAR_SLOP, 0.0f);
+					vcp->velocityBias = b3Min(-B3_BAUMGARTE * m_invDt * C, B3_MAX_LINEAR_CORRECTION * m_invDt);
+					vcp->velocityBias = b3Max(vcp->velocityBias, vcp->restitutionBias);
+				}
+				else
+				{
+					vcp->velocityBias = vcp->restitutionBias;
+				}
+			}
+		}
+	}
+}
+
 void b3ContactSolver::WarmStart()
 {
 	for (u32 i = 0; i < m_count; ++i)
@@ -338,7 +455,19 @@ void b3ContactSolver::WarmStart()
 
 void b3ContactSolver::SolveVelocityConstraints()
 {
-	for (u32 i = 0; i < m_count; ++i)
+	if (m_wide)
+	{
+		SolveVelocityBatches();
+		return;
+	}
+
+	SolveVelocityConstraints(0, m_count);
+}
+
+void b3ContactSolver::SolveVelocityConstraints(u32 begin, u32 end)
+{
+	B3_ASSERT(end <= m_count);
+	for (u32 i = begin; i < end; ++i)
 	{
 		b3ContactVelocityConstraint* vc = m_velocityConstraints + i;
 		u32 manifoldCount = vc->manifoldCount;
@@ -448,8 +577,80 @@ void b3ContactSolver::SolveVelocityConstraints()
 	}
 }
 
+void b3ContactSolver::ApplySpeculativeRestitution(float32 dt)
+{
+	if (m_wide)
+	{
+		// The accumulated impulses tell which points closed their gap.
+		StoreBatchImpulses();
+	}
+
+	for (u32 i = 0; i < m_count; ++i)
+	{
+		b3ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		if (vc->speculative == false || vc->restitution == 0.0f)
+		{
+			continue;
+		}
+
+		u32 indexA = vc->indexA;
+		float32 mA = vc->invMassA;
+		b3Mat33 iA = vc->invIA;
+
+		u32 indexB = vc->indexB;
+		float32 mB = vc->invMassB;
+		b3Mat33 iB = vc->invIB;
+
+		b3Vec3 vA = m_velocities[indexA].v;
+		b3Vec3 wA = m_velocities[indexA].w;
+		b3Vec3 vB = m_velocities[indexB].v;
+		b3Vec3 wB = m_velocities[indexB].w;
+
+		for (u32 j = 0; j < vc->manifoldCount; ++j)
+		{
+			b3VelocityConstraintManifold* vcm = vc->manifolds + j;
+
+			for (u32 k = 0; k < vcm->pointCount; ++k)
+			{
+				b3VelocityConstraintPoint* vcp = vcm->points + k;
+
+				// The overlapping points have their restitution in the velocity bias.
+				// Skip the points that didn't close their gap in this step.
+				if (vcp->separation <= 0.0f || vcp->restitutionBias == 0.0f || vcp->normalImpulse == 0.0f || vcp->normalVelocity * dt > -vcp->separation)
+				{
+					continue;
+				}
+
+				// Push the shapes apart until they separate at the restitution velocity.
+				b3Vec3 dv = vB + b3Cross(wB, vcp->rB) - vA - b3Cross(wA, vcp->rA);
+				float32 Cdot = b3Dot(vcp->normal, dv);
+
+				float32 impulse = b3Max(-vcp->normalMass * (Cdot - vcp->restitutionBias), 0.0f);
+
+				b3Vec3 P = impulse * vcp->normal;
+
+				vA -= mA * P;
+				wA -= iA * b3Cross(vcp->rA, P);
+
+				vB += mB * P;
+				wB += iB * b3Cross(vcp->rB, P);
+			}
+		}
+
+		m_velocities[indexA].v = vA;
+		m_velocities[indexA].w = wA;
+		m_velocities[indexB].v = vB;
+		m_velocities[indexB].w = wB;
+	}
+}
+
 void b3ContactSolver::StoreImpulses()
 {
+	if (m_wide)
+	{
+		StoreBatchImpulses();
+	}
+
 	for (u32 i = 0; i < m_count; ++i)
 	{
 		b3Contact* c = m_contacts[i];
@@ -477,6 +678,459 @@ void b3ContactSolver::StoreImpulses()
 	}
 }
 
+// A 3D vector for each of the four lanes.
+struct b3WideVec3
+{
+	b3Float4 x, y, z;
+};
+
+// A 3x3 matrix for each of the four lanes, stored by columns.
+struct b3WideMat33
+{
+	b3WideVec3 x, y, z;
+};
+
+static B3_FORCE_INLINE b3WideVec3 operator+(const b3WideVec3& a, const b3WideVec3& b)
+{
+	b3WideVec3 r;
+	r.x = a.x + b.x;
+	r.y = a.y + b.y;
+	r.z = a.z + b.z;
+	return r;
+}
+
+static B3_FORCE_INLINE b3WideVec3 operator-(const b3WideVec3& a, const b3WideVec3& b)
+{
+	b3WideVec3 r;
+	r.x = a.x - b.x;
+	r.y = a.y - b.y;
+	r.z = a.z - b.z;
+	return r;
+}
+
+static B3_FORCE_INLINE b3WideVec3 operator*(const b3Float4& s, const b3WideVec3& v)
+{
+	b3WideVec3 r;
+	r.x = s * v.x;
+	r.y = s * v.y;
+	r.z = s * v.z;
+	return r;
+}
+
+static B3_FORCE_INLINE b3WideVec3 operator*(const b3WideMat33& A, const b3WideVec3& v)
+{
+	b3WideVec3 r;
+	r.x = A.x.x * v.x + A.y.x * v.y + A.z.x * v.z;
+	r.y = A.x.y * v.x + A.y.y * v.y + A.z.y * v.z;
+	r.z = A.x.z * v.x + A.y.z * v.y + A.z.z * v.z;
+	return r;
+}
+
+static B3_FORCE_INLINE b3Float4 b3Dot(const b3WideVec3& a, const b3WideVec3& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static B3_FORCE_INLINE b3WideVec3 b3Cross(const b3WideVec3& a, const b3WideVec3& b)
+{
+	b3WideVec3 r;
+	r.x = a.y * b.z - a.z * b.y;
+	r.y = a.z * b.x - a.x * b.z;
+	r.z = a.x * b.y - a.y * b.x;
+	return r;
+}
+
+static B3_FORCE_INLINE void b3SetLane(b3WideVec3& a, u32 lane, const b3Vec3& v)
+{
+	b3SetLane(a.x, lane, v.x);
+	b3SetLane(a.y, lane, v.y);
+	b3SetLane(a.z, lane, v.z);
+}
+
+static B3_FORCE_INLINE void b3SetLane(b3WideMat33& A, u32 lane, const b3Mat33& M)
+{
+	b3SetLane(A.x, lane, M.x);
+	b3SetLane(A.y, lane, M.y);
+	b3SetLane(A.z, lane, M.z);
+}
+
+static B3_FORCE_INLINE b3Vec3 b3GetLane(const b3WideVec3& a, u32 lane)
+{
+	return b3Vec3(b3GetLane(a.x, lane), b3GetLane(a.y, lane), b3GetLane(a.z, lane));
+}
+
+struct b3ContactVelocityBatchPoint
+{
+	b3WideVec3 rA;
+	b3WideVec3 rB;
+
+	b3WideVec3 normal;
+	b3Float4 normalMass;
+	b3Float4 normalImpulse;
+	b3Float4 velocityBias;
+};
+
+// Up to four velocity constraint manifolds that don't share a moving body. 
+// Each lane holds one manifold. The unused lanes and points are zeroed, 
+// so they apply no impulses.
+struct b3ContactVelocityBatch
+{
+	b3Float4 invMassA;
+	b3WideMat33 invIA;
+	b3Float4 invMassB;
+	b3WideMat33 invIB;
+	b3Float4 friction;
+
+	b3WideVec3 rA;
+	b3WideVec3 rB;
+
+	b3WideVec3 normal;
+	b3WideVec3 tangent1;
+	b3WideVec3 tangent2;
+
+	// The tangent mass matrix columns.
+	b3Float4 tangentMassXX, tangentMassXY;
+	b3Float4 tangentMassYX, tangentMassYY;
+	b3Float4 tangentImpulseX, tangentImpulseY;
+	b3Float4 motorMass;
+	b3Float4 motorImpulse;
+	
+	b3ContactVelocityBatchPoint points[B3_MAX_MANIFOLD_POINTS];
+
+	b3VelocityConstraintManifold* manifolds[4];
+	u32 indexA[4];
+	u32 indexB[4];
+	u32 count;
+	u32 pointCount;
+};
+
+// A batch that can still receive manifolds.
+struct b3OpenContactBatch
+{
+	u32 batchIndex;
+	u32 count;
+	u32 bodies[8];
+	u32 bodyCount;
+};
+
+static B3_FORCE_INLINE bool b3ContainsBody(const b3OpenContactBatch* batch, u32 index)
+{
+	for (u32 i = 0; i < batch->bodyCount; ++i)
+	{
+		if (batch->bodies[i] == index)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void b3ContactSolver::InitializeBatches()
+{
+	// The number of batches that can receive manifolds at the same time.
+	// A manifold is added to the first open batch that doesn't move any of its bodies. 
+	// If all open batches conflict then a new one is opened, closing the oldest one. 
+	// A larger window leaves fewer unused lanes but takes longer to search.
+	const u32 windowCapacity = 8;
+	b3OpenContactBatch window[windowCapacity];
+	u32 windowCount = 0;
+
+	// The batches are allocated after this array, so it's freed with them.
+	u32* manifoldBatches = (u32*)m_allocator->Allocate(m_manifoldCount * sizeof(u32));
+	m_manifoldBatches = manifoldBatches;
+	u32 batchCount = 0;
+	
+	u32 manifoldIndex = 0;
+	for (u32 i = 0; i < m_count; ++i)
+	{
+		b3ContactVelocityConstraint* vc = m_velocityConstraints + i;
+
+		// Bodies with infinite mass are not moved by the constraint, 
+		// so they can be shared by the manifolds of a batch.
+		bool movesA = vc->invMassA > 0.0f;
+		bool movesB = vc->invMassB > 0.0f;
+
+		for (u32 j = 0; j < vc->manifoldCount; ++j)
+		{
+			u32 w = 0;
+			while (w < windowCount)
+			{
+				b3OpenContactBatch* batch = window + w;
+				
+				bool conflictA = movesA && b3ContainsBody(batch, vc->indexA);
+				bool conflictB = movesB && b3ContainsBody(batch, vc->indexB);
+				if (conflictA == false && conflictB == false)
+				{
+					break;
+				}
+				
+				++w;
+			}
+
+			if (w == windowCount)
+			{
+				if (windowCount == windowCapacity)
+				{
+					// Close the oldest batch.
+					memmove(window, window + 1, (windowCount - 1) * sizeof(b3OpenContactBatch));
+					--windowCount;
+				}
+
+				w = windowCount;
+				++windowCount;
+
+				window[w].batchIndex = batchCount;
+				window[w].count = 0;
+				window[w].bodyCount = 0;
+				++batchCount;
+			}
+
+			b3OpenContactBatch* batch = window + w;
+
+			if (movesA)
+			{
+				batch->bodies[batch->bodyCount++] = vc->indexA;
+			}
+			
+			if (movesB)
+			{
+				batch->bodies[batch->bodyCount++] = vc->indexB;
+			}
+
+			manifoldBatches[manifoldIndex] = batch->batchIndex;
+			++manifoldIndex;
+
+			++batch->count;
+			if (batch->count == 4)
+			{
+				// The batch is full.
+				memmove(batch, batch + 1, (windowCount - w - 1) * sizeof(b3OpenContactBatch));
+				--windowCount;
+			}
+		}
+	}
+
+	B3_ASSERT(manifoldIndex == m_manifoldCount);
+
+	m_batchCount = batchCount;
+	m_batches = (b3ContactVelocityBatch*)m_allocator->AllocateAligned(m_batchCount * sizeof(b3ContactVelocityBatch), B3_CACHE_LINE_SIZE);
+	memset(m_batches, 0, m_batchCount * sizeof(b3ContactVelocityBatch));
+
+	// Copy the manifolds to their lanes.
+	manifoldIndex = 0;
+	for (u32 i = 0; i < m_count; ++i)
+	{
+		b3ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		
+		for (u32 j = 0; j < vc->manifoldCount; ++j)
+		{
+			b3VelocityConstraintManifold* vcm = vc->manifolds + j;
+			
+			b3ContactVelocityBatch* batch = m_batches + manifoldBatches[manifoldIndex];
+			++manifoldIndex;
+
+			u32 lane = batch->count;
+			++batch->count;
+
+			batch->manifolds[lane] = vcm;
+			batch->indexA[lane] = vc->indexA;
+			batch->indexB[lane] = vc->indexB;
+			batch->pointCount = b3Max(batch->pointCount, vcm->pointCount);
+
+			b3SetLane(batch->invMassA, lane, vc->invMassA);
+			b3SetLane(batch->invIA, lane, vc->invIA);
+			b3SetLane(batch->invMassB, lane, vc->invMassB);
+			b3SetLane(batch->invIB, lane, vc->invIB);
+			b3SetLane(batch->friction, lane, vc->friction);
+
+			b3SetLane(batch->rA, lane, vcm->rA);
+			b3SetLane(batch->rB, lane, vcm->rB);
+			b3SetLane(batch->normal, lane, vcm->normal);
+			b3SetLane(batch->tangent1, lane, vcm->tangent1);
+			b3SetLane(batch->tangent2, lane, vcm->tangent2);
+			b3SetLane(batch->tangentMassXX, lane, vcm->tangentMass.x.x);
+			b3SetLane(batch->tangentMassXY, lane, vcm->tangentMass.x.y);
+			b3SetLane(batch->tangentMassYX, lane, vcm->tangentMass.y.x);
+			b3SetLane(batch->tangentMassYY, lane, vcm->tangentMass.y.y);
+			b3SetLane(batch->tangentImpulseX, lane, vcm->tangentImpulse.x);
+			b3SetLane(batch->tangentImpulseY, lane, vcm->tangentImpulse.y);
+			b3SetLane(batch->motorMass, lane, vcm->motorMass);
+			b3SetLane(batch->motorImpulse, lane, vcm->motorImpulse);
+
+			for (u32 k = 0; k < vcm->pointCount; ++k)
+			{
+				b3VelocityConstraintPoint* vcp = vcm->points + k;
+				b3ContactVelocityBatchPoint* bp = batch->points + k;
+
+				b3SetLane(bp->rA, lane, vcp->rA);
+				b3SetLane(bp->rB, lane, vcp->rB);
+				b3SetLane(bp->normal, lane, vcp->normal);
+				b3SetLane(bp->normalMass, lane, vcp->normalMass);
+				b3SetLane(bp->normalImpulse, lane, vcp->normalImpulse);
+				b3SetLane(bp->velocityBias, lane, vcp->velocityBias);
+			}
+		}
+	}
+
+	// Point the unused lanes to the bodies of the first lane.
+	// The velocities are read but never written back.
+	for (u32 i = 0; i < m_batchCount; ++i)
+	{
+		b3ContactVelocityBatch* batch = m_batches + i;
+		for (u32 lane = batch->count; lane < 4; ++lane)
+		{
+			batch->indexA[lane] = batch->indexA[0];
+			batch->indexB[lane] = batch->indexB[0];
+		}
+	}
+
+}
+
+void b3ContactSolver::SolveVelocityBatches()
+{
+	b3Float4 zero = b3Splat4(0.0f);
+	b3Float4 one = b3Splat4(1.0f);
+	b3Float4 minLengthSquared = b3Splat4(B3_EPSILON * B3_EPSILON);
+
+	for (u32 i = 0; i < m_batchCount; ++i)
+	{
+		b3ContactVelocityBatch* batch = m_batches + i;
+
+		const u32* indexA = batch->indexA;
+		b3Float4 mA = batch->invMassA;
+		const b3WideMat33& iA = batch->invIA;
+
+		const u32* indexB = batch->indexB;
+		b3Float4 mB = batch->invMassB;
+		const b3WideMat33& iB = batch->invIB;
+
+		const b3Velocity* vcA[4] = { m_velocities + indexA[0], m_velocities + indexA[1], m_velocities + indexA[2], m_velocities + indexA[3] };
+		const b3Velocity* vcB[4] = { m_velocities + indexB[0], m_velocities + indexB[1], m_velocities + indexB[2], m_velocities + indexB[3] };
+
+		b3WideVec3 vA, wA;
+		vA.x = b3Set4(vcA[0]->v.x, vcA[1]->v.x, vcA[2]->v.x, vcA[3]->v.x);
+		vA.y = b3Set4(vcA[0]->v.y, vcA[1]->v.y, vcA[2]->v.y, vcA[3]->v.y);
+		vA.z = b3Set4(vcA[0]->v.z, vcA[1]->v.z, vcA[2]->v.z, vcA[3]->v.z);
+		wA.x = b3Set4(vcA[0]->w.x, vcA[1]->w.x, vcA[2]->w.x, vcA[3]->w.x);
+		wA.y = b3Set4(vcA[0]->w.y, vcA[1]->w.y, vcA[2]->w.y, vcA[3]->w.y);
+		wA.z = b3Set4(vcA[0]->w.z, vcA[1]->w.z, vcA[2]->w.z, vcA[3]->w.z);
+
+		b3WideVec3 vB, wB;
+		vB.x = b3Set4(vcB[0]->v.x, vcB[1]->v.x, vcB[2]->v.x, vcB[3]->v.x);
+		vB.y = b3Set4(vcB[0]->v.y, vcB[1]->v.y, vcB[2]->v.y, vcB[3]->v.y);
+		vB.z = b3Set4(vcB[0]->v.z, vcB[1]->v.z, vcB[2]->v.z, vcB[3]->v.z);
+		wB.x = b3Set4(vcB[0]->w.x, vcB[1]->w.x, vcB[2]->w.x, vcB[3]->w.x);
+		wB.y = b3Set4(vcB[0]->w.y, vcB[1]->w.y, vcB[2]->w.y, vcB[3]->w.y);
+		wB.z = b3Set4(vcB[0]->w.z, vcB[1]->w.z, vcB[2]->w.z, vcB[3]->w.z);
+
+		b3Float4 normalImpulse = zero;
+		for (u32 k = 0; k < batch->pointCount; ++k)
+		{
+			b3ContactVelocityBatchPoint* bp = batch->points + k;
+
+			// Solve normal constraints.
+			b3WideVec3 dv = vB + b3Cross(wB, bp->rB) - vA - b3Cross(wA, bp->rA);
+			b3Float4 Cdot = b3Dot(bp->normal, dv);
+
+			b3Float4 impulse = zero - bp->normalMass * (Cdot - bp->velocityBias);
+
+			b3Float4 oldImpulse = bp->normalImpulse;
+			bp->normalImpulse = b3Max4(oldImpulse + impulse, zero);
+			impulse = bp->normalImpulse - oldImpulse;
+
+			b3WideVec3 P = impulse * bp->normal;
+
+			vA = vA - mA * P;
+			wA = wA - iA * b3Cross(bp->rA, P);
+
+			vB = vB + mB * P;
+			wB = wB + iB * b3Cross(bp->rB, P);
+
+			normalImpulse = normalImpulse + bp->normalImpulse;
+		}
+
+		b3Float4 maxImpulse = batch->friction * normalImpulse;
+
+		// Solve tangent constraints.
+		{
+			b3WideVec3 dv = vB + b3Cross(wB, batch->rB) - vA - b3Cross(wA, batch->rA);
+
+			b3Float4 Cdot1 = b3Dot(dv, batch->tangent1);
+			b3Float4 Cdot2 = b3Dot(dv, batch->tangent2);
+
+			b3Float4 impulse1 = zero - (batch->tangentMassXX * Cdot1 + batch->tangentMassYX * Cdot2);
+			b3Float4 impulse2 = zero - (batch->tangentMassXY * Cdot1 + batch->tangentMassYY * Cdot2);
+
+			b3Float4 oldImpulse1 = batch->tangentImpulseX;
+			b3Float4 oldImpulse2 = batch->tangentImpulseY;
+			b3Float4 newImpulse1 = oldImpulse1 + impulse1;
+			b3Float4 newImpulse2 = oldImpulse2 + impulse2;
+
+			// Clamp the impulse to the friction cone.
+			b3Float4 lengthSquared = b3Max4(newImpulse1 * newImpulse1 + newImpulse2 * newImpulse2, minLengthSquared);
+			b3Float4 scale = b3Min4(one, maxImpulse / b3Sqrt4(lengthSquared));
+			batch->tangentImpulseX = scale * newImpulse1;
+			batch->tangentImpulseY = scale * newImpulse2;
+
+			impulse1 = batch->tangentImpulseX - oldImpulse1;
+			impulse2 = batch->tangentImpulseY - oldImpulse2;
+
+			b3WideVec3 P = impulse1 * batch->tangent1 + impulse2 * batch->tangent2;
+
+			vA = vA - mA * P;
+			wA = wA - iA * b3Cross(batch->rA, P);
+
+			vB = vB + mB * P;
+			wB = wB + iB * b3Cross(batch->rB, P);
+		}
+
+		// Solve motor constraint.
+		{
+			b3Float4 Cdot = b3Dot(batch->normal, wB - wA);
+			b3Float4 impulse = zero - batch->motorMass * Cdot;
+			b3Float4 oldImpulse = batch->motorImpulse;
+			batch->motorImpulse = b3Min4(b3Max4(oldImpulse + impulse, zero - maxImpulse), maxImpulse);
+			impulse = batch->motorImpulse - oldImpulse;
+
+			b3WideVec3 P = impulse * batch->normal;
+
+			wA = wA - iA * P;
+			wB = wB + iB * P;
+		}
+
+		// Write back the velocities of the used lanes only.
+		for (u32 lane = 0; lane < batch->count; ++lane)
+		{
+			m_velocities[indexA[lane]].v = b3GetLane(vA, lane);
+			m_velocities[indexA[lane]].w = b3GetLane(wA, lane);
+			m_velocities[indexB[lane]].v = b3GetLane(vB, lane);
+			m_velocities[indexB[lane]].w = b3GetLane(wB, lane);
+		}
+	}
+}
+
+void b3ContactSolver::StoreBatchImpulses()
+{
+	for (u32 i = 0; i < m_batchCount; ++i)
+	{
+		b3ContactVelocityBatch* batch = m_batches + i;
+
+		for (u32 lane = 0; lane < batch->count; ++lane)
+		{
+			b3VelocityConstraintManifold* vcm = batch->manifolds[lane];
+			
+			vcm->tangentImpulse.x = b3GetLane(batch->tangentImpulseX, lane);
+			vcm->tangentImpulse.y = b3GetLane(batch->tangentImpulseY, lane);
+			vcm->motorImpulse = b3GetLane(batch->motorImpulse, lane);
+
+			for (u32 k = 0; k < vcm->pointCount; ++k)
+			{
+				vcm->points[k].normalImpulse = b3GetLane(batch->points[k].normalImpulse, lane);
+			}
+		}
+	}
+}
+
 struct b3ContactPositionSolverPoint
 {
 	void Initialize(const b3ContactPositionConstraint* pc, const b3PositionConstraintPoint* pcp, const b3Transform& xfA, const b3Transform& xfB)
@@ -495,9 +1149,15 @@ struct b3ContactPositionSolverPoint
 
 bool b3ContactSolver::SolvePositionConstraints()
 {
+	return SolvePositionConstraints(0, m_count);
+}
+
+bool b3ContactSolver::SolvePositionConstraints(u32 begin, u32 end)
+{
+	B3_ASSERT(end <= m_count);
 	float32 minSeparation = 0.0f;
 
-	for (u32 i = 0; i < m_count; ++i)
+	for (u32 i = begin; i < end; ++i)
 	{
 		b3ContactPositionConstraint* pc = m_positionConstraints + i;
 
@@ -581,3 +1241,115 @@ bool b3ContactSolver::SolvePositionConstraints()
 
 	return minSeparation >= -3.0f * B3_LINEAR_SLOP;
 }
+
+bool b3ContactSolver::SolveTOIPositionConstraints(u32 toiIndexA, u32 toiIndexB)
+{
+	float32 minError = 0.0f;
+
+	for (u32 i = 0; i < m_count; ++i)
+	{
+		b3ContactPositionConstraint* pc = m_positionConstraints + i;
+
+		u32 indexA = pc->indexA;
+		b3Vec3 localCenterA = pc->localCenterA;
+
+		u32 indexB = pc->indexB;
+		b3Vec3 localCenterB = pc->localCenterB;
+
+		// Only the bodies of the time of impact contact are moved.
+		float32 mA = 0.0f;
+		b3Mat33 iA;
+		iA.SetZero();
+		if (indexA == toiIndexA || indexA == toiIndexB)
+		{
+			mA = pc->invMassA;
+			iA = pc->invIA;
+		}
+
+		float32 mB = 0.0f;
+		b3Mat33 iB;
+		iB.SetZero();
+		if (indexB == toiIndexA || indexB == toiIndexB)
+		{
+			mB = pc->invMassB;
+			iB = pc->invIB;
+		}
+
+		b3Vec3 cA = m_positions[indexA].x;
+		b3Quat qA = m_positions[indexA].q;
+
+		b3Vec3 cB = m_positions[indexB].x;
+		b3Quat qB = m_positions[indexB].q;
+
+		u32 manifoldCount = pc->manifoldCount;
+
+		// Hulls have no radius. Push them apart by more than the time of impact 
+		// target distance, so that the next time of impact starts with separated shapes.
+		float32 targetSeparation = -B3_LINEAR_SLOP;
+		if (pc->radiusA + pc->radiusB == 0.0f)
+		{
+			targetSeparation = 2.0f * B3_LINEAR_SLOP;
+		}
+
+		for (u32 j = 0; j < manifoldCount; ++j)
+		{
+			b3PositionConstraintManifold* pcm = pc->manifolds + j;
+			u32 pointCount = pcm->pointCount;
+
+			// Solve normal constraints
+			for (u32 k = 0; k < pointCount; ++k)
+			{
+				b3PositionConstraintPoint* pcp = pcm->points + k;
+
+				b3Transform xfA;
+				xfA.rotation = b3QuatMat33(qA);
+				xfA.position = cA - b3Mul(xfA.rotation, localCenterA);
+
+				b3Transform xfB;
+				xfB.rotation = b3QuatMat33(qB);
+				xfB.position = cB - b3Mul(xfB.rotation, localCenterB);
+
+				b3ContactPositionSolverPoint cpcp;
+				cpcp.Initialize(pc, pcp, xfA, xfB);
+
+				b3Vec3 normal = cpcp.normal;
+				b3Vec3 point = cpcp.point;
+				float32 separation = cpcp.separation;
+
+				// Update max constraint error.
+				minError = b3Min(minError, separation - targetSeparation);
+
+				// Allow some slop and prevent large corrections.
+				float32 C = b3Clamp(B3_TOI_BAUMGARTE * (separation - targetSeparation), -B3_MAX_LINEAR_CORRECTION, 0.0f);
+
+				// Compute effective mass.
+				b3Vec3 rA = point - cA;
+				b3Vec3 rB = point - cB;
+				
+				b3Vec3 rnA = b3Cross(rA, normal);
+				b3Vec3 rnB = b3Cross(rB, normal);
+				float32 K = mA + mB + b3Dot(rnA, iA * rnA) + b3Dot(rnB, iB * rnB);
+
+				// Compute normal impulse.
+				float32 impulse = K > 0.0f ? -C / K : 0.0f;
+				b3Vec3 P = impulse * normal;
+
+				cA -= mA * P;
+				qA -= b3Derivative(qA, iA * b3Cross(rA, P));
+				qA.Normalize();
+
+				cB += mB * P;
+				qB += b3Derivative(qB, iB * b3Cross(rB, P));
+				qB.Normalize();
+			}
+		}
+
+		m_positions[indexA].x = cA;
+		m_positions[indexA].q = qA;
+
+		m_positions[indexB].x = cB;
+		m_positions[indexB].q = qB;
+	}
+
+	return minError >= -0.5f * B3_LINEAR_SLOP;
+}
\ No newline at end of file
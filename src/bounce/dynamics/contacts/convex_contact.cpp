@@ -57,7 +57,23 @@ void b3ConvexContact::Collide()
 	b3Body* bodyB = shapeB->GetBody();
 	b3Transform xfB = bodyB->GetTransform();
 
+	float32 margin = ComputeSpeculativeMargin();
+
 	B3_ASSERT(m_manifoldCount == 0);
-	b3CollideShapeAndShape(m_stackManifold, xfA, shapeA, xfB, shapeB, &m_cache);
+	b3CollideShapeAndShape(m_stackManifold, xfA, shapeA, xfB, shapeB, &m_cache, margin);
 	m_manifoldCount = 1;
+}
+
+b3TOIOutput b3ConvexContact::ComputeTOI() const
+{
+	const b3Shape* shapeA = GetShapeA();
+	const b3Body* bodyA = shapeA->GetBody();
+
+	const b3Shape* shapeB = GetShapeB();
+	const b3Body* bodyB = shapeB->GetBody();
+
+	b3ShapeGJKProxy proxyA(shapeA, 0);
+	b3ShapeGJKProxy proxyB(shapeB, 0);
+
+	return b3TimeOfImpact(bodyA->m_sweep, proxyA, bodyB->m_sweep, proxyB, 1.0f);
 }
\ No newline at end of file
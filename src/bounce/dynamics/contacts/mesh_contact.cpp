@@ -35,14 +35,37 @@ b3MeshContact::b3MeshContact(b3Shape* shapeA, b3Shape* shapeB)
 	m_manifolds = m_stackManifolds;
 	m_manifoldCount = 0;
 
-	b3Transform xfA = shapeA->GetBody()->GetTransform();
-	b3Transform xfB = shapeB->GetBody()->GetTransform();
+	b3Body* bodyA = shapeA->GetBody();
+	b3Body* bodyB = shapeB->GetBody();
+	b3Transform xfA = bodyA->GetTransform();
+	b3Transform xfB = bodyB->GetTransform();
 
 	b3Transform xf = b3MulT(xfB, xfA);
 	
 	// The fat aabb relative to shape B's frame.
 	b3AABB3 fatAABB;
 	shapeA->ComputeAABB(&fatAABB, xf);
+
+	if (bodyA->IsBullet())
+	{
+		// Include the triangles swept over the last step.
+		b3AABB3 aabb0;
+		shapeA->ComputeAABB(&aabb0, b3MulT(xfB, bodyA->m_sweep.GetTransform(0.0f)));
+		fatAABB = b3Combine(fatAABB, aabb0);
+	}
+
+	b3World* world = bodyA->GetWorld();
+	if (world->m_speculative || bodyA->IsSpeculative() || bodyB->IsSpeculative())
+	{
+		// Include the triangles reachable in the next step.
+		b3Transform xfA1 = xfA;
+		xfA1.position += world->m_dt * bodyA->m_linearVelocity;
+
+		b3AABB3 aabb1;
+		shapeA->ComputeAABB(&aabb1, b3MulT(xfB, xfA1));
+		fatAABB = b3Combine(fatAABB, aabb1);
+	}
+
 	fatAABB.Extend(B3_AABB_EXTENSION);
 
 	m_aabbA = fatAABB;
@@ -84,6 +107,28 @@ void b3MeshContact::SynchronizeShapes()
 	b3AABB3 aabb;
 	shapeA->ComputeAABB(&aabb, xf);
 
+	if (bodyA->IsBullet())
+	{
+		// Include the triangles swept over the last step, 
+		// so that the time of impact can find them.
+		b3AABB3 aabb0;
+		shapeA->ComputeAABB(&aabb0, b3MulT(xfB, sweepA->GetTransform(0.0f)));
+		aabb = b3Combine(aabb, aabb0);
+	}
+
+	b3World* world = bodyA->GetWorld();
+	if (world->m_speculative || bodyA->IsSpeculative() || bodyB->IsSpeculative())
+	{
+		// Include the triangles that shape A can reach in the next step, 
+		// so that the speculative contact points are created in time.
+		b3Transform xfA1 = xfA;
+		xfA1.position += world->m_dt * bodyA->m_linearVelocity;
+
+		b3AABB3 aabb1;
+		shapeA->ComputeAABB(&aabb1, b3MulT(xfB, xfA1));
+		aabb = b3Combine(aabb, aabb1);
+	}
+
 	// Update the AABB with the new (transformed) AABB and buffer move.
 	m_aabbMoved = MoveAABB(aabb, displacement);
 }
@@ -230,6 +275,8 @@ void b3MeshContact::Collide()
 	b3World* world = bodyA->GetWorld();
 	b3StackAllocator* allocator = &world->m_stackAllocator;
 
+	float32 margin = ComputeSpeculativeMargin();
+
 	// Create one manifold per triangle.
 	b3Manifold* tempManifolds = (b3Manifold*)allocator->Allocate(m_triangleCount * sizeof(b3Manifold));
 	u32 tempCount = 0;
@@ -255,7 +302,7 @@ void b3MeshContact::Collide()
 		b3Manifold* manifold = tempManifolds + tempCount;
 		manifold->Initialize();
 		
-		b3CollideShapeAndShape(*manifold, xfA, shapeA, xfB, &hullShapeB, &triangleCache->cache);
+		b3CollideShapeAndShape(*manifold, xfA, shapeA, xfB, &hullShapeB, &triangleCache->cache, margin);
 		
 		for (u32 j = 0; j < manifold->pointCount; ++j)
 		{
@@ -272,4 +319,55 @@ void b3MeshContact::Collide()
 	clusterSolver.Run(m_stackManifolds, m_manifoldCount, tempManifolds, tempCount, xfA, shapeA->m_radius, xfB, B3_HULL_RADIUS);
 	
 	allocator->Free(tempManifolds);
+}
+
+b3TOIOutput b3MeshContact::ComputeTOI() const
+{
+	const b3Shape* shapeA = GetShapeA();
+	const b3Body* bodyA = shapeA->GetBody();
+
+	const b3Shape* shapeB = GetShapeB();
+	const b3Body* bodyB = shapeB->GetBody();
+
+	b3ShapeGJKProxy proxyA(shapeA, 0);
+
+	// Find the earliest time of impact against the triangles 
+	// potentially overlapping with the swept shape A.
+	b3TOIOutput output;
+	output.state = e_toiSeparated;
+	output.t = 1.0f;
+	output.iterations = 0;
+
+	bool overlapped = false;
+	for (u32 i = 0; i < m_triangleCount; ++i)
+	{
+		b3ShapeGJKProxy proxyB(shapeB, m_triangles[i].index);
+
+		b3TOIOutput triangleOutput = b3TimeOfImpact(bodyA->m_sweep, proxyA, bodyB->m_sweep, proxyB, 1.0f);
+		output.iterations += triangleOutput.iterations;
+
+		if (triangleOutput.state == e_toiOverlapped)
+		{
+			overlapped = true;
+			continue;
+		}
+
+		if (triangleOutput.state == e_toiTouching || triangleOutput.state == e_toiFailed)
+		{
+			if (triangleOutput.t < output.t)
+			{
+				output.state = triangleOutput.state;
+				output.t = triangleOutput.t;
+			}
+		}
+	}
+
+	if (output.state == e_toiSeparated && overlapped)
+	{
+		// Shape A already touches the mesh. This is handled by the discrete collision.
+		output.state = e_toiOverlapped;
+		output.t = 0.0f;
+	}
+
+	return output;
 }
\ No newline at end of file
@@ -23,11 +23,27 @@
 #include <bounce/dynamics/joints/joint_solver.h>
 #include <bounce/dynamics/contacts/contact.h>
 #include <bounce/dynamics/contacts/contact_solver.h>
+#include <bounce/dynamics/shapes/shape.h>
 #include <bounce/common/memory/stack_allocator.h>
+#include <bounce/common/job_system.h>
+
+// The data needed to integrate the velocity of a body.
+struct b3SolverMotion
+{
+	b3Vec3 force;
+	b3Vec3 torque;
+	b3Mat33 I; // local inertia
+	float32 gravityScale;
+	float32 linearDamping;
+	float32 angularDamping;
+	bool dynamic;
+};
 
 b3Island::b3Island(b3StackAllocator* allocator, u32 bodyCapacity, u32 contactCapacity, u32 jointCapacity) 
 {
 	m_allocator = allocator;
+	m_jobSystem = NULL;
+	m_ownsArrays = true;
 	m_bodyCapacity = bodyCapacity;
 	m_contactCapacity = contactCapacity;
 	m_jointCapacity = jointCapacity;
@@ -35,22 +51,65 @@ b3Island::b3Island(b3StackAllocator* allocator, u32 bodyCapacity, u32 contactCap
 	m_bodies = (b3Body**)m_allocator->Allocate(m_bodyCapacity * sizeof(b3Body*));
 	m_velocities = (b3Velocity*)m_allocator->Allocate(m_bodyCapacity * sizeof(b3Velocity));
 	m_positions = (b3Position*)m_allocator->Allocate(m_bodyCapacity * sizeof(b3Position));
+	m_solverBodies = (b3SolverBody*)m_allocator->Allocate(m_bodyCapacity * sizeof(b3SolverBody));
+	m_motions = (b3SolverMotion*)m_allocator->Allocate(m_bodyCapacity * sizeof(b3SolverMotion));
 	m_contacts = (b3Contact**)m_allocator->Allocate(m_contactCapacity * sizeof(b3Contact*));
 	m_joints = (b3Joint**)m_allocator->Allocate(m_jointCapacity * sizeof(b3Joint*));
 
 	m_bodyCount = 0;
 	m_contactCount = 0;
 	m_jointCount = 0;
+
+	m_staticCount = 0;
+	m_colorCount = 0;
+}
+
+b3Island::b3Island(b3StackAllocator* allocator, b3JobSystem* jobSystem, b3Body** bodies, u32 bodyCount, b3Contact** contacts, u32 contactCount, b3Joint** joints, u32 jointCount)
+{
+	m_allocator = allocator;
+	m_jobSystem = jobSystem;
+	m_ownsArrays = false;
+	m_bodyCapacity = bodyCount;
+	m_contactCapacity = contactCount;
+	m_jointCapacity = jointCount;
+
+	m_bodies = bodies;
+	m_contacts = contacts;
+	m_joints = joints;
+
+	m_bodyCount = bodyCount;
+	m_contactCount = contactCount;
+	m_jointCount = jointCount;
+
+	m_staticCount = 0;
+	m_colorCount = 0;
+	if (m_jobSystem)
+	{
+		m_staticCount = CountStaticConstraints();
+	}
+
+	m_velocities = (b3Velocity*)m_allocator->Allocate((m_bodyCapacity + m_staticCount) * sizeof(b3Velocity));
+	m_positions = (b3Position*)m_allocator->Allocate((m_bodyCapacity + m_staticCount) * sizeof(b3Position));
+	m_solverBodies = (b3SolverBody*)m_allocator->Allocate((m_bodyCapacity + m_staticCount) * sizeof(b3SolverBody));
+	m_motions = (b3SolverMotion*)m_allocator->Allocate(m_bodyCapacity * sizeof(b3SolverMotion));
 }
 
 b3Island::~b3Island() 
 {
 	// @note Reverse order of construction.
-	m_allocator->Free(m_joints);
-	m_allocator->Free(m_contacts);
+	if (m_ownsArrays)
+	{
+		m_allocator->Free(m_joints);
+		m_allocator->Free(m_contacts);
+	}
+	m_allocator->Free(m_motions);
+	m_allocator->Free(m_solverBodies);
 	m_allocator->Free(m_positions);
 	m_allocator->Free(m_velocities);
-	m_allocator->Free(m_bodies);
+	if (m_ownsArrays)
+	{
+		m_allocator->Free(m_bodies);
+	}
 }
 
 void b3Island::Clear() 
@@ -82,6 +141,354 @@ void b3Island::Add(b3Joint* j)
 	++m_jointCount;
 }
 
+void b3Island::SetConstraintIndices()
+{
+	for (u32 i = 0; i < m_contactCount; ++i)
+	{
+		b3Contact* c = m_contacts[i];
+		c->m_islandIndexA = c->GetShapeA()->GetBody()->m_islandID;
+		c->m_islandIndexB = c->GetShapeB()->GetBody()->m_islandID;
+	}
+
+	for (u32 i = 0; i < m_jointCount; ++i)
+	{
+		b3Joint* j = m_joints[i];
+		j->m_islandIndexA = j->GetBodyA()->m_islandID;
+		j->m_islandIndexB = j->GetBodyB()->m_islandID;
+	}
+}
+
+u32 b3Island::CountStaticConstraints() const
+{
+	u32 count = 0;
+
+	for (u32 i = 0; i < m_contactCount; ++i)
+	{
+		b3Contact* c = m_contacts[i];
+		count += c->GetShapeA()->GetBody()->m_type == e_staticBody;
+		count += c->GetShapeB()->GetBody()->m_type == e_staticBody;
+	}
+
+	for (u32 i = 0; i < m_jointCount; ++i)
+	{
+		b3Joint* j = m_joints[i];
+		count += j->GetBodyA()->m_type == e_staticBody;
+		count += j->GetBodyB()->m_type == e_staticBody;
+	}
+
+	return count;
+}
+
+void b3Island::CopyStaticStates()
+{
+	u32 index = m_bodyCount;
+
+	for (u32 i = 0; i < m_contactCount; ++i)
+	{
+		b3Contact* c = m_contacts[i];
+		
+		if (c->GetShapeA()->GetBody()->m_type == e_staticBody)
+		{
+			m_velocities[index] = m_velocities[c->m_islandIndexA];
+			m_positions[index] = m_positions[c->m_islandIndexA];
+			m_solverBodies[index] = m_solverBodies[c->m_islandIndexA];
+			c->m_islandIndexA = index;
+			++index;
+		}
+
+		if (c->GetShapeB()->GetBody()->m_type == e_staticBody)
+		{
+			m_velocities[index] = m_velocities[c->m_islandIndexB];
+			m_positions[index] = m_positions[c->m_islandIndexB];
+			m_solverBodies[index] = m_solverBodies[c->m_islandIndexB];
+			c->m_islandIndexB = index;
+			++index;
+		}
+	}
+
+	for (u32 i = 0; i < m_jointCount; ++i)
+	{
+		b3Joint* j = m_joints[i];
+
+		if (j->GetBodyA()->m_type == e_staticBody)
+		{
+			m_velocities[index] = m_velocities[j->m_islandIndexA];
+			m_positions[index] = m_positions[j->m_islandIndexA];
+			m_solverBodies[index] = m_solverBodies[j->m_islandIndexA];
+			j->m_islandIndexA = index;
+			++index;
+		}
+
+		if (j->GetBodyB()->m_type == e_staticBody)
+		{
+			m_velocities[index] = m_velocities[j->m_islandIndexB];
+			m_positions[index] = m_positions[j->m_islandIndexB];
+			m_solverBodies[index] = m_solverBodies[j->m_islandIndexB];
+			j->m_islandIndexB = index;
+			++index;
+		}
+	}
+
+	B3_ASSERT(index == m_bodyCount + m_staticCount);
+}
+
+// Find the first color that doesn't use the non-static bodies of a constraint and 
+// add the bodies to the color. 
+// Return the overflow color if there is no such color.
+static u32 b3FindColor(u32* colorBodies, u32 wordCount, u32 colorCount, const b3Body* bodyA, u32 indexA, const b3Body* bodyB, u32 indexB)
+{
+	bool staticA = bodyA->GetType() == e_staticBody;
+	bool staticB = bodyB->GetType() == e_staticBody;
+
+	u32 wordA = indexA / 32, bitA = 1u << (indexA % 32);
+	u32 wordB = indexB / 32, bitB = 1u << (indexB % 32);
+
+	for (u32 color = 0; color < colorCount; ++color)
+	{
+		u32* bodies = colorBodies + color * wordCount;
+
+		if (staticA == false && (bodies[wordA] & bitA))
+		{
+			continue;
+		}
+
+		if (staticB == false && (bodies[wordB] & bitB))
+		{
+			continue;
+		}
+
+		if (staticA == false)
+		{
+			bodies[wordA] |= bitA;
+		}
+
+		if (staticB == false)
+		{
+			bodies[wordB] |= bitB;
+		}
+
+		return color;
+	}
+
+	return colorCount;
+}
+
+void b3Island::ColorConstraints()
+{
+	// The bodies used by each color, one bit per body.
+	u32 wordCount = (m_bodyCount + 31) / 32;
+	u32* colorBodies = (u32*)m_allocator->Allocate(e_maxColors * wordCount * sizeof(u32));
+	memset(colorBodies, 0, e_maxColors * wordCount * sizeof(u32));
+
+	u32* jointColors = (u32*)m_allocator->Allocate(m_jointCount * sizeof(u32));
+	u32* contactColors = (u32*)m_allocator->Allocate(m_contactCount * sizeof(u32));
+
+	// The constraint counts of the colors and the overflow color.
+	u32 jointCounts[e_maxColors + 1];
+	u32 contactCounts[e_maxColors + 1];
+	for (u32 i = 0; i < e_maxColors + 1; ++i)
+	{
+		jointCounts[i] = 0;
+		contactCounts[i] = 0;
+	}
+
+	// The indices of the static bodies were replaced by their copies, 
+	// so use the island indices of the bodies.
+	for (u32 i = 0; i < m_jointCount; ++i)
+	{
+		b3Joint* j = m_joints[i];
+		b3Body* bodyA = j->GetBodyA();
+		b3Body* bodyB = j->GetBodyB();
+		
+		u32 color = b3FindColor(colorBodies, wordCount, e_maxColors, bodyA, bodyA->m_islandID, bodyB, bodyB->m_islandID);
+		jointColors[i] = color;
+		++jointCounts[color];
+	}
+
+	for (u32 i = 0; i < m_contactCount; ++i)
+	{
+		b3Contact* c = m_contacts[i];
+		b3Body* bodyA = c->GetShapeA()->GetBody();
+		b3Body* bodyB = c->GetShapeB()->GetBody();
+		
+		u32 color = b3FindColor(colorBodies, wordCount, e_maxColors, bodyA, bodyA->m_islandID, bodyB, bodyB->m_islandID);
+		contactColors[i] = color;
+		++contactCounts[color];
+	}
+
+	m_colorCount = 0;
+	m_jointColors[0] = 0;
+	m_contactColors[0] = 0;
+	for (u32 i = 0; i < e_maxColors + 1; ++i)
+	{
+		m_jointColors[i + 1] = m_jointColors[i] + jointCounts[i];
+		m_contactColors[i + 1] = m_contactColors[i] + contactCounts[i];
+
+		if (i < e_maxColors && jointCounts[i] + contactCounts[i] > 0)
+		{
+			m_colorCount = i + 1;
+		}
+	}
+
+	// Sort the constraints by color. 
+	// The order of the constraints inside a color is kept.
+	{
+		b3Joint** joints = (b3Joint**)m_allocator->Allocate(m_jointCount * sizeof(b3Joint*));
+		
+		u32 offsets[e_maxColors + 1];
+		memcpy(offsets, m_jointColors, sizeof(offsets));
+		for (u32 i = 0; i < m_jointCount; ++i)
+		{
+			joints[offsets[jointColors[i]]++] = m_joints[i];
+		}
+		memcpy(m_joints, joints, m_jointCount * sizeof(b3Joint*));
+
+		m_allocator->Free(joints);
+	}
+
+	{
+		b3Contact** contacts = (b3Contact**)m_allocator->Allocate(m_contactCount * sizeof(b3Contact*));
+
+		u32 offsets[e_maxColors + 1];
+		memcpy(offsets, m_contactColors, sizeof(offsets));
+		for (u32 i = 0; i < m_contactCount; ++i)
+		{
+			contacts[offsets[contactColors[i]]++] = m_contacts[i];
+		}
+		memcpy(m_contacts, contacts, m_contactCount * sizeof(b3Contact*));
+
+		m_allocator->Free(contacts);
+	}
+
+	m_allocator->Free(contactColors);
+	m_allocator->Free(jointColors);
+	m_allocator->Free(colorBodies);
+}
+
+// The constraints of a color. 
+// The joints come before the contacts.
+struct b3ColorSolveContext
+{
+	b3ContactSolver* contactSolver;
+	b3JointSolver* jointSolver;
+	u32 jointIndex;
+	u32 jointCount;
+	u32 contactIndex;
+	bool* solved;
+};
+
+static void b3SolveColorVelocities(void* context, u32 begin, u32 end, u32 threadIndex)
+{
+	B3_NOT_USED(threadIndex);
+
+	b3ColorSolveContext* color = (b3ColorSolveContext*)context;
+
+	u32 jointEnd = b3Min(end, color->jointCount);
+	if (begin < jointEnd)
+	{
+		color->jointSolver->SolveVelocityConstraints(color->jointIndex + begin, color->jointIndex + jointEnd);
+	}
+
+	u32 contactBegin = b3Max(begin, color->jointCount);
+	if (contactBegin < end)
+	{
+		u32 index = color->contactIndex - color->jointCount;
+		color->contactSolver->SolveVelocityConstraints(index + contactBegin, index + end);
+	}
+}
+
+static void b3SolveColorPositions(void* context, u32 begin, u32 end, u32 threadIndex)
+{
+	b3ColorSolveContext* color = (b3ColorSolveContext*)context;
+
+	bool solved = true;
+
+	u32 jointEnd = b3Min(end, color->jointCount);
+	if (begin < jointEnd)
+	{
+		bool jointsSolved = color->jointSolver->SolvePositionConstraints(color->jointIndex + begin, color->jointIndex + jointEnd);
+		solved = solved && jointsSolved;
+	}
+
+	u32 contactBegin = b3Max(begin, color->jointCount);
+	if (contactBegin < end)
+	{
+		u32 index = color->contactIndex - color->jointCount;
+		bool contactsSolved = color->contactSolver->SolvePositionConstraints(index + contactBegin, index + end);
+		solved = solved && contactsSolved;
+	}
+
+	if (solved == false)
+	{
+		color->solved[threadIndex] = false;
+	}
+}
+
+// The minimum number of constraints solved by a task.
+static const u32 b3_minColorRange = 64;
+
+void b3Island::SolveColoredVelocities(b3ContactSolver* contactSolver, b3JointSolver* jointSolver)
+{
+	b3ColorSolveContext color;
+	color.contactSolver = contactSolver;
+	color.jointSolver = jointSolver;
+	color.solved = NULL;
+
+	for (u32 i = 0; i < m_colorCount; ++i)
+	{
+		color.jointIndex = m_jointColors[i];
+		color.jointCount = m_jointColors[i + 1] - m_jointColors[i];
+		color.contactIndex = m_contactColors[i];
+		u32 contactCount = m_contactColors[i + 1] - m_contactColors[i];
+
+		m_jobSystem->ParallelFor(b3SolveColorVelocities, &color, color.jointCount + contactCount, b3_minColorRange);
+	}
+
+	// Solve the overflow on this thread.
+	jointSolver->SolveVelocityConstraints(m_jointColors[e_maxColors], m_jointColors[e_maxColors + 1]);
+	contactSolver->SolveVelocityConstraints(m_contactColors[e_maxColors], m_contactColors[e_maxColors + 1]);
+}
+
+bool b3Island::SolveColoredPositions(b3ContactSolver* contactSolver, b3JointSolver* jointSolver)
+{
+	// Each thread clears its own flag if its constraints aren't solved.
+	u32 threadCount = m_jobSystem->GetThreadCount();
+	bool* solved = (bool*)m_allocator->Allocate(threadCount * sizeof(bool));
+	for (u32 i = 0; i < threadCount; ++i)
+	{
+		solved[i] = true;
+	}
+
+	b3ColorSolveContext color;
+	color.contactSolver = contactSolver;
+	color.jointSolver = jointSolver;
+	color.solved = solved;
+
+	for (u32 i = 0; i < m_colorCount; ++i)
+	{
+		color.jointIndex = m_jointColors[i];
+		color.jointCount = m_jointColors[i + 1] - m_jointColors[i];
+		color.contactIndex = m_contactColors[i];
+		u32 contactCount = m_contactColors[i + 1] - m_contactColors[i];
+
+		m_jobSystem->ParallelFor(b3SolveColorPositions, &color, color.jointCount + contactCount, b3_minColorRange);
+	}
+
+	// Solve the overflow on this thread.
+	bool contactsSolved = contactSolver->SolvePositionConstraints(m_contactColors[e_maxColors], m_contactColors[e_maxColors + 1]);
+	bool jointsSolved = jointSolver->SolvePositionConstraints(m_jointColors[e_maxColors], m_jointColors[e_maxColors + 1]);
+
+	bool positionsSolved = contactsSolved && jointsSolved;
+	for (u32 i = 0; i < threadCount; ++i)
+	{
+		positionsSolved = positionsSolved && solved[i];
+	}
+
+	m_allocator->Free(solved);
+
+	return positionsSolved;
+}
+
 // Box2D
 static B3_FORCE_INLINE b3Vec3 b3SolveGyro(const b3Quat& q, const b3Mat33& Ib, const b3Vec3& w1, float32 h)
 {
@@ -104,78 +511,218 @@ static B3_FORCE_INLINE b3Vec3 b3SolveGyro(const b3Quat& q, const b3Mat33& Ib, co
 	return w2;
 }
 
-void b3Island::Solve(const b3Vec3& gravity, float32 dt, u32 velocityIterations, u32 positionIterations, u32 flags)
+void b3Island::CopyBodies()
 {
-	float32 h = dt;
-
-	// 1. Integrate velocities
 	for (u32 i = 0; i < m_bodyCount; ++i) 
 	{
 		b3Body* b = m_bodies[i];
 
-		b3Vec3 v = b->m_linearVelocity;
-		b3Vec3 w = b->m_angularVelocity;
-		b3Vec3 x = b->m_sweep.worldCenter;
-		b3Quat q = b->m_sweep.orientation;
-
-		// Remember the positions for CCD
-		b->m_sweep.worldCenter0 = b->m_sweep.worldCenter;
-		b->m_sweep.orientation0 = b->m_sweep.orientation;
+		m_velocities[i].v = b->m_linearVelocity;
+		m_velocities[i].w = b->m_angularVelocity;
+		m_positions[i].x = b->m_sweep.worldCenter;
+		m_positions[i].q = b->m_sweep.orientation;
+
+		b3SolverBody* body = m_solverBodies + i;
+		body->invMass = b->m_invMass;
+		body->invI = b->m_worldInvI;
+		body->localCenter = b->m_sweep.localCenter;
+
+		b3SolverMotion* motion = m_motions + i;
+		motion->force = b->m_force;
+		motion->torque = b->m_torque;
+		motion->I = b->m_I;
+		motion->gravityScale = b->m_gravityScale;
+		motion->linearDamping = b->m_linearDamping;
+		motion->angularDamping = b->m_angularDamping;
+		motion->dynamic = b->m_type == e_dynamicBody;
+	}
+}
 
-		if (b->m_type == e_dynamicBody) 
+void b3Island::IntegrateVelocities(const b3Vec3& gravity, float32 h)
+{
+	for (u32 i = 0; i < m_bodyCount; ++i) 
+	{
+		const b3SolverBody* body = m_solverBodies + i;
+		const b3SolverMotion* motion = m_motions + i;
+		if (motion->dynamic == false)
 		{
-			// Integrate forces
-			v += h * (b->m_gravityScale * gravity + b->m_invMass * b->m_force);
-			
-			// Clear forces
-			b->m_force.SetZero();
-			
-			// Integrate torques
-			
-			// Superposition Principle
-			// w2 - w1 = dw1 + dw2 
-			// w2 - w1 = h * I^1 * bt + h * I^1 * -gt
-			// w2 = w1 + dw1 + dw2
-						
-			// Explicit Euler on current inertia and applied torque
-			// w2 = w1 + h * I1^1 * bt1
-			b3Vec3 dw1 = h * b->m_worldInvI * b->m_torque;
-			
-			// Implicit Euler on next inertia and angular velocity
-			// w2 = w1 - h * I2^1 * cross(w2, I2 * w2)
-			// w2 - w1 = -I2^1 * h * cross(w2, I2 * w2)
-			// I2 * (w2 - w1) = -h * cross(w2, I2 * w2)
-			// I2 * (w2 - w1) + h * cross(w2, I2 * w2) = 0
-			// Toss out I2 from f using local I2 (constant) and local w1 
-			// to remove its time dependency.
-			b3Vec3 w2 = b3SolveGyro(q, b->m_I, w, h);
-			b3Vec3 dw2 = w2 - w;
-
-			w += dw1 + dw2;
-			
-			// Clear torques
-			b->m_torque.SetZero();
-			
-			// Apply local damping.
-			// ODE: dv/dt + c * v = 0
-			// Solution: v(t) = v0 * exp(-c * t)
-			// Step: v(t + dt) = v0 * exp(-c * (t + dt)) = v0 * exp(-c * t) * exp(-c * dt) = v * exp(-c * dt)
-			// v2 = exp(-c * dt) * v1
-			// Padé approximation:
-			// 1 / (1 + c * dt) 
-			v *= 1.0f / (1.0f + h * b->m_linearDamping);
-			w *= 1.0f / (1.0f + h * b->m_angularDamping);
+			continue;
 		}
 
+		b3Vec3 v = m_velocities[i].v;
+		b3Vec3 w = m_velocities[i].w;
+		b3Quat q = m_positions[i].q;
+
+		// Integrate forces
+		v += h * (motion->gravityScale * gravity + body->invMass * motion->force);
+		
+		// Integrate torques
+		
+		// Superposition Principle
+		// w2 - w1 = dw1 + dw2 
+		// w2 - w1 = h * I^1 * bt + h * I^1 * -gt
+		// w2 = w1 + dw1 + dw2
+					
+		// Explicit Euler on current inertia and applied torque
+		// w2 = w1 + h * I1^1 * bt1
+		b3Vec3 dw1 = h * body->invI * motion->torque;
+		
+		// Implicit Euler on next inertia and angular velocity
+		// w2 = w1 - h * I2^1 * cross(w2, I2 * w2)
+		// w2 - w1 = -I2^1 * h * cross(w2, I2 * w2)
+		// I2 * (w2 - w1) = -h * cross(w2, I2 * w2)
+		// I2 * (w2 - w1) + h * cross(w2, I2 * w2) = 0
+		// Toss out I2 from f using local I2 (constant) and local w1 
+		// to remove its time dependency.
+		b3Vec3 w2 = b3SolveGyro(q, motion->I, w, h);
+		b3Vec3 dw2 = w2 - w;
+
+		w += dw1 + dw2;
+		
+		// Apply local damping.
+		// ODE: dv/dt + c * v = 0
+		// Solution: v(t) = v0 * exp(-c * t)
+		// Step: v(t + dt) = v0 * exp(-c * (t + dt)) = v0 * exp(-c * t) * exp(-c * dt) = v * exp(-c * dt)
+		// v2 = exp(-c * dt) * v1
+		// Padé approximation:
+		// 1 / (1 + c * dt) 
+		v *= 1.0f / (1.0f + h * motion->linearDamping);
+		w *= 1.0f / (1.0f + h * motion->angularDamping);
+
 		m_velocities[i].v = v;
 		m_velocities[i].w = w;
+	}
+}
+
+void b3Island::IntegratePositions(float32 h, b3Displacement* displacements)
+{
+	for (u32 i = 0; i < m_bodyCount; ++i) 
+	{
+		b3Vec3 x = m_positions[i].x;
+		b3Quat q = m_positions[i].q;
+		b3Vec3 v = m_velocities[i].v;
+		b3Vec3 w = m_velocities[i].w;
+
+		// Prevent numerical instability due to large velocity changes.		
+		b3Vec3 translation = h * v;
+		if (b3Dot(translation, translation) > B3_MAX_TRANSLATION_SQUARED)
+		{
+			float32 ratio = B3_MAX_TRANSLATION / b3Length(translation);
+			v *= ratio;
+		}
+
+		b3Vec3 rotation = h * w;
+		if (b3Dot(rotation, rotation) > B3_MAX_ROTATION_SQUARED)
+		{
+			float32 ratio = B3_MAX_ROTATION / b3Length(rotation);
+			w *= ratio;
+		}
+
+		// Integrate
+		x += h * v;
+		q = b3Integrate(q, w, h);
+
 		m_positions[i].x = x;
 		m_positions[i].q = q;
+		m_velocities[i].v = v;
+		m_velocities[i].w = w;
+
+		if (displacements)
+		{
+			displacements[i].linear += h * v;
+			displacements[i].angular += h * w;
+		}
+	}
+}
+
+void b3Island::SolveSubSteps(b3ContactSolver* contactSolver, b3JointSolver* jointSolver, const b3Vec3& gravity, float32 h, u32 subStepCount, u32 velocityIterations, u32 flags)
+{
+	// The displacements are allocated after the solvers and freed before them.
+	b3Displacement* displacements = (b3Displacement*)m_allocator->Allocate(m_bodyCount * sizeof(b3Displacement));
+	for (u32 i = 0; i < m_bodyCount; ++i)
+	{
+		displacements[i].linear.SetZero();
+		displacements[i].angular.SetZero();
+	}
+
+	for (u32 i = 0; i < subStepCount; ++i)
+	{
+		if (i > 0)
+		{
+			// The velocities of the first sub-step were integrated with the states.
+			IntegrateVelocities(gravity, h);
+
+			// Apply the impulses of the previous sub-step.
+			contactSolver->WarmStart();
+			jointSolver->WarmStart();
+		}
+
+		// Solve with bias
+		contactSolver->ComputeSubStepBiases(displacements, true);
+		for (u32 j = 0; j < velocityIterations; ++j)
+		{
+			jointSolver->SolveVelocityConstraints();
+			contactSolver->SolveVelocityConstraints();
+		}
+
+		IntegratePositions(h, displacements);
+
+		// Relax
+		// Remove the velocity added by the position bias so it doesn't turn into energy.
+		contactSolver->ComputeSubStepBiases(displacements, false);
+		jointSolver->SolveVelocityConstraints();
+		contactSolver->SolveVelocityConstraints();
+	}
+
+	m_allocator->Free(displacements);
+
+	if (flags & e_warmStartBit)
+	{
+		// Store the impulse of a full step.
+		contactSolver->ScaleImpulses(float32(subStepCount));
+		contactSolver->StoreImpulses();
+	}
+}
+
+void b3Island::Solve(const b3Vec3& gravity, float32 dt, u32 velocityIterations, u32 positionIterations, u32 subStepCount, u32 flags)
+{
+	B3_ASSERT(subStepCount > 0);
+	
+	// The colored solver doesn't sub-step.
+	B3_ASSERT(subStepCount == 1 || m_jobSystem == NULL);
+
+	float32 h = dt / float32(subStepCount);
+
+	// 1. Integrate velocities
+	for (u32 i = 0; i < m_bodyCount; ++i) 
+	{
+		b3Body* b = m_bodies[i];
+
+		// Static bodies can be on many islands solved at the same time. 
+		// Therefore they must not be modified here.
+		if (b->m_type != e_staticBody)
+		{
+			// Remember the positions for CCD
+			b->m_sweep.worldCenter0 = b->m_sweep.worldCenter;
+			b->m_sweep.orientation0 = b->m_sweep.orientation;
+			b->m_sweep.t0 = 0.0f;
+		}
+	}
+
+	CopyBodies();
+
+	IntegrateVelocities(gravity, h);
+
+	if (m_jobSystem)
+	{
+		CopyStaticStates();
+		ColorConstraints();
 	}
 
 	b3JointSolverDef jointSolverDef;
 	jointSolverDef.joints = m_joints;
 	jointSolverDef.count = m_jointCount;
+	jointSolverDef.bodies = m_solverBodies;
 	jointSolverDef.positions = m_positions;
 	jointSolverDef.velocities = m_velocities;
 	jointSolverDef.dt = h;
@@ -185,19 +732,27 @@ void b3Island::Solve(const b3Vec3& gravity, float32 dt, u32 velocityIterations,
 	contactSolverDef.allocator = m_allocator;
 	contactSolverDef.contacts = m_contacts;
 	contactSolverDef.count = m_contactCount;
+	contactSolverDef.bodies = m_solverBodies;
 	contactSolverDef.positions = m_positions;
 	contactSolverDef.velocities = m_velocities;
 	contactSolverDef.dt = h;
+	contactSolverDef.warmStart = (flags & e_warmStartBit) != 0;
+	// The colored and sub-stepped constraints are solved with the scalar solver.
+	contactSolverDef.wide = (flags & e_wideSolverBit) != 0 && m_jobSystem == NULL && subStepCount == 1;
 	b3ContactSolver contactSolver(&contactSolverDef);
 
 	// 2. Initialize constraints
 	{
-		B3_PROFILE("Initialize Constraints");
-		
 		contactSolver.InitializeConstraints();
 
 		if (flags & e_warmStartBit)
 		{
+			if (subStepCount > 1)
+			{
+				// The stored impulses are per step.
+				contactSolver.ScaleImpulses(1.0f / float32(subStepCount));
+			}
+
 			contactSolver.WarmStart();
 		}
 
@@ -209,65 +764,57 @@ void b3Island::Solve(const b3Vec3& gravity, float32 dt, u32 velocityIterations,
 		}
 	}
 
-	// 3. Solve velocity constraints
+	if (subStepCount > 1)
 	{
-		B3_PROFILE("Solve Velocity Constraints");
-
+		// 3. Solve velocity constraints and 4. integrate positions in sub-steps
+		SolveSubSteps(&contactSolver, &jointSolver, gravity, h, subStepCount, velocityIterations, flags);
+	}
+	else
+	{
+		// 3. Solve velocity constraints
 		for (u32 i = 0; i < velocityIterations; ++i)
 		{
-			jointSolver.SolveVelocityConstraints();
-			contactSolver.SolveVelocityConstraints();
+			if (m_jobSystem)
+			{
+				SolveColoredVelocities(&contactSolver, &jointSolver);
+			}
+			else
+			{
+				jointSolver.SolveVelocityConstraints();
+				contactSolver.SolveVelocityConstraints();
+			}
 		}
 
 		if (flags & e_warmStartBit)
 		{
 			contactSolver.StoreImpulses();
 		}
-	}
-
-	// 4. Integrate positions
-	for (u32 i = 0; i < m_bodyCount; ++i) 
-	{
-		b3Vec3 x = m_positions[i].x;
-		b3Quat q = m_positions[i].q;
-		b3Vec3 v = m_velocities[i].v;
-		b3Vec3 w = m_velocities[i].w;
-
-		// Prevent numerical instability due to large velocity changes.		
-		b3Vec3 translation = h * v;
-		if (b3Dot(translation, translation) > B3_MAX_TRANSLATION_SQUARED)
-		{
-			float32 ratio = B3_MAX_TRANSLATION / b3Length(translation);
-			v *= ratio;
-		}
 
-		b3Vec3 rotation = h * w;
-		if (b3Dot(rotation, rotation) > B3_MAX_ROTATION_SQUARED)
-		{
-			float32 ratio = B3_MAX_ROTATION / b3Length(rotation);
-			w *= ratio;
-		}
-
-		// Integrate
-		x += h * v;
-		q = b3Integrate(q, w, h);
-
-		m_positions[i].x = x;
-		m_positions[i].q = q;
-		m_velocities[i].v = v;
-		m_velocities[i].w = w;
+		// 4. Integrate positions
+		IntegratePositions(h, NULL);
 	}
 
+	// The speculative points bounce after the shapes have closed their gaps.
+	contactSolver.ApplySpeculativeRestitution(dt);
+
 	// 5. Solve position constraints
 	{
-		B3_PROFILE("Solve Position Constraints");
-		
 		bool positionsSolved = false;
 		for (u32 i = 0; i < positionIterations; ++i) 
 		{
-			bool contactsSolved = contactSolver.SolvePositionConstraints();
-			bool jointsSolved = jointSolver.SolvePositionConstraints();
-			if (contactsSolved && jointsSolved)
+			bool solved;
+			if (m_jobSystem)
+			{
+				solved = SolveColoredPositions(&contactSolver, &jointSolver);
+			}
+			else
+			{
+				bool contactsSolved = contactSolver.SolvePositionConstraints();
+				bool jointsSolved = jointSolver.SolvePositionConstraints();
+				solved = contactsSolved && jointsSolved;
+			}
+
+			if (solved)
 			{
 				// Early out if the position errors are small.
 				positionsSolved = true;
@@ -280,6 +827,11 @@ void b3Island::Solve(const b3Vec3& gravity, float32 dt, u32 velocityIterations,
 	for (u32 i = 0; i < m_bodyCount; ++i) 
 	{
 		b3Body* b = m_bodies[i];
+		if (b->m_type == e_staticBody)
+		{
+			continue;
+		}
+
 		b->m_sweep.worldCenter = m_positions[i].x;
 		b->m_sweep.orientation = m_positions[i].q;
 		b->m_sweep.orientation.Normalize();
@@ -288,6 +840,13 @@ void b3Island::Solve(const b3Vec3& gravity, float32 dt, u32 velocityIterations,
 		b->SynchronizeTransform();
 		// Transform body inertia to world inertia
 		b->m_worldInvI = b3RotateToFrame(b->m_invI, b->m_xf.rotation);
+
+		if (b->m_type == e_dynamicBody)
+		{
+			// Clear forces
+			b->m_force.SetZero();
+			b->m_torque.SetZero();
+		}
 	}
 
 	// 7. Put bodies under unconsiderable motion to sleep
@@ -313,7 +872,7 @@ void b3Island::Solve(const b3Vec3& gravity, float32 dt, u32 velocityIterations,
 			}
 			else 
 			{
-				b->m_sleepTime += h;
+				b->m_sleepTime += dt;
 				minSleepTime = b3Min(minSleepTime, b->m_sleepTime);
 			}
 		}
@@ -324,8 +883,114 @@ void b3Island::Solve(const b3Vec3& gravity, float32 dt, u32 velocityIterations,
 		{
 			for (u32 i = 0; i < m_bodyCount; ++i) 
 			{
-				m_bodies[i]->SetAwake(false);
+				b3Body* b = m_bodies[i];
+				if (b->m_type != e_staticBody)
+				{
+					b->SetAwake(false);
+				}
 			}
 		}
 	}
 }
+
+void b3Island::SolveTOI(float32 dt, u32 toiIndexA, u32 toiIndexB, u32 velocityIterations)
+{
+	B3_ASSERT(toiIndexA < m_bodyCount);
+	B3_ASSERT(toiIndexB < m_bodyCount);
+
+	float32 h = dt;
+
+	// 1. Copy the body states
+	for (u32 i = 0; i < m_bodyCount; ++i)
+	{
+		b3Body* b = m_bodies[i];
+		b->m_worldInvI = b3RotateToFrame(b->m_invI, b->m_xf.rotation);
+	}
+
+	CopyBodies();
+
+	b3ContactSolverDef contactSolverDef;
+	contactSolverDef.allocator = m_allocator;
+	contactSolverDef.contacts = m_contacts;
+	contactSolverDef.count = m_contactCount;
+	contactSolverDef.bodies = m_solverBodies;
+	contactSolverDef.positions = m_positions;
+	contactSolverDef.velocities = m_velocities;
+	contactSolverDef.dt = h;
+	contactSolverDef.warmStart = false;
+	contactSolverDef.wide = false;
+	b3ContactSolver contactSolver(&contactSolverDef);
+
+	contactSolver.InitializeConstraints();
+
+	// 2. Solve position constraints
+	const u32 kMaxTOIIterations = 20;
+	for (u32 i = 0; i < kMaxTOIIterations; ++i)
+	{
+		bool contactsSolved = contactSolver.SolveTOIPositionConstraints(toiIndexA, toiIndexB);
+		if (contactsSolved)
+		{
+			break;
+		}
+	}
+
+	// Leap of faith to new safe state.
+	m_bodies[toiIndexA]->m_sweep.worldCenter0 = m_positions[toiIndexA].x;
+	m_bodies[toiIndexA]->m_sweep.orientation0 = m_positions[toiIndexA].q;
+	m_bodies[toiIndexB]->m_sweep.worldCenter0 = m_positions[toiIndexB].x;
+	m_bodies[toiIndexB]->m_sweep.orientation0 = m_positions[toiIndexB].q;
+
+	// 3. Solve velocity constraints
+	// No warm starting is needed for TOI events because warm 
+	// starting impulses were applied in the discrete solver.
+	// The impulses aren't stored either.
+	contactSolver.InitializeVelocityConstraints();
+
+	for (u32 i = 0; i < velocityIterations; ++i)
+	{
+		contactSolver.SolveVelocityConstraints();
+	}
+
+	// 4. Integrate positions
+	for (u32 i = 0; i < m_bodyCount; ++i)
+	{
+		b3Vec3 x = m_positions[i].x;
+		b3Quat q = m_positions[i].q;
+		b3Vec3 v = m_velocities[i].v;
+		b3Vec3 w = m_velocities[i].w;
+
+		// Prevent numerical instability due to large velocity changes.		
+		b3Vec3 translation = h * v;
+		if (b3Dot(translation, translation) > B3_MAX_TRANSLATION_SQUARED)
+		{
+			float32 ratio = B3_MAX_TRANSLATION / b3Length(translation);
+			v *= ratio;
+		}
+
+		b3Vec3 rotation = h * w;
+		if (b3Dot(rotation, rotation) > B3_MAX_ROTATION_SQUARED)
+		{
+			float32 ratio = B3_MAX_ROTATION / b3Length(rotation);
+			w *= ratio;
+		}
+
+		// Integrate
+		x += h * v;
+		q = b3Integrate(q, w, h);
+
+		m_positions[i].x = x;
+		m_positions[i].q = q;
+		m_velocities[i].v = v;
+		m_velocities[i].w = w;
+
+		// 5. Copy state buffers back to the bodies
+		b3Body* b = m_bodies[i];
+		b->m_sweep.worldCenter = x;
+		b->m_sweep.orientation = q;
+		b->m_sweep.orientation.Normalize();
+		b->m_linearVelocity = v;
+		b->m_angularVelocity = w;
+		b->SynchronizeTransform();
+		b->m_worldInvI = b3RotateToFrame(b->m_invI, b->m_xf.rotation);
+	}
+}
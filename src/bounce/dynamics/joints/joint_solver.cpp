@@ -25,6 +25,7 @@ b3JointSolver::b3JointSolver(const b3JointSolverDef* def)
 	m_joints = def->joints;
 	m_solverData.dt = def->dt;
 	m_solverData.invdt = def->dt > 0.0f ? 1.0f / def->dt : 0.0f;
+	m_solverData.bodies = def->bodies;
 	m_solverData.positions = def->positions;
 	m_solverData.velocities = def->velocities;
 }
@@ -49,17 +50,29 @@ void b3JointSolver::WarmStart()
 
 void b3JointSolver::SolveVelocityConstraints() 
 {
-	for (u32 i = 0; i < m_count; ++i) 
+	SolveVelocityConstraints(0, m_count);
+}
+
+bool b3JointSolver::SolvePositionConstraints() 
+{
+	return SolvePositionConstraints(0, m_count);
+}
+
+void b3JointSolver::SolveVelocityConstraints(u32 begin, u32 end) 
+{
+	B3_ASSERT(end <= m_count);
+	for (u32 i = begin; i < end; ++i) 
 	{
 		b3Joint* j = m_joints[i];
 		j->SolveVelocityConstraints(&m_solverData);
 	}
 }
 
-bool b3JointSolver::SolvePositionConstraints() 
+bool b3JointSolver::SolvePositionConstraints(u32 begin, u32 end) 
 {
+	B3_ASSERT(end <= m_count);
 	bool jointsSolved = true;
-	for (u32 i = 0; i < m_count; ++i) 
+	for (u32 i = begin; i < end; ++i) 
 	{
 		b3Joint* j = m_joints[i];
 		bool jointSolved = j->SolvePositionConstraints(&m_solverData);
@@ -31,12 +31,10 @@ b3MouseJoint::b3MouseJoint(const b3MouseJointDef* def)
 
 void b3MouseJoint::InitializeConstraints(const b3SolverData* data) 
 {
-	b3Body* m_bodyB = GetBodyB();
-
-	m_indexB = m_bodyB->m_islandID;
-	m_mB = m_bodyB->m_invMass;
-	m_iB = m_bodyB->m_worldInvI;
-	m_localCenterB = m_bodyB->m_sweep.localCenter;
+	m_indexB = m_islandIndexB;
+	m_mB = data->bodies[m_indexB].invMass;
+	m_iB = data->bodies[m_indexB].invI;
+	m_localCenterB = data->bodies[m_indexB].localCenter;
 
 	b3Vec3 xB = data->positions[m_indexB].x;
 	b3Quat qB = data->positions[m_indexB].q;
@@ -96,20 +96,17 @@ void b3SpringJoint::SetDampingRatio(float32 ratio)
 
 void b3SpringJoint::InitializeConstraints(const b3SolverData* data) 
 {
-	b3Body* m_bodyA = GetBodyA();
-	b3Body* m_bodyB = GetBodyB();
+	m_indexA = m_islandIndexA;
+	m_indexB = m_islandIndexB;
 
-	m_indexA = m_bodyA->m_islandID;
-	m_indexB = m_bodyB->m_islandID;
+	m_mA = data->bodies[m_indexA].invMass;
+	m_mB = data->bodies[m_indexB].invMass;
 
-	m_mA = m_bodyA->m_invMass;
-	m_mB = m_bodyB->m_invMass;
+	m_iA = data->bodies[m_indexA].invI;
+	m_iB = data->bodies[m_indexB].invI;
 
-	m_iA = m_bodyA->m_worldInvI;
-	m_iB = m_bodyB->m_worldInvI;
-
-	m_localCenterA = m_bodyA->m_sweep.localCenter;
-	m_localCenterB = m_bodyB->m_sweep.localCenter;
+	m_localCenterA = data->bodies[m_indexA].localCenter;
+	m_localCenterB = data->bodies[m_indexB].localCenter;
 
 	b3Vec3 xA = data->positions[m_indexA].x;
 	b3Quat qA = data->positions[m_indexA].q;
@@ -174,8 +174,6 @@ struct b3MeshRayCastCallback
 {
 	float32 Report(const b3RayCastInput& subInput, u32 proxyId)
 	{
-		B3_NOT_USED(subInput);
-
 		u32 childIndex = mesh->m_mesh->tree.GetUserData(proxyId);
 		
 		b3RayCastOutput childOutput;
@@ -189,7 +187,8 @@ struct b3MeshRayCastCallback
 			}
 		}
 		
-		return 1.0f;
+		// Clip the ray to the closest hit so farther triangles are skipped.
+		return hit ? output.fraction : subInput.maxFraction;
 	}
 
 	b3RayCastInput input;
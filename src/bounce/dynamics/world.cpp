@@ -21,13 +21,21 @@
 #include <bounce/dynamics/island.h>
 #include <bounce/dynamics/world_listeners.h>
 #include <bounce/dynamics/shapes/shape.h>
+#include <bounce/dynamics/shapes/sphere_shape.h>
+#include <bounce/dynamics/shapes/capsule_shape.h>
+#include <bounce/dynamics/shapes/mesh_shape.h>
+#include <bounce/dynamics/contacts/collide/collide.h>
+#include <bounce/collision/shapes/capsule.h>
+#include <bounce/collision/shapes/mesh.h>
 #include <bounce/dynamics/contacts/contact.h>
 #include <bounce/dynamics/joints/joint.h>
 #include <bounce/dynamics/time_step.h>
+#include <bounce/common/job_system.h>
 
-extern u32 b3_allocCalls, b3_maxAllocCalls;
+extern std::atomic<u32> b3_allocCalls, b3_maxAllocCalls;
 extern u32 b3_convexCalls, b3_convexCacheHits;
 extern u32 b3_gjkCalls, b3_gjkIters, b3_gjkMaxIters;
+extern u32 b3_toiCalls, b3_toiIters, b3_toiMaxIters;
 extern bool b3_convexCache;
 
 b3World::b3World() : m_bodyBlocks(sizeof(b3Body))
@@ -38,6 +46,9 @@ b3World::b3World() : m_bodyBlocks(sizeof(b3Body))
 	b3_gjkCalls = 0;
 	b3_gjkIters = 0;
 
+	b3_toiCalls = 0;
+	b3_toiIters = 0;
+
 	b3_convexCalls = 0;
 	b3_convexCacheHits = 0;
 
@@ -46,6 +57,14 @@ b3World::b3World() : m_bodyBlocks(sizeof(b3Body))
 	m_flags = e_clearForcesFlag;
 	m_sleeping = false;
 	m_warmStarting = true;
+	m_speculative = false;
+	m_wideSolver = false;
+	m_subStepCount = 1;
+	m_dt = 0.0f;
+	m_broadPhaseOptimizeCount = 0;
+	m_jobSystem = NULL;
+	m_threadAllocators = NULL;
+	m_threadAllocatorCount = 0;
 	m_gravity.Set(0.0f, -9.8f, 0.0f);
 }
 
@@ -59,6 +78,12 @@ b3World::~b3World()
 		b->DestroyJoints();
 		b = b->m_next;
 	}
+
+	for (u32 i = 0; i < m_threadAllocatorCount; ++i)
+	{
+		m_threadAllocators[i].~b3StackAllocator();
+	}
+	b3Free(m_threadAllocators);
 	
 	b3_allocCalls = 0;
 	b3_maxAllocCalls = 0;
@@ -66,6 +91,9 @@ b3World::~b3World()
 	b3_gjkCalls = 0;
 	b3_gjkIters = 0;
 
+	b3_toiCalls = 0;
+	b3_toiIters = 0;
+
 	b3_convexCalls = 0;
 	b3_convexCacheHits = 0;
 }
@@ -125,6 +153,19 @@ void b3World::Step(float32 dt, u32 velocityIterations, u32 positionIterations)
 	b3_gjkIters = 0;
 	b3_gjkMaxIters = 0;
 
+	b3_toiCalls = 0;
+	b3_toiIters = 0;
+	b3_toiMaxIters = 0;
+
+	// The speculative contacts need the time step.
+	m_dt = dt;
+
+	if (m_broadPhaseOptimizeCount > 0)
+	{
+		// Keep the broad-phase tree optimized.
+		m_contactMan.m_broadPhase.OptimizeTree(m_broadPhaseOptimizeCount);
+	}
+
 	if (m_flags & e_shapeAddedFlag)
 	{
 		// If new shapes were added new contacts might be created.
@@ -141,7 +182,120 @@ void b3World::Step(float32 dt, u32 velocityIterations, u32 positionIterations)
 		Solve(dt, velocityIterations, positionIterations);
 	}
 
-	//SolveTOI
+	// Handle time of impact events of the bullet bodies.
+	if (dt > 0.0f)
+	{
+		SolveTOI(dt, velocityIterations);
+	}
+}
+
+// An island built by the depth first search. 
+// It refers to ranges of the island body and constraint arrays.
+struct b3IslandRange
+{
+	u32 bodyIndex;
+	u32 bodyCount;
+	u32 contactIndex;
+	u32 contactCount;
+	u32 jointIndex;
+	u32 jointCount;
+};
+
+struct b3IslandSolveContext
+{
+	b3World* world;
+	const b3IslandRange* islands;
+	b3Body** bodies;
+	b3Contact** contacts;
+	b3Joint** joints;
+	b3Vec3 gravity;
+	float32 dt;
+	u32 velocityIterations;
+	u32 positionIterations;
+	u32 subStepCount;
+	u32 flags;
+};
+
+// Islands with at least this many bodies and constraints are solved one at a time 
+// with their constraints colored and solved in parallel.
+static const u32 b3_minColoredIslandSize = 256;
+
+static B3_FORCE_INLINE bool b3IslandPredicate(const b3IslandRange& a, const b3IslandRange& b)
+{
+	// Larger islands first. 
+	// Ties are broken by the build order to keep the order deterministic.
+	u32 sizeA = a.bodyCount + a.contactCount + a.jointCount;
+	u32 sizeB = b.bodyCount + b.contactCount + b.jointCount;
+	
+	if (sizeA != sizeB)
+	{
+		return sizeA > sizeB;
+	}
+
+	return a.bodyIndex < b.bodyIndex;
+}
+
+static void b3SortIslands(b3IslandRange* islands, u32 count)
+{
+	if (count <= 1)
+	{
+		return;
+	}
+
+	// Use the middle island as the pivot. 
+	// Islands of equal size are already in build order.
+	u32 mid = count / 2;
+	b3IslandRange pivot = islands[mid];
+	islands[mid] = islands[count - 1];
+	islands[count - 1] = pivot;
+
+	u32 low = 0;
+	for (u32 i = 0; i < count - 1; ++i)
+	{
+		if (b3IslandPredicate(islands[i], pivot))
+		{
+			b3IslandRange tmp = islands[i];
+			islands[i] = islands[low];
+			islands[low] = tmp;
+			low++;
+		}
+	}
+
+	islands[count - 1] = islands[low];
+	islands[low] = pivot;
+
+	b3SortIslands(islands, low);
+	b3SortIslands(islands + low + 1, count - 1 - low);
+}
+
+b3StackAllocator* b3World::GetThreadAllocator(u32 threadIndex)
+{
+	if (threadIndex == 0)
+	{
+		return &m_stackAllocator;
+	}
+
+	B3_ASSERT(threadIndex - 1 < m_threadAllocatorCount);
+	return m_threadAllocators + threadIndex - 1;
+}
+
+void b3World::SolveIslands(void* context, u32 begin, u32 end, u32 threadIndex)
+{
+	b3IslandSolveContext* solve = (b3IslandSolveContext*)context;
+	b3StackAllocator* allocator = solve->world->GetThreadAllocator(threadIndex);
+
+	for (u32 i = begin; i < end; ++i)
+	{
+		const b3IslandRange* range = solve->islands + i;
+
+		b3Island island(allocator, NULL, 
+			solve->bodies + range->bodyIndex, range->bodyCount, 
+			solve->contacts + range->contactIndex, range->contactCount, 
+			solve->joints + range->jointIndex, range->jointCount);
+
+		// Integrate velocities, clear forces and torques, solve constraints, integrate positions.
+		island.Solve(solve->gravity, solve->dt, solve->velocityIterations, solve->positionIterations, solve->subStepCount, solve->flags);
+	}
 }
 
 void b3World::Solve(float32 dt, u32 velocityIterations, u32 positionIterations)
@@ -167,147 +321,266 @@ void b3World::Solve(float32 dt, u32 velocityIterations, u32 positionIterations)
 	u32 islandFlags = 0;
 	islandFlags |= m_warmStarting * b3Island::e_warmStartBit;
 	islandFlags |= m_sleeping * b3Island::e_sleepBit;
+	islandFlags |= m_wideSolver * b3Island::e_wideSolverBit;
 
 	b3Vec3 externalForce = m_gravity;
 
-	// Create a worst case island.
-	b3Island island(&m_stackAllocator, m_bodyList.m_count, m_contactMan.m_contactList.m_count, m_jointMan.m_jointList.m_count);
+	u32 bodyCount = m_bodyList.m_count;
+	u32 contactCount = m_contactMan.m_contactList.m_count;
+	u32 jointCount = m_jointMan.m_jointList.m_count;
+
+	// The bodies and constraints of all islands, stored one island after the other.
+	// A static body can be on many islands but it is connected to each one by a constraint.
+	b3Body** islandBodies = (b3Body**)m_stackAllocator.Allocate((bodyCount + contactCount + jointCount) * sizeof(b3Body*));
+	b3Contact** islandContacts = (b3Contact**)m_stackAllocator.Allocate(contactCount * sizeof(b3Contact*));
+	b3Joint** islandJoints = (b3Joint**)m_stackAllocator.Allocate(jointCount * sizeof(b3Joint*));
+	b3IslandRange* islands = (b3IslandRange*)m_stackAllocator.Allocate(bodyCount * sizeof(b3IslandRange));
+	u32 islandCount = 0;
+	u32 islandBodyCount = 0;
+	u32 islandContactCount = 0;
+	u32 islandJointCount = 0;
 
-	// Build and simulate awake islands.
-	u32 stackSize = m_bodyList.m_count;
-	b3Body** stack = (b3Body**)m_stackAllocator.Allocate(stackSize * sizeof(b3Body*));
-	for (b3Body* seed = m_bodyList.m_head; seed; seed = seed->m_next)
 	{
-		// The seed must not be on an island.
-		if (seed->m_flags & b3Body::e_islandFlag)
-		{
-			continue;
-		}
+		B3_PROFILE("Build Islands");
 
-		// Bodies that are sleeping are not solved for performance.
-		if (!(seed->m_flags & b3Body::e_awakeFlag))
-		{
-			continue;
-		}
+		// Create a worst case island.
+		b3Island island(&m_stackAllocator, bodyCount, contactCount, jointCount);
 
-		// The seed must be dynamic or kinematic.
-		if (seed->m_type == e_staticBody)
+		// Build the awake islands.
+		u32 stackSize = bodyCount;
+		b3Body** stack = (b3Body**)m_stackAllocator.Allocate(stackSize * sizeof(b3Body*));
+		for (b3Body* seed = m_bodyList.m_head; seed; seed = seed->m_next)
 		{
-			continue;
-		}
-
-		// Perform a depth first search on this body constraint graph.
-		island.Clear();
-		u32 stackCount = 0;
-		stack[stackCount++] = seed;
-		seed->m_flags |= b3Body::e_islandFlag;
+			// The seed must not be on an island.
+			if (seed->m_flags & b3Body::e_islandFlag)
+			{
+				continue;
+			}
 
-		while (stackCount > 0)
-		{
-			// Add this body to the island.
-			b3Body* b = stack[--stackCount];
-			island.Add(b);
-			
-			// This body must be awake.
-			b->m_flags |= b3Body::e_awakeFlag;
+			// Bodies that are sleeping are not solved for performance.
+			if (!(seed->m_flags & b3Body::e_awakeFlag))
+			{
+				continue;
+			}
 
-			// Don't propagate islands across static bodies to keep them small.
-			if (b->m_type == e_staticBody)
+			// The seed must be dynamic or kinematic.
+			if (seed->m_type == e_staticBody)
 			{
 				continue;
 			}
 
-			// Search all contacts connected to this body.
-			for (b3Shape* s = b->m_shapeList.m_head; s; s = s->m_next)
+			// Perform a depth first search on this body constraint graph.
+			island.Clear();
+			u32 stackCount = 0;
+			stack[stackCount++] = seed;
+			seed->m_flags |= b3Body::e_islandFlag;
+
+			while (stackCount > 0)
 			{
-				for (b3ContactEdge* ce = s->m_contactEdges.m_head; ce; ce = ce->m_next)
+				// Add this body to the island.
+				b3Body* b = stack[--stackCount];
+				island.Add(b);
+			
+				// This body must be awake.
+				b->m_flags |= b3Body::e_awakeFlag;
+
+				// Don't propagate islands across static bodies to keep them small.
+				if (b->m_type == e_staticBody)
 				{
-					b3Contact* contact = ce->contact;
+					continue;
+				}
 
-					// The contact must not be on an island.
-					if (contact->m_flags & b3Contact::e_islandFlag)
+				// Search all contacts connected to this body.
+				for (b3Shape* s = b->m_shapeList.m_head; s; s = s->m_next)
+				{
+					for (b3ContactEdge* ce = s->m_contactEdges.m_head; ce; ce = ce->m_next)
 					{
-						continue;
+						b3Contact* contact = ce->contact;
+
+						// The contact must not be on an island.
+						if (contact->m_flags & b3Contact::e_islandFlag)
+						{
+							continue;
+						}
+
+						// The contact must be overlapping or have speculative points.
+						if (!(contact->m_flags & (b3Contact::e_overlapFlag | b3Contact::e_speculativePointsFlag)))
+						{
+							continue;
+						}
+
+						// A sensor can't respond to contacts. 
+						bool sensorA = contact->GetShapeA()->m_isSensor;
+						bool sensorB = contact->GetShapeB()->m_isSensor;
+						if (sensorA || sensorB)
+						{
+							continue;
+						}
+
+						// Add contact to the island and mark it.
+						island.Add(contact);
+						contact->m_flags |= b3Contact::e_islandFlag;
+
+						b3Body* other = ce->other->GetBody();
+
+						// Skip adjacent vertex if it was visited.
+						if (other->m_flags & b3Body::e_islandFlag)
+						{
+							continue;
+						}
+
+						// Add the other body to the island and propagate through it.
+						B3_ASSERT(stackCount < stackSize);
+						stack[stackCount++] = other;
+						other->m_flags |= b3Body::e_islandFlag;
 					}
+				}
 
-					// The contact must be overlapping.
-					if (!(contact->m_flags & b3Contact::e_overlapFlag))
-					{
-						continue;
-					}
+				// Search all joints connected to this body.
+				for (b3JointEdge* je = b->m_jointEdges.m_head; je; je = je->m_next)
+				{
+					b3Joint* joint = je->joint;
 
-					// A sensor can't respond to contacts. 
-					bool sensorA = contact->GetShapeA()->m_isSensor;
-					bool sensorB = contact->GetShapeB()->m_isSensor;
-					if (sensorA || sensorB)
+					// The joint must not be on an island.
+					if (joint->m_flags & b3Joint::e_islandFlag)
 					{
 						continue;
 					}
 
-					// Add contact to the island and mark it.
-					island.Add(contact);
-					contact->m_flags |= b3Contact::e_islandFlag;
+					// Add joint to the island and mark it.
+					island.Add(joint);
+					joint->m_flags |= b3Joint::e_islandFlag;
 
-					b3Body* other = ce->other->GetBody();
+					b3Body* other = je->other;
 
-					// Skip adjacent vertex if it was visited.
+					// The other body must not be on an island.
 					if (other->m_flags & b3Body::e_islandFlag)
 					{
 						continue;
 					}
 
-					// Add the other body to the island and propagate through it.
+					// Push the other body onto the stack and mark it.
 					B3_ASSERT(stackCount < stackSize);
 					stack[stackCount++] = other;
 					other->m_flags |= b3Body::e_islandFlag;
 				}
 			}
 
-			// Search all joints connected to this body.
-			for (b3JointEdge* je = b->m_jointEdges.m_head; je; je = je->m_next)
+			// Store the island indices of the bodies on the constraints before 
+			// a static body of this island is added to another island.
+			island.SetConstraintIndices();
+
+			// Store the island for solving.
+			b3IslandRange* range = islands + islandCount;
+			++islandCount;
+
+			range->bodyIndex = islandBodyCount;
+			range->bodyCount = island.m_bodyCount;
+			range->contactIndex = islandContactCount;
+			range->contactCount = island.m_contactCount;
+			range->jointIndex = islandJointCount;
+			range->jointCount = island.m_jointCount;
+
+			memcpy(islandBodies + islandBodyCount, island.m_bodies, island.m_bodyCount * sizeof(b3Body*));
+			memcpy(islandContacts + islandContactCount, island.m_contacts, island.m_contactCount * sizeof(b3Contact*));
+			memcpy(islandJoints + islandJointCount, island.m_joints, island.m_jointCount * sizeof(b3Joint*));
+
+			islandBodyCount += island.m_bodyCount;
+			islandContactCount += island.m_contactCount;
+			islandJointCount += island.m_jointCount;
+
+			// Allow static bodies to participate in other islands.
+			for (u32 i = 0; i < island.m_bodyCount; ++i)
 			{
-				b3Joint* joint = je->joint;
+				b3Body* b = island.m_bodies[i];
+				if (b->m_type == e_staticBody)
+				{
+					b->m_flags &= ~b3Body::e_islandFlag;
+				}
+			}
+		}
+
+		m_stackAllocator.Free(stack);
+	}
 
-				// The joint must not be on an island.
-				if (joint->m_flags & b3Joint::e_islandFlag)
+	{
+		B3_PROFILE("Solve Islands");
+
+		b3IslandSolveContext context;
+		context.world = this;
+		context.islands = islands;
+		context.bodies = islandBodies;
+		context.contacts = islandContacts;
+		context.joints = islandJoints;
+		context.gravity = externalForce;
+		context.dt = dt;
+		context.velocityIterations = velocityIterations;
+		context.positionIterations = positionIterations;
+		context.subStepCount = m_subStepCount;
+		context.flags = islandFlags;
+
+		u32 threadCount = m_jobSystem ? m_jobSystem->GetThreadCount() : 1;
+
+		if (threadCount > 1)
+		{
+			// Each thread needs its own stack allocator.
+			if (m_threadAllocatorCount != threadCount - 1)
+			{
+				for (u32 i = 0; i < m_threadAllocatorCount; ++i)
 				{
-					continue;
+					m_threadAllocators[i].~b3StackAllocator();
 				}
+				b3Free(m_threadAllocators);
 
-				// Add joint to the island and mark it.
-				island.Add(joint);
-				joint->m_flags |= b3Joint::e_islandFlag;
+				m_threadAllocatorCount = threadCount - 1;
+				m_threadAllocators = (b3StackAllocator*)b3Alloc(m_threadAllocatorCount * sizeof(b3StackAllocator));
+				for (u32 i = 0; i < m_threadAllocatorCount; ++i)
+				{
+					new (m_threadAllocators + i) b3StackAllocator();
+				}
+			}
 
-				b3Body* other = je->other;
+			// Solve the largest islands first so the threads finish at about the same time. 
+			// The islands don't share any modified state, so the results 
+			// don't depend on the order they are solved.
+			b3SortIslands(islands, islandCount);
 
-				// The other body must not be on an island.
-				if (other->m_flags & b3Body::e_islandFlag)
+			// A large island would keep a single thread busy while the others are idle. 
+			// Solve its constraints in parallel, one color at a time. 
+			// The colored solver doesn't sub-step.
+			u32 largeCount = 0;
+			while (m_subStepCount == 1 && largeCount < islandCount)
+			{
+				const b3IslandRange* range = islands + largeCount;
+				if (range->bodyCount + range->contactCount + range->jointCount < b3_minColoredIslandSize)
 				{
-					continue;
+					break;
 				}
 
-				// Push the other body onto the stack and mark it.
-				B3_ASSERT(stackCount < stackSize);
-				stack[stackCount++] = other;
-				other->m_flags |= b3Body::e_islandFlag;
+				b3Island island(&m_stackAllocator, m_jobSystem, 
+					islandBodies + range->bodyIndex, range->bodyCount, 
+					islandContacts + range->contactIndex, range->contactCount, 
+					islandJoints + range->jointIndex, range->jointCount);
+
+				island.Solve(externalForce, dt, velocityIterations, positionIterations, 1, islandFlags);
+				
+				++largeCount;
 			}
-		}
 
-		// Integrate velocities, clear forces and torques, solve constraints, integrate positions.
-		island.Solve(externalForce, dt, velocityIterations, positionIterations, islandFlags);
-		
-		// Allow static bodies to participate in other islands.
-		for (u32 i = 0; i < island.m_bodyCount; ++i)
+			// Solve the remaining islands in parallel.
+			context.islands = islands + largeCount;
+			m_jobSystem->ParallelFor(SolveIslands, &context, islandCount - largeCount, 1);
+		}
+		else
 		{
-			b3Body* b = island.m_bodies[i];
-			if (b->m_type == e_staticBody)
-			{
-				b->m_flags &= ~b3Body::e_islandFlag;
-			}
+			SolveIslands(&context, 0, islandCount, 0);
 		}
 	}
 
-	m_stackAllocator.Free(stack);
+	m_stackAllocator.Free(islands);
+	m_stackAllocator.Free(islandJoints);
+	m_stackAllocator.Free(islandContacts);
+	m_stackAllocator.Free(islandBodies);
 
 	{
 		B3_PROFILE("Find New Pairs");
@@ -337,6 +610,315 @@ void b3World::Solve(float32 dt, u32 velocityIterations, u32 positionIterations)
 	}
 }
 
+void b3World::SolveTOI(float32 dt, u32 velocityIterations)
+{
+	B3_PROFILE("Solve TOI");
+
+	// Collect the bullets. 
+	// Only the contacts of the awake bullets are checked for time of impact.
+	b3Body** bullets = (b3Body**)m_stackAllocator.Allocate(m_bodyList.m_count * sizeof(b3Body*));
+	u32 bulletCount = 0;
+	for (b3Body* b = m_bodyList.m_head; b; b = b->m_next)
+	{
+		b->m_flags &= ~b3Body::e_islandFlag;
+		b->m_sweep.t0 = 0.0f;
+
+		if ((b->m_flags & b3Body::e_awakeFlag) == 0)
+		{
+			// A sleeping body didn't move in this step.
+			b->m_sweep.worldCenter0 = b->m_sweep.worldCenter;
+			b->m_sweep.orientation0 = b->m_sweep.orientation;
+			continue;
+		}
+
+		if (b->m_type == e_dynamicBody && (b->m_flags & b3Body::e_bulletFlag))
+		{
+			bullets[bulletCount++] = b;
+		}
+	}
+
+	if (bulletCount == 0)
+	{
+		m_stackAllocator.Free(bullets);
+		return;
+	}
+
+	// Invalidate the cached time of impacts.
+	for (b3Contact* c = m_contactMan.m_contactList.m_head; c; c = c->m_next)
+	{
+		c->m_flags &= ~(b3Contact::e_toiFlag | b3Contact::e_islandFlag | b3Contact::e_toiDisabledFlag);
+		c->m_toi.t = 1.0f;
+		c->m_toi.count = 0;
+	}
+
+	{
+		b3Island island(&m_stackAllocator, 2 * B3_MAX_TOI_CONTACTS, B3_MAX_TOI_CONTACTS, 0);
+
+		// Find time of impact events and solve them in time order.
+		for (;;)
+		{
+			// Find the first time of impact.
+			b3Contact* minContact = NULL;
+			float32 minAlpha = 1.0f;
+
+			for (u32 i = 0; i < bulletCount; ++i)
+			{
+				b3Body* bullet = bullets[i];
+				for (b3Shape* s = bullet->m_shapeList.m_head; s; s = s->m_next)
+				{
+					for (b3ContactEdge* ce = s->m_contactEdges.m_head; ce; ce = ce->m_next)
+					{
+						b3Contact* c = ce->contact;
+
+						// Prevent excessive sub-stepping.
+						if (c->m_toi.count > B3_MAX_SUB_STEPS)
+						{
+							continue;
+						}
+
+						if (c->m_flags & b3Contact::e_toiDisabledFlag)
+						{
+							continue;
+						}
+
+						float32 alpha = 1.0f;
+						if (c->m_flags & b3Contact::e_toiFlag)
+						{
+							// This contact has a valid cached time of impact.
+							alpha = c->m_toi.t;
+						}
+						else
+						{
+							b3Shape* shapeA = c->GetShapeA();
+							b3Shape* shapeB = c->GetShapeB();
+
+							// A sensor can't respond to contacts.
+							if (shapeA->m_isSensor || shapeB->m_isSensor)
+							{
+								continue;
+							}
+
+							b3Body* bodyA = shapeA->GetBody();
+							b3Body* bodyB = shapeB->GetBody();
+
+							// Put the sweeps onto the same time interval.
+							float32 alpha0 = bodyA->m_sweep.t0;
+							if (bodyA->m_sweep.t0 < bodyB->m_sweep.t0)
+							{
+								alpha0 = bodyB->m_sweep.t0;
+								bodyA->m_sweep.Advance(alpha0);
+							}
+							else if (bodyB->m_sweep.t0 < bodyA->m_sweep.t0)
+							{
+								alpha0 = bodyA->m_sweep.t0;
+								bodyB->m_sweep.Advance(alpha0);
+							}
+
+							B3_ASSERT(alpha0 < 1.0f);
+
+							b3TOIOutput output = c->ComputeTOI();
+
+							// The time of impact is a fraction of the remaining step.
+							// If the root finder failed the time is still safe to advance to.
+							if (output.state == e_toiTouching || output.state == e_toiFailed)
+							{
+								alpha = b3Min(alpha0 + (1.0f - alpha0) * output.t, 1.0f);
+							}
+
+							c->m_toi.t = alpha;
+							c->m_flags |= b3Contact::e_toiFlag;
+						}
+
+						if (alpha < minAlpha)
+						{
+							// This is the minimum time of impact so far.
+							minContact = c;
+							minAlpha = alpha;
+						}
+					}
+				}
+			}
+
+			if (minContact == NULL || 1.0f - 10.0f * B3_EPSILON < minAlpha)
+			{
+				// No more time of impact events.
+				break;
+			}
+
+			// Advance the bodies to the time of impact.
+			b3Body* bodyA = minContact->GetShapeA()->GetBody();
+			b3Body* bodyB = minContact->GetShapeB()->GetBody();
+
+			b3Sweep backupA = bodyA->m_sweep;
+			b3Sweep backupB = bodyB->m_sweep;
+
+			bodyA->Advance(minAlpha);
+			bodyB->Advance(minAlpha);
+
+			// The time of impact contact likely has some new contact points.
+			minContact->Update(m_contactMan.m_contactListener);
+			minContact->m_flags &= ~b3Contact::e_toiFlag;
+			++minContact->m_toi.count;
+
+			if (minContact->IsOverlapping() == false)
+			{
+				// The shapes don't touch at the time of impact, so it is safe to start 
+				// the sweeps there. Restore the sweeps and look for the next time of impact.
+				// The time of impact would likely be found at the same time again, 
+				// for example when the shapes approach mostly by rotation, so 
+				// ignore this contact for the rest of the step.
+				minContact->m_flags |= b3Contact::e_toiDisabledFlag;
+				bodyA->m_sweep = backupA;
+				bodyB->m_sweep = backupB;
+				bodyA->m_sweep.Advance(minAlpha);
+				bodyB->m_sweep.Advance(minAlpha);
+				bodyA->SynchronizeTransform();
+				bodyB->SynchronizeTransform();
+				continue;
+			}
+
+			bodyA->SetAwake(true);
+			bodyB->SetAwake(true);
+
+			// Build the time of impact island.
+			island.Clear();
+			island.Add(bodyA);
+			island.Add(bodyB);
+			island.Add(minContact);
+
+			bodyA->m_flags |= b3Body::e_islandFlag;
+			bodyB->m_flags |= b3Body::e_islandFlag;
+			minContact->m_flags |= b3Contact::e_islandFlag;
+
+			// Add the contacts of the dynamic bodies to the island.
+			b3Body* bodies[2] = { bodyA, bodyB };
+			for (u32 i = 0; i < 2; ++i)
+			{
+				b3Body* body = bodies[i];
+				if (body->m_type != e_dynamicBody)
+				{
+					continue;
+				}
+
+				for (b3Shape* s = body->m_shapeList.m_head; s; s = s->m_next)
+				{
+					for (b3ContactEdge* ce = s->m_contactEdges.m_head; ce; ce = ce->m_next)
+					{
+						if (island.m_bodyCount == island.m_bodyCapacity)
+						{
+							break;
+						}
+
+						if (island.m_contactCount == island.m_contactCapacity)
+						{
+							break;
+						}
+
+						b3Contact* contact = ce->contact;
+
+						// The contact must not be on the island.
+						if (contact->m_flags & b3Contact::e_islandFlag)
+						{
+							continue;
+						}
+
+						// Only add static, kinematic, or bullet bodies.
+						b3Body* other = ce->other->GetBody();
+						if (other->m_type == e_dynamicBody && body->IsBullet() == false && other->IsBullet() == false)
+						{
+							continue;
+						}
+
+						// A sensor can't respond to contacts.
+						bool sensorA = contact->GetShapeA()->m_isSensor;
+						bool sensorB = contact->GetShapeB()->m_isSensor;
+						if (sensorA || sensorB)
+						{
+							continue;
+						}
+
+						// Tentatively advance the other body to the time of impact.
+						b3Sweep backup = other->m_sweep;
+						if ((other->m_flags & b3Body::e_islandFlag) == 0)
+						{
+							other->Advance(minAlpha);
+						}
+
+						// Update the contact points.
+						contact->Update(m_contactMan.m_contactListener);
+
+						if (contact->IsOverlapping() == false)
+						{
+							// The shapes don't touch. Restore the other body.
+							other->m_sweep = backup;
+							other->SynchronizeTransform();
+							continue;
+						}
+
+						// Add the contact to the island and mark it.
+						island.Add(contact);
+						contact->m_flags |= b3Contact::e_islandFlag;
+
+						// Skip the other body if it was visited.
+						if (other->m_flags & b3Body::e_islandFlag)
+						{
+							continue;
+						}
+
+						// Add the other body to the island and mark it.
+						other->m_flags |= b3Body::e_islandFlag;
+
+						if (other->m_type != e_staticBody)
+						{
+							other->SetAwake(true);
+						}
+
+						island.Add(other);
+					}
+				}
+			}
+
+			// Solve the remaining portion of the step.
+			island.SetConstraintIndices();
+
+			float32 subDt = (1.0f - minAlpha) * dt;
+			island.SolveTOI(subDt, bodyA->m_islandID, bodyB->m_islandID, velocityIterations);
+
+			// Reset the island flags and synchronize the moved bodies.
+			for (u32 i = 0; i < island.m_bodyCount; ++i)
+			{
+				b3Body* body = island.m_bodies[i];
+				body->m_flags &= ~b3Body::e_islandFlag;
+
+				if (body->m_type != e_dynamicBody)
+				{
+					continue;
+				}
+
+				// Update shapes for broad-phase.
+				body->SynchronizeShapes();
+
+				// Invalidate the time of impacts of the moved body.
+				for (b3Shape* s = body->m_shapeList.m_head; s; s = s->m_next)
+				{
+					for (b3ContactEdge* ce = s->m_contactEdges.m_head; ce; ce = ce->m_next)
+					{
+						ce->contact->m_flags &= ~(b3Contact::e_toiFlag | b3Contact::e_islandFlag);
+					}
+				}
+			}
+
+			// Notify the contacts the AABBs may have been moved.
+			m_contactMan.SynchronizeShapes();
+
+			// Find new contacts.
+			m_contactMan.FindNewContacts();
+		}
+	}
+
+	m_stackAllocator.Free(bullets);
+}
+
 struct b3RayCastCallback
 {
 	float32 Report(const b3RayCastInput& input, u32 proxyId)
@@ -406,6 +988,15 @@ struct b3RayCastSingleCallback
 				shape0 = shape;
 				output0 = output;
 			}
+
+			if (anyHit)
+			{
+				// Stop at the first hit.
+				return 0.0f;
+			}
+
+			// Clip the ray so shapes behind this hit are skipped.
+			return output.fraction;
 		}
 
 		// Continue the search from where we stopped.
@@ -414,10 +1005,21 @@ struct b3RayCastSingleCallback
 
 	b3Shape* shape0;
 	b3RayCastOutput output0; 
+	bool anyHit;
 	const b3BroadPhase* broadPhase;
 };
 
 bool b3World::RayCastSingle(b3RayCastSingleOutput* output, const b3Vec3& p1, const b3Vec3& p2) const
+{
+	return RayCastSingle(output, p1, p2, false);
+}
+
+bool b3World::RayCastAny(b3RayCastSingleOutput* output, const b3Vec3& p1, const b3Vec3& p2) const
+{
+	return RayCastSingle(output, p1, p2, true);
+}
+
+bool b3World::RayCastSingle(b3RayCastSingleOutput* output, const b3Vec3& p1, const b3Vec3& p2, bool anyHit) const
 {
 	b3RayCastInput input;
 	input.p1 = p1;
@@ -427,6 +1029,7 @@ bool b3World::RayCastSingle(b3RayCastSingleOutput* output, const b3Vec3& p1, con
 	b3RayCastSingleCallback callback;
 	callback.shape0 = NULL;
 	callback.output0.fraction = B3_MAX_FLOAT;
+	callback.anyHit = anyHit;
 	callback.broadPhase = &m_contactMan.m_broadPhase;
 	
 	// Perform the ray cast.
@@ -450,6 +1053,145 @@ bool b3World::RayCastSingle(b3RayCastSingleOutput* output, const b3Vec3& p1, con
 	return false;
 }
 
+// The number of ray packets cast by a task of a ray cast batch.
+#define B3_RAY_PACKET_TASK_COUNT 16
+
+struct b3RayCastPacketCallback
+{
+	float32 Report(const b3RayCastInput& input, u32 proxyId, u32 lane)
+	{
+		// Get shape associated with the proxy.
+		void* userData = broadPhase->GetUserData(proxyId);
+		b3Shape* shape = (b3Shape*)userData;
+
+		// Get map from shape local space to world space.
+		b3Transform xf = shape->GetBody()->GetTransform();
+
+		b3RayCastOutput output;
+		bool hit = shape->RayCast(&output, input, xf);
+		if (hit)
+		{
+			if (output.fraction < outputs0[lane].fraction)
+			{
+				shapes0[lane] = shape;
+				outputs0[lane] = output;
+			}
+
+			// Clip the ray so shapes behind this hit are skipped.
+			return output.fraction;
+		}
+
+		// Continue the search from where we stopped.
+		return input.maxFraction;
+	}
+
+	b3Shape* shapes0[4];
+	b3RayCastOutput outputs0[4];
+	const b3BroadPhase* broadPhase;
+};
+
+void b3World::RayCastPacket(b3RayCastSingleOutput* outputs, const b3Vec3* p1s, const b3Vec3* p2s, u32 count) const
+{
+	B3_ASSERT(count > 0 && count <= 4);
+
+	b3RayCastInput inputs[4];
+	for (u32 i = 0; i < count; ++i)
+	{
+		inputs[i].p1 = p1s[i];
+		inputs[i].p2 = p2s[i];
+		inputs[i].maxFraction = 1.0f;
+	}
+
+	b3RayPacket packet;
+	packet.Set(inputs, count);
+
+	b3RayCastPacketCallback callback;
+	for (u32 i = 0; i < 4; ++i)
+	{
+		callback.shapes0[i] = NULL;
+		callback.outputs0[i].fraction = B3_MAX_FLOAT;
+	}
+	callback.broadPhase = &m_contactMan.m_broadPhase;
+
+	// Perform the ray casts.
+	m_contactMan.m_broadPhase.RayCastPacket(&callback, &packet);
+
+	for (u32 i = 0; i < count; ++i)
+	{
+		b3RayCastSingleOutput* output = outputs + i;
+		output->shape = callback.shapes0[i];
+
+		if (callback.shapes0[i])
+		{
+			// Ray hits closest shape.
+			float32 fraction = callback.outputs0[i].fraction;
+			output->point = (1.0f - fraction) * p1s[i] + fraction * p2s[i];
+			output->normal = callback.outputs0[i].normal;
+			output->fraction = fraction;
+		}
+	}
+}
+
+struct b3RayCastBatchContext
+{
+	const b3World* world;
+	b3RayCastSingleOutput* outputs;
+	const b3Vec3* p1s;
+	const b3Vec3* p2s;
+	u32 count;
+};
+
+void b3World::RayCastPackets(void* context, u32 begin, u32 end, u32 threadIndex)
+{
+	B3_NOT_USED(threadIndex);
+
+	b3RayCastBatchContext* batch = (b3RayCastBatchContext*)context;
+
+	for (u32 i = begin; i < end; ++i)
+	{
+		u32 first = 4 * i;
+		u32 count = b3Min(batch->count - first, 4u);
+
+		batch->world->RayCastPacket(batch->outputs + first, batch->p1s + first, batch->p2s + first, count);
+	}
+}
+
+u32 b3World::RayCastBatch(b3RayCastSingleOutput* outputs, const b3Vec3* p1s, const b3Vec3* p2s, u32 count) const
+{
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	b3RayCastBatchContext context;
+	context.world = this;
+	context.outputs = outputs;
+	context.p1s = p1s;
+	context.p2s = p2s;
+	context.count = count;
+
+	u32 packetCount = (count + 3) / 4;
+
+	if (m_jobSystem && packetCount > B3_RAY_PACKET_TASK_COUNT)
+	{
+		m_jobSystem->ParallelFor(RayCastPackets, &context, packetCount, B3_RAY_PACKET_TASK_COUNT);
+	}
+	else
+	{
+		RayCastPackets(&context, 0, packetCount, 0);
+	}
+
+	u32 hitCount = 0;
+	for (u32 i = 0; i < count; ++i)
+	{
+		if (outputs[i].shape)
+		{
+			++hitCount;
+		}
+	}
+	return hitCount;
+}
+
 struct b3QueryAABBCallback
 {
 	bool Report(u32 proxyID)
@@ -469,3 +1211,310 @@ void b3World::QueryAABB(b3QueryListener* listener, const b3AABB3& aabb) const
 	callback.broadPhase = &m_contactMan.m_broadPhase;
 	m_contactMan.m_broadPhase.QueryAABB(&callback, aabb);
 }
+
+struct b3MeshQueryShapeCallback
+{
+	bool Report(u32 proxyId)
+	{
+		u32 triangleIndex = mesh->m_mesh->tree.GetUserData(proxyId);
+
+		b3ConvexCache cache;
+		cache.simplexCache.count = 0;
+
+		if (b3TestOverlap(xfMesh, triangleIndex, mesh, xf, 0, shape, &cache))
+		{
+			// Stop at the first overlapping triangle.
+			overlap = true;
+			return false;
+		}
+
+		// Continue the search.
+		return true;
+	}
+
+	const b3MeshShape* mesh;
+	b3Transform xfMesh;
+	const b3Shape* shape;
+	b3Transform xf;
+	
+	bool overlap;
+};
+
+struct b3QueryShapeCallback
+{
+	bool Report(u32 proxyId)
+	{
+		// Get shape associated with the proxy.
+		b3Shape* shape = (b3Shape*)broadPhase->GetUserData(proxyId);
+
+		if (body && shape->GetBody() == body)
+		{
+			// Don't test the shapes of the same body.
+			return true;
+		}
+
+		b3Transform xfShape = shape->GetBody()->GetTransform();
+
+		bool overlap = false;
+
+		if (shape->GetType() == e_meshShape)
+		{
+			overlap = TestMesh((b3MeshShape*)shape, xfShape);
+		}
+		else
+		{
+			b3ConvexCache cache;
+			cache.simplexCache.count = 0;
+
+			overlap = b3TestOverlap(xfShape, 0, shape, xf, 0, queryShape, &cache);
+		}
+
+		if (overlap)
+		{
+			B3_ASSERT(count < capacity);
+			shapes[count++] = shape;
+		}
+
+		// Stop the query if the buffer is full.
+		return count < capacity;
+	}
+
+	bool TestMesh(const b3MeshShape* mesh, const b3Transform& xfMesh)
+	{
+		// Compute the AABB of the query shape in the mesh frame.
+		b3Transform xfLocal = b3MulT(xfMesh, xf);
+
+		b3AABB3 aabb;
+		queryShape->ComputeAABB(&aabb, xfLocal);
+
+		b3MeshQueryShapeCallback callback;
+		callback.mesh = mesh;
+		callback.xfMesh = xfMesh;
+		callback.shape = queryShape;
+		callback.xf = xf;
+		callback.overlap = false;
+
+		mesh->m_mesh->tree.QueryAABB(&callback, aabb);
+
+		return callback.overlap;
+	}
+
+	const b3Shape* queryShape;
+	const b3Body* body;
+	b3Transform xf;
+	
+	b3Shape** shapes;
+	u32 count;
+	u32 capacity;
+	const b3BroadPhase* broadPhase;
+};
+
+u32 b3World::QueryShape(b3Shape** shapes, u32 capacity, const b3Shape* shape, const b3Transform& xf) const
+{
+	B3_ASSERT(shape->GetType() != e_meshShape);
+
+	if (capacity == 0)
+	{
+		return 0;
+	}
+
+	b3AABB3 aabb;
+	shape->ComputeAABB(&aabb, xf);
+
+	b3QueryShapeCallback callback;
+	callback.queryShape = shape;
+	callback.body = shape->GetBody();
+	callback.xf = xf;
+	callback.shapes = shapes;
+	callback.count = 0;
+	callback.capacity = capacity;
+	callback.broadPhase = &m_contactMan.m_broadPhase;
+	m_contactMan.m_broadPhase.QueryAABB(&callback, aabb);
+
+	return callback.count;
+}
+
+u32 b3World::QuerySphere(b3Shape** shapes, u32 capacity, const b3Sphere& sphere) const
+{
+	b3SphereShape shape;
+	shape.m_center = sphere.vertex;
+	shape.m_radius = sphere.radius;
+
+	return QueryShape(shapes, capacity, &shape, b3Transform_identity);
+}
+
+u32 b3World::QueryCapsule(b3Shape** shapes, u32 capacity, const b3Capsule& capsule) const
+{
+	b3CapsuleShape shape;
+	shape.m_centers[0] = capsule.vertices[0];
+	shape.m_centers[1] = capsule.vertices[1];
+	shape.m_radius = capsule.radius;
+
+	return QueryShape(shapes, capacity, &shape, b3Transform_identity);
+}
+
+struct b3MeshShapeCastCallback
+{
+	bool Report(u32 proxyId)
+	{
+		u32 triangleIndex = mesh->m_mesh->tree.GetUserData(proxyId);
+
+		b3ShapeGJKProxy triangleProxy(mesh, triangleIndex);
+
+		b3GJKShapeCastOutput output;
+		if (b3GJKShapeCast(&output, xfMesh, triangleProxy, xf, *proxy, translation, output0.t))
+		{
+			// Track minimum time of impact.
+			if (output.t < output0.t)
+			{
+				hit = true;
+				output0 = output;
+			}
+		}
+
+		// Continue the search.
+		return true;
+	}
+
+	const b3MeshShape* mesh;
+	b3Transform xfMesh;
+	const b3GJKProxy* proxy;
+	b3Transform xf;
+	b3Vec3 translation;
+
+	bool hit;
+	b3GJKShapeCastOutput output0;
+};
+
+struct b3ShapeCastCallback
+{
+	bool Report(u32 proxyId)
+	{
+		// Get shape associated with the proxy.
+		b3Shape* shape = (b3Shape*)broadPhase->GetUserData(proxyId);
+
+		if (body && shape->GetBody() == body)
+		{
+			// Don't cast against the shapes of the same body.
+			return true;
+		}
+
+		// Skip the shape if the cast AABB misses the proxy AABB or 
+		// reaches it after the closest hit found so far.
+		b3AABB3 aabb = broadPhase->GetAABB(proxyId);
+		aabb.Extend(extents);
+
+		float32 minFraction;
+		if (aabb.TestRay(center, center + translation, output0.t, minFraction) == false)
+		{
+			return true;
+		}
+
+		b3Transform xfShape = shape->GetBody()->GetTransform();
+
+		b3GJKShapeCastOutput output;
+		bool hit = false;
+
+		if (shape->GetType() == e_meshShape)
+		{
+			hit = CastMesh(&output, (b3MeshShape*)shape, xfShape);
+		}
+		else
+		{
+			b3ShapeGJKProxy shapeProxy(shape, 0);
+			hit = b3GJKShapeCast(&output, xfShape, shapeProxy, xf, *proxy, translation, output0.t);
+		}
+
+		if (hit && output.t < output0.t)
+		{
+			// Track minimum time of impact.
+			shape0 = shape;
+			output0 = output;
+		}
+
+		// Continue the search.
+		return true;
+	}
+
+	bool CastMesh(b3GJKShapeCastOutput* output, const b3MeshShape* mesh, const b3Transform& xfMesh)
+	{
+		// Compute the swept AABB of the cast shape in the mesh frame.
+		b3Transform xfLocal = b3MulT(xfMesh, xf);
+		b3Vec3 translationLocal = b3MulT(xfMesh.rotation, translation);
+
+		b3AABB3 aabb1;
+		castShape->ComputeAABB(&aabb1, xfLocal);
+
+		b3AABB3 aabb2 = aabb1;
+		aabb2.m_lower += translationLocal;
+		aabb2.m_upper += translationLocal;
+
+		b3MeshShapeCastCallback callback;
+		callback.mesh = mesh;
+		callback.xfMesh = xfMesh;
+		callback.proxy = proxy;
+		callback.xf = xf;
+		callback.translation = translation;
+		callback.hit = false;
+		callback.output0.t = output0.t;
+
+		mesh->m_mesh->tree.QueryAABB(&callback, b3Combine(aabb1, aabb2));
+
+		*output = callback.output0;
+		return callback.hit;
+	}
+
+	const b3Shape* castShape;
+	const b3Body* body;
+	const b3GJKProxy* proxy;
+	b3Transform xf;
+	b3Vec3 translation;
+	b3Vec3 center;
+	b3Vec3 extents;
+	
+	b3Shape* shape0;
+	b3GJKShapeCastOutput output0;
+	const b3BroadPhase* broadPhase;
+};
+
+bool b3World::ShapeCast(b3ShapeCastSingleOutput* output, const b3Shape* shape, const b3Transform& xf, const b3Vec3& translation) const
+{
+	B3_ASSERT(shape->GetType() != e_meshShape);
+
+	b3ShapeGJKProxy proxy(shape, 0);
+
+	b3AABB3 aabb1;
+	shape->ComputeAABB(&aabb1, xf);
+
+	b3AABB3 aabb2 = aabb1;
+	aabb2.m_lower += translation;
+	aabb2.m_upper += translation;
+
+	b3ShapeCastCallback callback;
+	callback.castShape = shape;
+	callback.body = shape->GetBody();
+	callback.proxy = &proxy;
+	callback.xf = xf;
+	callback.translation = translation;
+	callback.center = aabb1.Centroid();
+	callback.extents = 0.5f * (aabb1.m_upper - aabb1.m_lower);
+	callback.shape0 = NULL;
+	callback.output0.t = 1.0f;
+	callback.broadPhase = &m_contactMan.m_broadPhase;
+
+	// Query the swept AABB.
+	m_contactMan.m_broadPhase.QueryAABB(&callback, b3Combine(aabb1, aabb2));
+
+	if (callback.shape0)
+	{
+		// Shape hits closest shape.
+		output->shape = callback.shape0;
+		output->point = callback.output0.point;
+		output->normal = callback.output0.normal;
+		output->fraction = callback.output0.t;
+
+		return true;
+	}
+
+	return false;
+}